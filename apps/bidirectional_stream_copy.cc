@@ -2,28 +2,186 @@
 
 #include "byte_stream.hh"
 #include "eventloop.hh"
+#include "exception.hh"
 
+#include <array>
+#include <fcntl.h>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <sys/stat.h>
 #include <unistd.h>
 
 using namespace std;
 
-void bidirectional_stream_copy( Socket& socket, string_view peer_name )
+namespace {
+
+constexpr size_t buffer_size = 1048576;
+
+//! Can the kernel move bytes to or from this fd without them passing through user space?
+//! (Pipes, sockets and regular files can be spliced; terminals and most devices can't.)
+bool is_spliceable( const FileDescriptor& fd )
+{
+  struct stat st {};
+  CheckSystemCall( "fstat", ::fstat( fd.fd_num(), &st ) );
+  return S_ISFIFO( st.st_mode ) or S_ISSOCK( st.st_mode ) or S_ISREG( st.st_mode );
+}
+
+bool is_regular_file( const FileDescriptor& fd )
+{
+  struct stat st {};
+  CheckSystemCall( "fstat", ::fstat( fd.fd_num(), &st ) );
+  return S_ISREG( st.st_mode );
+}
+
+//! \brief One direction of the zero-copy path
+//! \details Bytes are spliced from `source` into a pipe, and from the pipe into `sink`, so they never enter
+//! user space. A regular file is instead sent straight to the sink with sendfile(2), without the pipe.
+class KernelRelay
 {
-  constexpr size_t buffer_size = 1048576;
+  FileDescriptor& source_;
+  FileDescriptor& sink_;
+  function<void()> finish_; //!< Called once every byte has reached the sink (e.g. to shut it down)
+  bool& failed_;            //!< Shared by both directions: an error in one stops the other
+
+  bool sendfile_ { is_regular_file( source_ ) };
+  optional<FileDescriptor> pipe_read_ {};
+  optional<FileDescriptor> pipe_write_ {};
+  size_t pipe_capacity_ {};
+  size_t buffered_ {}; //!< Bytes in the pipe
+  bool pipe_full_ {};  //!< Did the last splice into the pipe find it full?
+  bool source_eof_ {};
+  bool finished_ {};
+
+  void finish()
+  {
+    finished_ = true;
+    finish_();
+  }
+
+  void fail() { failed_ = true; }
+
+  //! The sink's rule is cancelled once the sink is closed, which is only an error before finish()
+  void cancel()
+  {
+    if ( not finished_ ) {
+      fail();
+    }
+  }
 
+public:
+  KernelRelay( FileDescriptor& source, FileDescriptor& sink, function<void()> finish, bool& failed )
+    : source_( source ), sink_( sink ), finish_( move( finish ) ), failed_( failed )
+  {
+    if ( sendfile_ ) {
+      return;
+    }
+    array<int, 2> fds {};
+    CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_NONBLOCK | O_CLOEXEC ) );
+    pipe_read_.emplace( fds[0] );
+    pipe_write_.emplace( fds[1] );
+    // as large as the user-space path's buffer, if allowed (F_SETPIPE_SZ returns the size actually set)
+    const int size = ::fcntl( fds[1], F_SETPIPE_SZ, static_cast<int>( buffer_size ) );
+    pipe_capacity_
+      = static_cast<size_t>( size > 0 ? size : CheckSystemCall( "F_GETPIPE_SZ", ::fcntl( fds[1], F_GETPIPE_SZ ) ) );
+  }
+
+  void install( EventLoop& eventloop, const string& name )
+  {
+    if ( sendfile_ ) {
+      eventloop.add_rule(
+        "sendfile " + name,
+        sink_,
+        Direction::Out,
+        [&] {
+          sink_.sendfile_from( source_, buffer_size );
+          if ( source_.eof() ) {
+            finish();
+          }
+        },
+        [&] { return not finished_ and not failed_; },
+        [&] { cancel(); },
+        [&] { fail(); } );
+      return;
+    }
+
+    eventloop.add_rule(
+      "splice " + name + " into pipe",
+      source_,
+      Direction::In,
+      [&] {
+        const size_t moved = pipe_write_->splice_from( source_, pipe_capacity_ - buffered_ );
+        source_eof_ = source_.eof();
+        // each splice takes at least a page of the pipe, so it can fill up before holding pipe_capacity_ bytes
+        pipe_full_ = moved == 0 and not source_eof_;
+        buffered_ += moved;
+      },
+      [&] { return not source_eof_ and not failed_ and not pipe_full_ and buffered_ < pipe_capacity_; },
+      [&] { source_eof_ = true; },
+      [&] { fail(); } );
+
+    eventloop.add_rule(
+      "splice " + name + " from pipe",
+      sink_,
+      Direction::Out,
+      [&] {
+        if ( buffered_ > 0 ) {
+          const size_t moved = sink_.splice_from( *pipe_read_, buffered_ );
+          buffered_ -= moved;
+          pipe_full_ = pipe_full_ and moved == 0;
+        }
+        if ( source_eof_ and buffered_ == 0 ) {
+          finish();
+        }
+      },
+      [&] { return not failed_ and ( buffered_ > 0 or ( source_eof_ and not finished_ ) ); },
+      [&] { cancel(); },
+      [&] { fail(); } );
+  }
+};
+
+//! Copy between stdin/stdout and the socket entirely in the kernel (see KernelRelay)
+void kernel_stream_copy( Socket& socket, FileDescriptor& input, FileDescriptor& output, string_view peer_name )
+{
+  EventLoop eventloop {};
+  bool failed = false;
+
+  KernelRelay outbound {
+    input,
+    socket,
+    [&] {
+      socket.shutdown( SHUT_WR );
+      cerr << "DEBUG: Outbound stream to " << peer_name << " finished.\n";
+    },
+    failed };
+  KernelRelay inbound {
+    socket,
+    output,
+    [&] {
+      output.close();
+      cerr << "DEBUG: Inbound stream from " << peer_name << " finished.\n";
+    },
+    failed };
+
+  outbound.install( eventloop, "stdin to socket" );
+  inbound.install( eventloop, "socket to stdout" );
+
+  while ( EventLoop::Result::Exit != eventloop.wait_next_event( -1 ) ) {}
+
+  if ( failed ) {
+    cerr << "DEBUG: Stream with " << peer_name << " had an error.\n";
+  }
+}
+
+//! Copy between stdin/stdout and the socket through a ByteStream in each direction
+void user_space_stream_copy( Socket& socket, FileDescriptor& input, FileDescriptor& output, string_view peer_name )
+{
   EventLoop eventloop {};
-  FileDescriptor input { STDIN_FILENO };
-  FileDescriptor output { STDOUT_FILENO };
   ByteStream outbound { buffer_size };
   ByteStream inbound { buffer_size };
   bool outbound_shutdown { false };
   bool inbound_shutdown { false };
 
-  socket.set_blocking( false );
-  input.set_blocking( false );
-  output.set_blocking( false );
-
   // rule 1: read from stdin into outbound byte stream
   eventloop.add_rule(
     "read from stdin into outbound byte stream",
@@ -132,3 +290,23 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     }
   }
 }
+
+} // namespace
+
+//! \details When stdin and stdout are pipes, sockets or regular files, the bytes are moved by the kernel with
+//! splice(2) or sendfile(2). Otherwise (e.g. on a terminal), they go through a ByteStream in each direction.
+void bidirectional_stream_copy( Socket& socket, string_view peer_name )
+{
+  FileDescriptor input { STDIN_FILENO };
+  FileDescriptor output { STDOUT_FILENO };
+
+  socket.set_blocking( false );
+  input.set_blocking( false );
+  output.set_blocking( false );
+
+  if ( is_spliceable( input ) and is_spliceable( output ) ) {
+    kernel_stream_copy( socket, input, output, peer_name );
+  } else {
+    user_space_stream_copy( socket, input, output, peer_name );
+  }
+}
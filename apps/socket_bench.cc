@@ -0,0 +1,343 @@
+#include "socket_bench.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+using Clock = steady_clock;
+
+constexpr size_t read_size = 65536;
+constexpr string_view header_magic = "minnow-bench";
+
+double seconds_between( const Clock::time_point start, const Clock::time_point end )
+{
+  return duration<double> { end - start }.count();
+}
+
+void write_all( Socket& socket, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( socket.write( data ) );
+  }
+}
+
+//! Read whatever has arrived (blocking until something does); returns false at the end of the stream
+bool read_some( Socket& socket, string& buffer )
+{
+  buffer.resize( read_size );
+  socket.read( buffer );
+  return not socket.eof();
+}
+
+//! Prints a line for each interval of the test: bytes moved, or round trips made
+class IntervalReporter
+{
+  Clock::time_point start_;
+  Clock::time_point interval_start_ { start_ };
+  double interval_;
+  uint64_t bytes_ {};
+  uint64_t round_trips_ {};
+  double round_trip_us_ {}; //!< Sum of the round trip times in the interval
+
+  void report( const Clock::time_point now )
+  {
+    cout << "[" << fixed << setprecision( 2 ) << setw( 7 ) << seconds_between( start_, interval_start_ ) << "-"
+         << setw( 7 ) << seconds_between( start_, now ) << " s]  ";
+    const double seconds = seconds_between( interval_start_, now );
+    if ( round_trips_ == 0 ) {
+      cout << setw( 10 ) << static_cast<double>( bytes_ ) / 1e6 << " MB  " << setw( 10 )
+           << 8 * static_cast<double>( bytes_ ) / seconds / 1e6 << " Mbit/s\n";
+    } else {
+      cout << setw( 8 ) << round_trips_ << " round trips  " << setw( 10 ) << setprecision( 1 )
+           << static_cast<double>( round_trips_ ) / seconds << " /s";
+      if ( round_trip_us_ > 0 ) {
+        cout << "  mean " << setw( 8 ) << round_trip_us_ / static_cast<double>( round_trips_ ) << " us";
+      }
+      cout << "\n";
+    }
+    cout.flush();
+    interval_start_ = now;
+    bytes_ = 0;
+    round_trips_ = 0;
+    round_trip_us_ = 0;
+  }
+
+public:
+  IntervalReporter( const Clock::time_point start, const double interval ) : start_( start ), interval_( interval )
+  {}
+
+  void add_bytes( const uint64_t bytes ) { bytes_ += bytes; }
+
+  //! (A server doesn't know how long the round trip took, so it passes 0)
+  void add_round_trip( const double us )
+  {
+    ++round_trips_;
+    round_trip_us_ += us;
+  }
+
+  //! Report the interval if it is over
+  void tick( const Clock::time_point now )
+  {
+    if ( interval_ > 0 and seconds_between( interval_start_, now ) >= interval_ ) {
+      report( now );
+    }
+  }
+
+  //! Report what is left of the last interval
+  void finish( const Clock::time_point now )
+  {
+    if ( interval_ > 0 and ( bytes_ > 0 or round_trips_ > 0 ) ) {
+      report( now );
+    }
+  }
+};
+
+void stream_client( Socket& socket, const BenchConfig& cfg )
+{
+  write_all( socket, string { header_magic } + " stream\n" );
+
+  const string block( cfg.write_size, 'x' );
+  const auto start = Clock::now();
+  const auto stop = start + duration_cast<Clock::duration>( duration<double> { cfg.duration } );
+  IntervalReporter reporter { start, cfg.interval };
+  uint64_t bytes_sent = 0;
+  for ( auto now = start; now < stop; now = Clock::now() ) {
+    const size_t written = socket.write( block );
+    bytes_sent += written;
+    reporter.add_bytes( written );
+    reporter.tick( now );
+  }
+  const auto sent = Clock::now();
+  reporter.finish( sent );
+  socket.shutdown( SHUT_WR );
+
+  // the server answers with the number of bytes it read, once it has read them all
+  string reply;
+  string buffer;
+  while ( read_some( socket, buffer ) ) {
+    reply += buffer;
+  }
+  const auto done = Clock::now();
+  const uint64_t bytes_received = strtoull( reply.c_str(), nullptr, 10 );
+  if ( bytes_received != bytes_sent ) {
+    throw runtime_error( "socket_bench: sent " + to_string( bytes_sent ) + " bytes, but the server read "
+                         + to_string( bytes_received ) );
+  }
+
+  cout << fixed << setprecision( 2 ) << "sent " << static_cast<double>( bytes_sent ) / 1e6 << " MB in "
+       << seconds_between( start, sent ) << " s ("
+       << 8 * static_cast<double>( bytes_sent ) / seconds_between( start, sent ) / 1e6
+       << " Mbit/s); all received after " << seconds_between( start, done ) << " s, for a goodput of "
+       << 8 * static_cast<double>( bytes_received ) / seconds_between( start, done ) / 1e6 << " Mbit/s\n";
+}
+
+void stream_server( Socket& socket, const BenchConfig& cfg, string buffer )
+{
+  const auto start = Clock::now();
+  IntervalReporter reporter { start, cfg.interval };
+  uint64_t bytes_received = buffer.size();
+  reporter.add_bytes( buffer.size() );
+  while ( read_some( socket, buffer ) ) {
+    bytes_received += buffer.size();
+    reporter.add_bytes( buffer.size() );
+    reporter.tick( Clock::now() );
+  }
+  const auto done = Clock::now();
+  reporter.finish( done );
+
+  write_all( socket, to_string( bytes_received ) + "\n" );
+  socket.shutdown( SHUT_WR );
+
+  cout << fixed << setprecision( 2 ) << "received " << static_cast<double>( bytes_received ) / 1e6 << " MB in "
+       << seconds_between( start, done ) << " s ("
+       << 8 * static_cast<double>( bytes_received ) / seconds_between( start, done ) / 1e6 << " Mbit/s)\n";
+}
+
+void request_response_client( Socket& socket, const BenchConfig& cfg )
+{
+  const size_t response_size = cfg.response_size == 0 ? cfg.request_size : cfg.response_size;
+  write_all( socket,
+             string { header_magic } + " rr " + to_string( cfg.request_size ) + " " + to_string( response_size )
+               + "\n" );
+
+  const string request( cfg.request_size, 'q' );
+  string buffer;
+  vector<double> round_trips_us;
+
+  const auto start = Clock::now();
+  const auto stop = start + duration_cast<Clock::duration>( duration<double> { cfg.duration } );
+  IntervalReporter reporter { start, cfg.interval };
+  for ( auto now = start; now < stop; ) {
+    write_all( socket, request );
+    for ( size_t received = 0; received < response_size; received += buffer.size() ) {
+      if ( not read_some( socket, buffer ) ) {
+        throw runtime_error( "socket_bench: the server closed the connection in the middle of a response" );
+      }
+    }
+    const auto then = now;
+    now = Clock::now();
+    const double us = duration<double, micro> { now - then }.count();
+    round_trips_us.push_back( us );
+    reporter.add_round_trip( us );
+    reporter.tick( now );
+  }
+  const auto done = Clock::now();
+  reporter.finish( done );
+  socket.shutdown( SHUT_WR );
+  while ( read_some( socket, buffer ) ) {}
+
+  ranges::sort( round_trips_us );
+  const auto percentile = [&]( double p ) {
+    const auto rank = static_cast<size_t>( p / 100 * static_cast<double>( round_trips_us.size() ) + 0.999999 );
+    return round_trips_us.at( clamp<size_t>( rank, 1, round_trips_us.size() ) - 1 );
+  };
+  cout << round_trips_us.size() << " round trips of " << cfg.request_size << "-byte requests and " << response_size
+       << "-byte responses in " << fixed << setprecision( 2 ) << seconds_between( start, done ) << " s ("
+       << setprecision( 1 ) << static_cast<double>( round_trips_us.size() ) / seconds_between( start, done )
+       << " /s)\n";
+  if ( not round_trips_us.empty() ) {
+    cout << "round trip (us): min " << round_trips_us.front() << "  p50 " << percentile( 50 ) << "  p90 "
+         << percentile( 90 ) << "  p99 " << percentile( 99 ) << "  max " << round_trips_us.back() << "\n";
+  }
+}
+
+void request_response_server( Socket& socket,
+                              const BenchConfig& cfg,
+                              const size_t request_size,
+                              const size_t response_size,
+                              string buffer )
+{
+  const string response( response_size, 'r' );
+  const auto start = Clock::now();
+  IntervalReporter reporter { start, cfg.interval };
+  uint64_t round_trips = 0;
+  size_t unanswered = 0; // bytes of requests not yet answered
+  do {
+    unanswered += buffer.size();
+    for ( ; unanswered >= request_size; unanswered -= request_size ) {
+      write_all( socket, response );
+      ++round_trips;
+      reporter.add_round_trip( 0 );
+    }
+    reporter.tick( Clock::now() );
+    buffer.clear();
+  } while ( read_some( socket, buffer ) );
+  const auto done = Clock::now();
+  reporter.finish( done );
+  socket.shutdown( SHUT_WR );
+
+  cout << "answered " << round_trips << " requests in " << fixed << setprecision( 2 )
+       << seconds_between( start, done ) << " s\n";
+}
+
+} // namespace
+
+bool parse_bench_option( const span<char*> args, size_t& curr, BenchConfig& cfg )
+{
+  const string_view option = args[curr];
+  if ( option == "--bench" ) {
+    cfg.enabled = true;
+    curr += 1;
+    return true;
+  }
+  if ( option != "--time" and option != "--interval" and option != "--len" and option != "--rr" ) {
+    return false;
+  }
+  if ( curr + 1 >= args.size() ) {
+    throw runtime_error( string { option } + " requires one argument." );
+  }
+
+  const char* value = args[curr + 1];
+  char* end = nullptr;
+  if ( option == "--time" ) {
+    cfg.duration = strtod( value, &end );
+  } else if ( option == "--interval" ) {
+    cfg.interval = strtod( value, &end );
+  } else if ( option == "--len" ) {
+    cfg.write_size = strtoull( value, &end, 0 );
+  } else {
+    cfg.request_size = strtoull( value, &end, 0 );
+    cfg.response_size = *end == ':' ? strtoull( end + 1, &end, 0 ) : cfg.request_size;
+  }
+  if ( end == value or *end != '\0' ) {
+    throw runtime_error( "malformed argument to " + string { option } + ": " + value );
+  }
+  if ( cfg.write_size == 0 or cfg.duration <= 0 ) {
+    throw runtime_error( "--time and --len must be positive." );
+  }
+
+  curr += 2;
+  return true;
+}
+
+string bench_usage()
+{
+  const BenchConfig dflt;
+  stringstream usage;
+  usage << "   --bench         Generate and discard data instead of copying        (off)\n"
+        << "                   stdin/stdout, and report on it. The client chooses the test.\n"
+        << "   --time <s>      Length of the test (client only)                " << dflt.duration << "\n"
+        << "   --interval <s>  Seconds between interval reports (0: none)      " << dflt.interval << "\n"
+        << "   --len <bytes>   Bytes per write in the stream test              " << dflt.write_size << "\n"
+        << "   --rr <req>[:<resp>]  Instead of a stream test, trade <req>-byte requests for\n"
+        << "                   <resp>-byte responses, one at a time, and report round trip times\n";
+  return usage.str();
+}
+
+void socket_bench( Socket& socket, const BenchConfig& cfg, const bool server )
+{
+  if ( not server ) {
+    if ( cfg.request_size > 0 ) {
+      request_response_client( socket, cfg );
+    } else {
+      stream_client( socket, cfg );
+    }
+    return;
+  }
+
+  // the client's first line says what to do
+  string header;
+  string buffer;
+  while ( header.find( '\n' ) == string::npos ) {
+    if ( not read_some( socket, buffer ) ) {
+      throw runtime_error( "socket_bench: the client closed the connection without choosing a test" );
+    }
+    header += buffer;
+  }
+  const size_t newline = header.find( '\n' );
+  string rest = header.substr( newline + 1 );
+  stringstream fields { header.substr( 0, newline ) };
+
+  string magic;
+  string test;
+  fields >> magic >> test;
+  if ( magic != header_magic ) {
+    throw runtime_error( "socket_bench: the client is not running a benchmark" );
+  }
+  if ( test == "stream" ) {
+    cout << "stream test\n";
+    stream_server( socket, cfg, move( rest ) );
+    return;
+  }
+
+  size_t request_size = 0;
+  size_t response_size = 0;
+  if ( test == "rr" and fields >> request_size >> response_size ) {
+    cout << "request/response test: " << request_size << "-byte requests, " << response_size
+         << "-byte responses\n";
+    request_response_server( socket, cfg, max<size_t>( request_size, 1 ), response_size, move( rest ) );
+  } else {
+    throw runtime_error( "socket_bench: unknown test " + test );
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "socket.hh"
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+//! What to measure with socket_bench
+struct BenchConfig
+{
+  bool enabled = false;      //!< Benchmark instead of copying stdin/stdout
+  double duration = 10;      //!< (client) Seconds to run the test for
+  double interval = 1;       //!< Seconds between interval reports (0: none)
+  size_t write_size = 65536; //!< (client, stream test) Bytes per write
+  size_t request_size = 0;   //!< (client) Size of each request in a request/response test (0: stream test)
+  size_t response_size = 0;  //!< (client) Size of each response in a request/response test
+};
+
+//! If `args[curr]` is a benchmark option, parse it (and its argument) into `cfg`, advance `curr` past it, and
+//! return true. Throws if an option's argument is missing or malformed.
+bool parse_bench_option( std::span<char*> args, size_t& curr, BenchConfig& cfg );
+
+//! Usage text for the benchmark options
+std::string bench_usage();
+
+//! \brief Run a benchmark over a connected socket, like iperf
+//! \details The client tells the server which test to run, then either sends data as fast as it can for
+//! `cfg.duration` seconds (a stream test), or trades requests and responses one at a time (a request/response
+//! test). The data is generated and discarded in memory. Both ends print interval reports to stdout; at the
+//! end, the client prints the goodput the server saw, or the latency percentiles of the round trips.
+void socket_bench( Socket& socket, const BenchConfig& cfg, bool server );
@@ -1,16 +1,25 @@
 #include "bidirectional_stream_copy.hh"
+#include "netem_adapter.hh"
+#include "socket_bench.hh"
 #include "tcp_config.hh"
 #include "tcp_minnow_socket.hh"
+#include "tcp_stack_group.hh"
 #include "tun.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <span>
+#include <stdexcept>
 #include <string>
 #include <tuple>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -28,6 +37,7 @@ void show_usage( const char* argv0, const char* msg )
        << "                   In server mode, <host>:<port> is the address to bind.\n\n"
 
        << "   -a <addr>       Set source address (client mode only)           " << LOCAL_ADDRESS_DFLT << "\n"
+       << "                   (with -u, the address to bind)                  (any)\n"
        << "   -s <port>       Set source port (client mode only)              (random)\n\n"
 
        << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
@@ -35,11 +45,25 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+       << "   -o              Use TUN offloads (TSO/GRO, checksum offload)    (off)\n"
+       << "   -u              Carry segments over UDP instead of a TUN device (off)\n"
+       << "                   (<host>:<port> is then a UDP address)\n"
+       << "   -q <queues>     (server mode) Echo any number of connections,   (one connection,\n"
+       << "                   with a stack per core on each of <queues>       on stdin/stdout)\n"
+       << "                   queues of a multi-queue TUN device\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
+       << "   -N <spec>       Emulate a network path on the uplink            (none)\n"
+       << "                   <spec> is a comma-separated list of delay=<ms>, jitter=<ms>,\n"
+       << "                   rate=<bit/s>, burst=<bytes>, limit=<segments>, red, reorder=<p>,\n"
+       << "                   dup=<p>, gemodel=<p>[:<r>[:<loss_bad>[:<loss_good>]]] and seed=<n>\n"
+       << "                   (e.g. delay=40,jitter=5,rate=20e6,limit=100,red)\n\n"
+
+       << bench_usage() << "\n"
+
        << "   -h              Show this message.\n\n";
 
   if ( msg != nullptr ) {
@@ -56,24 +80,44 @@ void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+//! Parse the -N option into a NetEmConfig
+NetEmConfig parse_netem_option( const char* argv0, const string& spec )
+{
+  try {
+    return parse_netem( spec );
+  } catch ( const runtime_error& e ) {
+    show_usage( argv0, ( "ERROR: " + string( e.what() ) ).c_str() );
+    exit( 1 );
+  }
+}
+
+struct AppOptions
+{
+  bool listen = false;
+  const char* tundev = nullptr;
+  bool offload = false;
+  bool udp = false;
+  size_t queues = 0; //!< Serve with a TCPStackGroup of this many stacks (0: one TCPMinnowSocket)
+  BenchConfig bench {};
+};
+
+tuple<TCPConfig, FdAdapterConfig, AppOptions> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   c_fsm.isn = Wrap32 { random_device()() };
 
   FdAdapterConfig c_filt {};
-  const char* tundev = nullptr;
+  AppOptions opts {};
 
   size_t curr = 1;
-  bool listen = false;
   const size_t argc = args.size();
 
-  string source_address = LOCAL_ADDRESS_DFLT;
+  string source_address {};
   string source_port = to_string( static_cast<uint16_t>( random_device()() ) );
 
   while ( argc - curr > 2 ) {
     if ( strncmp( "-l", args[curr], 3 ) == 0 ) {
-      listen = true;
+      opts.listen = true;
       curr += 1;
 
     } else if ( strncmp( "-a", args[curr], 3 ) == 0 ) {
@@ -98,7 +142,20 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
 
     } else if ( strncmp( "-d", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -t requires one argument." );
-      tundev = args[curr + 1];
+      opts.tundev = args[curr + 1];
+      curr += 2;
+
+    } else if ( strncmp( "-o", args[curr], 3 ) == 0 ) {
+      opts.offload = true;
+      curr += 1;
+
+    } else if ( strncmp( "-u", args[curr], 3 ) == 0 ) {
+      opts.udp = true;
+      curr += 1;
+
+    } else if ( strncmp( "-q", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -q requires one argument." );
+      opts.queues = strtoul( args[curr + 1], nullptr, 0 );
       curr += 2;
 
     } else if ( strncmp( "-Lu", args[curr], 3 ) == 0 ) {
@@ -117,6 +174,14 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
         = static_cast<LossRateDnT>( static_cast<float>( numeric_limits<LossRateDnT>::max() ) * lossrate );
       curr += 2;
 
+    } else if ( strncmp( "-N", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -N requires one argument." );
+      c_filt.netem = parse_netem_option( args[0], args[curr + 1] );
+      curr += 2;
+
+    } else if ( parse_bench_option( args.first( argc - 2 ), curr, opts.bench ) ) {
+      continue;
+
     } else if ( strncmp( "-h", args[curr], 3 ) == 0 ) {
       show_usage( args[0], nullptr );
       exit( 0 );
@@ -127,8 +192,17 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     }
   }
 
+  if ( opts.queues > 0 and ( not opts.listen or opts.udp ) ) {
+    show_usage( args[0], "ERROR: -q needs server mode (-l) on a TUN device." );
+    exit( 1 );
+  }
+
   // parse positional command-line arguments
-  if ( listen ) {
+  if ( source_address.empty() ) {
+    source_address = opts.udp ? "0" : LOCAL_ADDRESS_DFLT;
+  }
+
+  if ( opts.listen ) {
     c_filt.source = { "0", args[curr + 1] };
     if ( c_filt.source.port() == 0 ) {
       show_usage( args[0], "ERROR: listen port cannot be zero in server mode." );
@@ -139,7 +213,82 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     c_filt.source = { source_address, source_port };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, opts );
+}
+
+template<class SocketT>
+void run( SocketT& tcp_socket, const TCPConfig& c_fsm, const FdAdapterConfig& c_filt, const AppOptions& opts )
+{
+  if ( opts.listen ) {
+    tcp_socket.listen_and_accept( c_fsm, c_filt );
+  } else {
+    tcp_socket.connect( c_fsm, c_filt );
+  }
+
+  if ( opts.bench.enabled ) {
+    socket_bench( tcp_socket, opts.bench, opts.listen );
+  } else {
+    bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
+  }
+  tcp_socket.wait_until_closed();
+}
+
+//! Echo what each connection to `port` sends, and close it once the peer has
+void echo_connections( TCPOverIPv4Stack& stack, EventLoop& loop, uint16_t port, size_t queue )
+{
+  using ConnectionPtr = TCPOverIPv4Stack::ConnectionPtr;
+  auto connections = make_shared<vector<ConnectionPtr>>();
+
+  // look through a const view, since using the streams marks a connection to be pushed
+  const auto has_work = []( const ConnectionPtr& conn ) {
+    const auto& view = *conn;
+    return ( view.inbound_reader().bytes_buffered() > 0 and view.outbound_writer().available_capacity() > 0 )
+           or ( view.inbound_reader().is_finished() and not view.outbound_writer().is_closed() )
+           or not view.active();
+  };
+
+  loop.add_rule(
+    "echo connections on queue " + to_string( queue ),
+    [&stack, connections, port, queue, has_work] {
+      while ( auto conn = stack.accept( port ) ) {
+        cerr << "DEBUG: queue " << queue << ": connection from " << conn->peer_address().to_string() << "\n";
+        connections->push_back( move( conn ) );
+      }
+      for ( const auto& conn : *connections ) {
+        if ( not has_work( conn ) ) {
+          continue;
+        }
+        string data;
+        read( conn->inbound_reader(), conn->outbound_writer().available_capacity(), data );
+        conn->outbound_writer().push( move( data ) );
+        if ( conn->inbound_reader().is_finished() ) {
+          conn->outbound_writer().close();
+        }
+      }
+      erase_if( *connections, []( const ConnectionPtr& conn ) { return not conn->active(); } );
+    },
+    [&stack, connections, port, has_work] {
+      return stack.accept_queue_size( port ) > 0 or any_of( connections->begin(), connections->end(), has_work );
+    } );
+}
+
+//! Serve with one stack per queue of a multi-queue TUN device, each on its own core: the kernel steers each
+//! connection to one queue, so the stacks share nothing
+void serve_on_queues( const TCPConfig& c_fsm, const FdAdapterConfig& c_filt, const AppOptions& opts )
+{
+  TCPStackGroup group { opts.tundev == nullptr ? TUN_DFLT : opts.tundev, opts.queues, opts.offload, c_fsm };
+  const uint16_t port = c_filt.source.port();
+  for ( size_t queue = 0; queue < group.size(); ++queue ) {
+    group.post( queue, [port, queue]( TCPOverIPv4Stack& stack, EventLoop& loop ) {
+      stack.listen( port );
+      echo_connections( stack, loop, port, queue );
+    } );
+  }
+  cerr << "DEBUG: listening on port " << port << " with " << group.size() << " queues\n";
+
+  while ( true ) {
+    pause(); // the loops run until the process is killed
+  }
 }
 } // namespace
 
@@ -157,18 +306,33 @@ int main( int argc, char** argv )
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
-
-    if ( listen ) {
-      tcp_socket.listen_and_accept( c_fsm, c_filt );
+    auto [c_fsm, c_filt, opts] = get_config( args );
+    if ( opts.queues > 0 ) {
+      serve_on_queues( c_fsm, c_filt, opts );
+    } else if ( opts.udp ) {
+      UDPSocket udp_socket;
+      udp_socket.bind( c_filt.source );
+      LossyFdAdapter<TCPOverUDPAdapter> adapter { TCPOverUDPAdapter( move( udp_socket ) ) };
+      if ( c_filt.netem.enabled() ) {
+        NetEmTCPOverUDPMinnowSocket tcp_socket(
+          NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>( move( adapter ) ) );
+        run( tcp_socket, c_fsm, c_filt, opts );
+      } else {
+        LossyTCPOverUDPMinnowSocket tcp_socket( move( adapter ) );
+        run( tcp_socket, c_fsm, c_filt, opts );
+      }
     } else {
-      tcp_socket.connect( c_fsm, c_filt );
+      LossyFdAdapter<TCPOverIPv4OverTunFdAdapter> adapter {
+        TCPOverIPv4OverTunFdAdapter( TunFD( opts.tundev == nullptr ? TUN_DFLT : opts.tundev, opts.offload ) ) };
+      if ( c_filt.netem.enabled() ) {
+        NetEmTCPOverIPv4MinnowSocket tcp_socket(
+          NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>( move( adapter ) ) );
+        run( tcp_socket, c_fsm, c_filt, opts );
+      } else {
+        LossyTCPOverIPv4MinnowSocket tcp_socket( move( adapter ) );
+        run( tcp_socket, c_fsm, c_filt, opts );
+      }
     }
-
-    bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
-    tcp_socket.wait_until_closed();
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
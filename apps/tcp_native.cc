@@ -1,4 +1,5 @@
 #include "bidirectional_stream_copy.hh"
+#include "socket_bench.hh"
 
 #include <cstdlib>
 #include <cstring>
@@ -9,8 +10,9 @@ using namespace std;
 
 void show_usage( const char* argv0 )
 {
-  cerr << "Usage: " << argv0 << " [-l] <host> <port>\n\n"
-       << "  -l specifies listen mode; <host>:<port> is the listening address.\n";
+  cerr << "Usage: " << argv0 << " [-l] [benchmark options] <host> <port>\n\n"
+       << "  -l specifies listen mode; <host>:<port> is the listening address.\n\n"
+       << bench_usage();
 }
 
 int main( int argc, char** argv )
@@ -23,18 +25,29 @@ int main( int argc, char** argv )
     auto args = span( argv, argc );
 
     bool server_mode = false;
-    // NOLINTNEXTLINE(bugprone-assignment-*)
-    if ( argc < 3 || ( ( server_mode = ( strncmp( "-l", args[1], 3 ) == 0 ) ) && argc < 4 ) ) {
+    BenchConfig bench {};
+    size_t curr = 1;
+    while ( args.size() - curr > 2 ) {
+      if ( strncmp( "-l", args[curr], 3 ) == 0 ) {
+        server_mode = true;
+        curr += 1;
+      } else if ( not parse_bench_option( args.first( args.size() - 2 ), curr, bench ) ) {
+        show_usage( args[0] );
+        return EXIT_FAILURE;
+      }
+    }
+    if ( argc < 3 or args.size() - curr != 2 ) {
       show_usage( args[0] );
       return EXIT_FAILURE;
     }
+    const Address address { args[curr], args[curr + 1] };
 
     // in client mode, connect; in server mode, accept exactly one connection
     auto socket = [&] {
       if ( server_mode ) {
         TCPSocket listening_socket;                    // create a TCP socket
         listening_socket.set_reuseaddr();              // reuse the server's address as soon as the program quits
-        listening_socket.bind( { args[2], args[3] } ); // bind to specified address
+        listening_socket.bind( address );              // bind to specified address
         listening_socket.listen();                     // mark the socket as listening for incoming connections
         cerr << "DEBUG: Listening for incoming connection...\n";
         TCPSocket connected_socket = listening_socket.accept();
@@ -42,14 +55,17 @@ int main( int argc, char** argv )
         return connected_socket;
       }
       TCPSocket connecting_socket;
-      const Address peer { args[1], args[2] };
-      cerr << "DEBUG: Connecting to " << peer.to_string() << "... ";
-      connecting_socket.connect( peer );
+      cerr << "DEBUG: Connecting to " << address.to_string() << "... ";
+      connecting_socket.connect( address );
       cerr << "DEBUG: Successfully connected to " << connecting_socket.peer_address().to_string() << ".\n";
       return connecting_socket;
     }();
 
-    bidirectional_stream_copy( socket, socket.peer_address().to_string() );
+    if ( bench.enabled ) {
+      socket_bench( socket, bench, server_mode );
+    } else {
+      bidirectional_stream_copy( socket, socket.peer_address().to_string() );
+    }
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
@@ -0,0 +1,651 @@
+#include "address.hh"
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "helpers.hh"
+#include "network_interface.hh"
+#include "router.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A discrete-event simulation of N TCP connections sharing a bottleneck:
+//
+//   client 0 ---+
+//   client 1 ---+--- router ==(bottleneck)==> server
+//   ...      ---+
+//
+// Every client runs a TCPPeer that sends a bulk transfer to its own TCPPeer on the server. Each client has an
+// access link of its own (where the propagation delay lives); the router's link to the server has the
+// bottleneck rate and a drop-tail queue. Frames go through real NetworkInterfaces (with ARP) and the Router.
+// Time is virtual, so a run takes only as long as the CPU needs and always gives the same results.
+
+namespace {
+
+using SimTime = uint64_t; // virtual time, in microseconds
+
+constexpr SimTime US_PER_MS = 1000;
+constexpr SimTime US_PER_S = 1000 * US_PER_MS;
+
+constexpr uint64_t ACCESS_RATE = 1'000'000'000; // rate of the access links and of the server's uplink, in bit/s
+constexpr size_t ACCESS_QUEUE = 10'000;         // queue limit of the links other than the bottleneck, in frames
+constexpr uint16_t SERVER_PORT = 5000;
+constexpr uint16_t CLIENT_PORT = 40000;
+
+struct SimConfig
+{
+  size_t flows = 1;
+  SimTime duration = 10 * US_PER_S;
+  uint64_t bytes = 0; // per flow (0 means unlimited)
+
+  uint64_t rate = 10'000'000; // bottleneck rate, in bit/s
+  size_t queue = 100;         // bottleneck queue limit, in frames
+  SimTime delay = 10 * US_PER_MS;
+  SimTime delay_step = 0;
+  SimTime start_interval = 0;
+
+  TCPConfig tcp {};
+  uint64_t seed = 1;
+  bool verbose = false;
+};
+
+void show_usage( const char* argv0, const char* msg )
+{
+  const SimConfig dflt;
+  cout << "Usage: " << argv0 << " [options]\n\n"
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -n <flows>      Number of TCP connections                       " << dflt.flows << "\n"
+       << "   -t <seconds>    Simulated time to run for                       " << dflt.duration / US_PER_S << "\n"
+       << "   -b <bytes>      Bytes sent by each flow (0: send until the end) " << dflt.bytes << "\n\n"
+
+       << "   -r <bit/s>      Bottleneck rate                                 " << dflt.rate << "\n"
+       << "   -q <frames>     Bottleneck queue limit                          " << dflt.queue << "\n"
+       << "   -d <ms>         One-way delay of each flow's access link        " << dflt.delay / US_PER_MS << "\n"
+       << "   -D <ms>         Extra one-way delay per flow (flow i gets i*D)  " << dflt.delay_step / US_PER_MS
+       << "\n"
+       << "   -i <ms>         Interval between the starts of flows            " << dflt.start_interval / US_PER_MS
+       << "\n\n"
+
+       << "   -w <winsz>      Receive capacity (window) in bytes              " << dflt.tcp.recv_capacity << "\n"
+       << "   -c <bytes>      Send capacity in bytes                          " << dflt.tcp.send_capacity << "\n"
+       << "   -T <tmout>      Set rt_timeout to tmout                         " << dflt.tcp.rt_timeout << "\n"
+       << "   -S <seed>       Seed for the initial sequence numbers           " << dflt.seed << "\n"
+       << "   -v              Keep the Router's per-datagram debug output     (off)\n\n"
+
+       << "   -h              Show this message.\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << "\n";
+}
+
+SimConfig get_config( const span<char*>& args )
+{
+  SimConfig cfg {};
+
+  for ( size_t curr = 1; curr < args.size(); curr += 2 ) {
+    const string option = args[curr];
+    if ( option == "-h" ) {
+      show_usage( args[0], nullptr );
+      exit( 0 );
+    }
+    if ( option == "-v" ) {
+      cfg.verbose = true;
+      --curr;
+      continue;
+    }
+    if ( curr + 1 >= args.size() ) {
+      show_usage( args[0], string( "ERROR: " + option + " requires one argument." ).c_str() );
+      exit( 1 );
+    }
+
+    const char* value = args[curr + 1];
+    if ( option == "-n" ) {
+      cfg.flows = strtoull( value, nullptr, 0 );
+    } else if ( option == "-t" ) {
+      cfg.duration = static_cast<SimTime>( strtod( value, nullptr ) * US_PER_S );
+    } else if ( option == "-b" ) {
+      cfg.bytes = static_cast<uint64_t>( strtod( value, nullptr ) );
+    } else if ( option == "-r" ) {
+      cfg.rate = static_cast<uint64_t>( strtod( value, nullptr ) );
+    } else if ( option == "-q" ) {
+      cfg.queue = strtoull( value, nullptr, 0 );
+    } else if ( option == "-d" ) {
+      cfg.delay = static_cast<SimTime>( strtod( value, nullptr ) * US_PER_MS );
+    } else if ( option == "-D" ) {
+      cfg.delay_step = static_cast<SimTime>( strtod( value, nullptr ) * US_PER_MS );
+    } else if ( option == "-i" ) {
+      cfg.start_interval = static_cast<SimTime>( strtod( value, nullptr ) * US_PER_MS );
+    } else if ( option == "-w" ) {
+      cfg.tcp.recv_capacity = strtoull( value, nullptr, 0 );
+    } else if ( option == "-c" ) {
+      cfg.tcp.send_capacity = strtoull( value, nullptr, 0 );
+    } else if ( option == "-T" ) {
+      cfg.tcp.rt_timeout = static_cast<uint16_t>( strtoul( value, nullptr, 0 ) );
+    } else if ( option == "-S" ) {
+      cfg.seed = strtoull( value, nullptr, 0 );
+    } else {
+      show_usage( args[0], string( "ERROR: unrecognized option " + option ).c_str() );
+      exit( 1 );
+    }
+  }
+
+  if ( cfg.flows == 0 or cfg.flows > 0xffff ) {
+    show_usage( args[0], "ERROR: the number of flows must be between 1 and 65535." );
+    exit( 1 );
+  }
+  if ( cfg.rate == 0 ) {
+    show_usage( args[0], "ERROR: the bottleneck rate cannot be zero." );
+    exit( 1 );
+  }
+
+  return cfg;
+}
+
+//! Callbacks to run at given virtual times (in time order, and in the order scheduled within the same time)
+class EventQueue
+{
+  struct Event
+  {
+    SimTime when;
+    uint64_t order;
+    function<void()> action;
+
+    bool operator>( const Event& other ) const
+    {
+      return when != other.when ? when > other.when : order > other.order;
+    }
+  };
+
+  vector<Event> events_ {}; // a min-heap
+  uint64_t scheduled_ {};
+  SimTime now_ {};
+
+public:
+  SimTime now() const { return now_; }
+
+  void schedule( const SimTime when, function<void()> action )
+  {
+    events_.push_back( { max( when, now_ ), scheduled_++, move( action ) } );
+    push_heap( events_.begin(), events_.end(), greater {} );
+  }
+
+  // Run the events due up to `end`, then move the clock to `end`
+  void run_until( const SimTime end )
+  {
+    while ( not events_.empty() and events_.front().when <= end ) {
+      pop_heap( events_.begin(), events_.end(), greater {} );
+      Event event = move( events_.back() );
+      events_.pop_back();
+      now_ = event.when;
+      event.action();
+    }
+    now_ = end;
+  }
+};
+
+//! A one-way link: frames queue (up to a limit) to be serialized at the link's rate, then arrive after its delay
+class Link : public NetworkInterface::OutputPort
+{
+public:
+  struct Stats
+  {
+    uint64_t frames {};
+    uint64_t bytes {};
+    uint64_t drops {};
+    uint64_t queue_samples {};
+    uint64_t queue_total {};
+    size_t queue_max {};
+  };
+
+  Link( EventQueue& events, const uint64_t rate, const SimTime delay, const size_t queue_limit )
+    : events_( events ), rate_( rate ), delay_( delay ), queue_limit_( queue_limit )
+  {}
+
+  void connect( const shared_ptr<NetworkInterface>& receiver, function<void()> on_delivery )
+  {
+    receiver_ = receiver;
+    on_delivery_ = move( on_delivery );
+  }
+
+  void transmit( const NetworkInterface& sender [[maybe_unused]], const EthernetFrame& frame ) override
+  {
+    const size_t queued = queue_length();
+    if ( queued >= queue_limit_ ) {
+      ++stats_.drops;
+      return;
+    }
+
+    size_t size = EthernetHeader::LENGTH;
+    for ( const auto& buffer : frame.payload ) {
+      size += buffer->size();
+    }
+    ++stats_.frames;
+    stats_.bytes += size;
+
+    busy_until_ = max( busy_until_, events_.now() ) + size * 8 * US_PER_S / rate_;
+    departures_.push_back( busy_until_ );
+    stats_.queue_max = max( stats_.queue_max, queued + 1 );
+
+    // frames arrive in the order they were sent, so the event only needs to say when
+    in_flight_.push( clone( frame ) );
+    events_.schedule( busy_until_ + delay_, [this] { deliver(); } );
+  }
+
+  // Frames waiting to be serialized, including the one being serialized now
+  size_t queue_length()
+  {
+    while ( not departures_.empty() and departures_.front() <= events_.now() ) {
+      departures_.pop_front();
+    }
+    return departures_.size();
+  }
+
+  void sample_queue()
+  {
+    ++stats_.queue_samples;
+    stats_.queue_total += queue_length();
+  }
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  void deliver()
+  {
+    EthernetFrame frame = move( in_flight_.front() );
+    in_flight_.pop();
+    if ( const auto receiver = receiver_.lock() ) {
+      receiver->recv_frame( move( frame ) );
+      on_delivery_();
+    }
+  }
+
+  EventQueue& events_;
+  uint64_t rate_;
+  SimTime delay_;
+  size_t queue_limit_;
+
+  weak_ptr<NetworkInterface> receiver_ {};
+  function<void()> on_delivery_ {};
+
+  SimTime busy_until_ {};
+  deque<SimTime> departures_ {}; // when each queued frame finishes serializing
+  queue<EthernetFrame> in_flight_ {};
+  Stats stats_ {};
+};
+
+//! One TCP connection, from a client to the server, and its statistics
+struct Flow
+{
+  size_t index;
+  SimTime start;
+  TCPConfig client_config;
+  TCPPeer client;
+  TCPPeer server;
+  TCPOverIPv4Adapter client_adapter {};
+  TCPOverIPv4Adapter server_adapter {};
+  shared_ptr<NetworkInterface> client_interface {};
+  Address client_gateway;
+  TCPPeer::TransmitFunction client_transmit {};
+  TCPPeer::TransmitFunction server_transmit {};
+  bool started {};
+
+  uint64_t bytes_written {};
+  uint64_t bytes_delivered {};
+  uint64_t retransmissions {};
+  optional<SimTime> finish {};
+
+  // RTT samples, taken (as in Karn's algorithm) only from segments that were never retransmitted
+  uint64_t highest_sent {};               // absolute seqno just past the highest sent so far
+  deque<pair<uint64_t, SimTime>> sent {}; // (end seqno, time sent) of segments not yet acknowledged
+  uint64_t rtt_samples {};
+  SimTime rtt_total {};
+  SimTime rtt_min = numeric_limits<SimTime>::max();
+  SimTime rtt_max {};
+
+  Flow( size_t s_index, SimTime s_start, const TCPConfig& c_client, const TCPConfig& c_server, Address gateway )
+    : index( s_index )
+    , start( s_start )
+    , client_config( c_client )
+    , client( c_client )
+    , server( c_server )
+    , client_gateway( move( gateway ) )
+  {}
+};
+
+class Simulation
+{
+public:
+  explicit Simulation( const SimConfig& cfg );
+
+  void run();
+  void report( double wall_seconds ) const;
+
+private:
+  static EthernetAddress ethernet_address( size_t n )
+  {
+    return { 0x02, 0, 0, 0, static_cast<uint8_t>( n >> 8 ), static_cast<uint8_t>( n ) };
+  }
+
+  void fill( Flow& flow );
+  void send_from_client( Flow& flow, const TCPMessage& msg );
+  void receive_at_client( Flow& flow );
+  void receive_at_server();
+  bool finished() const;
+
+  SimConfig cfg_;
+  EventQueue events_ {};
+  Router router_ {};
+  vector<shared_ptr<NetworkInterface>> interfaces_ {}; // every interface, to tick
+  vector<shared_ptr<Link>> links_ {};
+  shared_ptr<Link> bottleneck_ {};
+  shared_ptr<NetworkInterface> server_interface_ {};
+  Address server_gateway_ { "192.168.0.1" };
+  vector<unique_ptr<Flow>> flows_ {};
+  unordered_map<uint32_t, size_t> flow_by_address_ {}; // client IPv4 address => flow index
+  SimTime end_ {};
+};
+
+Simulation::Simulation( const SimConfig& cfg ) : cfg_( cfg )
+{
+  const Address server_address { "192.168.0.2" };
+  size_t ethernet_count = 0;
+
+  // the router's side of a link is always connected so that delivery runs the router
+  const auto add_link_pair = [&]( const string& name,
+                                  const Address& router_address,
+                                  const shared_ptr<Link>& to_router,
+                                  const shared_ptr<Link>& from_router,
+                                  const uint32_t prefix ) {
+    auto router_interface
+      = make_shared<NetworkInterface>( "router-" + name, from_router, ethernet_address( ethernet_count++ ), router_address );
+    to_router->connect( router_interface, [this] { router_.route(); } );
+    router_.add_route( prefix, 24, {}, router_.add_interface( router_interface ) );
+    interfaces_.push_back( router_interface );
+    links_.push_back( to_router );
+    links_.push_back( from_router );
+  };
+
+  // the server, behind the bottleneck
+  bottleneck_ = make_shared<Link>( events_, cfg_.rate, 0, cfg_.queue );
+  const auto server_uplink = make_shared<Link>( events_, ACCESS_RATE, 0, ACCESS_QUEUE );
+  server_interface_
+    = make_shared<NetworkInterface>( "server", server_uplink, ethernet_address( ethernet_count++ ), server_address );
+  bottleneck_->connect( server_interface_, [this] { receive_at_server(); } );
+  interfaces_.push_back( server_interface_ );
+  add_link_pair( "server", server_gateway_, server_uplink, bottleneck_, server_address.ipv4_numeric() & 0xffffff00 );
+
+  // the clients, each on its own subnet 10.x.y.0/24
+  default_random_engine rd { cfg_.seed };
+  for ( size_t i = 0; i < cfg_.flows; ++i ) {
+    const uint32_t subnet = ( 10U << 24 ) | ( static_cast<uint32_t>( i ) << 8 );
+    const Address gateway = Address::from_ipv4_numeric( subnet | 1 );
+    const Address client_address = Address::from_ipv4_numeric( subnet | 2 );
+    const SimTime delay = cfg_.delay + i * cfg_.delay_step;
+
+    TCPConfig client_config = cfg_.tcp;
+    TCPConfig server_config = cfg_.tcp;
+    client_config.isn = Wrap32 { static_cast<uint32_t>( rd() ) };
+    server_config.isn = Wrap32 { static_cast<uint32_t>( rd() ) };
+
+    auto& flow = *flows_.emplace_back(
+      make_unique<Flow>( i, i * cfg_.start_interval, client_config, server_config, gateway ) );
+
+    const auto uplink = make_shared<Link>( events_, ACCESS_RATE, delay, ACCESS_QUEUE );
+    const auto downlink = make_shared<Link>( events_, ACCESS_RATE, delay, ACCESS_QUEUE );
+    flow.client_interface = make_shared<NetworkInterface>(
+      "client" + to_string( i ), uplink, ethernet_address( ethernet_count++ ), client_address );
+    downlink->connect( flow.client_interface, [this, &flow] { receive_at_client( flow ); } );
+    interfaces_.push_back( flow.client_interface );
+    add_link_pair( "client" + to_string( i ), gateway, uplink, downlink, subnet );
+
+    flow.client_adapter.config_mut().source = Address { client_address.ip(), CLIENT_PORT };
+    flow.client_adapter.config_mut().destination = Address { server_address.ip(), SERVER_PORT };
+    flow.server_adapter.config_mut().source = flow.client_adapter.config().destination;
+    flow.server_adapter.config_mut().destination = flow.client_adapter.config().source;
+    flow_by_address_.emplace( client_address.ipv4_numeric(), i );
+
+    flow.client_transmit = [this, &flow]( const TCPMessage& msg ) { send_from_client( flow, msg ); };
+    flow.server_transmit = [this, &flow]( const TCPMessage& msg ) {
+      server_interface_->send_datagram( flow.server_adapter.wrap_tcp_in_ip( msg ), server_gateway_ );
+    };
+  }
+}
+
+void Simulation::fill( Flow& flow )
+{
+  auto& writer = flow.client.outbound_writer();
+  if ( writer.is_closed() ) {
+    return;
+  }
+
+  uint64_t len = writer.available_capacity();
+  if ( cfg_.bytes != 0 ) {
+    len = min( len, cfg_.bytes - flow.bytes_written );
+  }
+  if ( len > 0 ) {
+    writer.push( string( len, 'x' ) );
+    flow.bytes_written += len;
+  }
+  if ( cfg_.bytes != 0 and flow.bytes_written == cfg_.bytes ) {
+    writer.close();
+  }
+}
+
+void Simulation::send_from_client( Flow& flow, const TCPMessage& msg )
+{
+  const TCPSenderMessage& seg = msg.sender.get();
+  if ( seg.sequence_length() > 0 ) {
+    const uint64_t first = seg.seqno.unwrap( flow.client_config.isn, flow.highest_sent );
+    if ( first < flow.highest_sent ) {
+      ++flow.retransmissions;
+      flow.sent.clear();
+    } else {
+      flow.highest_sent = first + seg.sequence_length();
+      flow.sent.emplace_back( flow.highest_sent, events_.now() );
+    }
+  }
+
+  flow.client_interface->send_datagram( flow.client_adapter.wrap_tcp_in_ip( msg ), flow.client_gateway );
+}
+
+void Simulation::receive_at_client( Flow& flow )
+{
+  auto& datagrams = flow.client_interface->datagrams_received();
+  while ( not datagrams.empty() ) {
+    auto msg = flow.client_adapter.unwrap_tcp_in_ip( move( datagrams.front() ), false );
+    datagrams.pop();
+    if ( not msg ) {
+      continue;
+    }
+
+    if ( msg->receiver->ackno.has_value() ) {
+      const uint64_t ackno = msg->receiver->ackno->unwrap( flow.client_config.isn, flow.highest_sent );
+      optional<SimTime> sent_at;
+      while ( not flow.sent.empty() and flow.sent.front().first <= ackno ) {
+        sent_at = flow.sent.front().second;
+        flow.sent.pop_front();
+      }
+      if ( sent_at.has_value() ) {
+        const SimTime rtt = events_.now() - sent_at.value();
+        ++flow.rtt_samples;
+        flow.rtt_total += rtt;
+        flow.rtt_min = min( flow.rtt_min, rtt );
+        flow.rtt_max = max( flow.rtt_max, rtt );
+      }
+    }
+
+    flow.client.receive( move( msg.value() ), flow.client_transmit );
+    fill( flow );
+    flow.client.push( flow.client_transmit );
+  }
+}
+
+void Simulation::receive_at_server()
+{
+  auto& datagrams = server_interface_->datagrams_received();
+  while ( not datagrams.empty() ) {
+    InternetDatagram dgram = move( datagrams.front() );
+    datagrams.pop();
+
+    const auto it = flow_by_address_.find( dgram.header.src );
+    if ( it == flow_by_address_.end() ) {
+      continue;
+    }
+    Flow& flow = *flows_.at( it->second );
+    auto msg = flow.server_adapter.unwrap_tcp_in_ip( move( dgram ), false );
+    if ( not msg ) {
+      continue;
+    }
+    flow.server.receive( move( msg.value() ), flow.server_transmit );
+
+    // the application reads everything straight away
+    Reader& reader = flow.server.inbound_reader();
+    while ( reader.bytes_buffered() ) {
+      const uint64_t len = reader.peek().size();
+      reader.pop( len );
+      flow.bytes_delivered += len;
+    }
+    flow.server.update_window( flow.server_transmit );
+    if ( reader.is_finished() and not flow.finish.has_value() ) {
+      flow.finish = events_.now();
+    }
+  }
+}
+
+bool Simulation::finished() const
+{
+  return cfg_.bytes != 0 and ranges::all_of( flows_, []( const auto& flow ) { return flow->finish.has_value(); } );
+}
+
+// Advance the clock a millisecond at a time: run the events due by then, then tick everything
+void Simulation::run()
+{
+  for ( SimTime now = 0; now < cfg_.duration and not finished(); now += US_PER_MS ) {
+    events_.run_until( now );
+    end_ = now;
+
+    for ( const auto& flow : flows_ ) {
+      if ( not flow->started and now >= flow->start ) {
+        flow->started = true;
+        fill( *flow );
+        flow->client.push( flow->client_transmit );
+      }
+      if ( flow->started ) {
+        flow->client.tick( 1, flow->client_transmit );
+        flow->server.tick( 1, flow->server_transmit );
+      }
+    }
+
+    for ( const auto& interface : interfaces_ ) {
+      interface->tick( 1 );
+    }
+    for ( const auto& link : links_ ) {
+      link->sample_queue();
+    }
+  }
+}
+
+void Simulation::report( const double wall_seconds ) const
+{
+  const double simulated_seconds = static_cast<double>( end_ ) / US_PER_S;
+  const auto ms = []( const double us ) { return us / US_PER_MS; };
+
+  cout << fixed << setprecision( 2 );
+  cout << "flow  base RTT (ms)  delivered (B)  goodput (Mbit/s)   retx  RTT min/avg/max (ms)      finished (s)\n";
+
+  uint64_t total_delivered = 0;
+  for ( const auto& flow : flows_ ) {
+    const SimTime stop = flow->finish.value_or( end_ );
+    const double active_seconds = static_cast<double>( stop - min( stop, flow->start ) ) / US_PER_S;
+    const double goodput = active_seconds > 0 ? 8 * static_cast<double>( flow->bytes_delivered ) / active_seconds : 0;
+    const double base_rtt = 2.0 * static_cast<double>( cfg_.delay + flow->index * cfg_.delay_step );
+    total_delivered += flow->bytes_delivered;
+
+    cout << setw( 4 ) << flow->index << setw( 15 ) << ms( base_rtt ) << setw( 15 ) << flow->bytes_delivered
+         << setw( 18 ) << goodput / 1e6 << setw( 7 ) << flow->retransmissions << "  ";
+    if ( flow->rtt_samples > 0 ) {
+      cout << setw( 7 ) << ms( static_cast<double>( flow->rtt_min ) ) << " / " << setw( 7 )
+           << ms( static_cast<double>( flow->rtt_total ) / static_cast<double>( flow->rtt_samples ) ) << " / "
+           << setw( 7 ) << ms( static_cast<double>( flow->rtt_max ) );
+    } else {
+      cout << setw( 27 ) << "-";
+    }
+    if ( flow->finish.has_value() ) {
+      cout << setw( 12 ) << static_cast<double>( flow->finish.value() ) / US_PER_S;
+    } else {
+      cout << setw( 12 ) << "-";
+    }
+    cout << "\n";
+  }
+
+  const auto& bottleneck = bottleneck_->stats();
+  const double utilization
+    = simulated_seconds > 0
+        ? 8 * static_cast<double>( bottleneck.bytes ) / ( static_cast<double>( cfg_.rate ) * simulated_seconds )
+        : 0;
+  cout << "\nbottleneck: " << static_cast<double>( cfg_.rate ) / 1e6 << " Mbit/s, " << 100 * utilization
+       << "% utilized, " << bottleneck.frames << " frames, " << bottleneck.drops << " dropped, queue avg "
+       << ( bottleneck.queue_samples > 0
+              ? static_cast<double>( bottleneck.queue_total ) / static_cast<double>( bottleneck.queue_samples )
+              : 0 )
+       << " / max " << bottleneck.queue_max << " of " << cfg_.queue << " frames\n";
+  cout << "total goodput: "
+       << ( simulated_seconds > 0 ? 8 * static_cast<double>( total_delivered ) / simulated_seconds / 1e6 : 0 )
+       << " Mbit/s\n";
+  cout << "simulated " << simulated_seconds << " s in " << wall_seconds << " s of real time ("
+       << ( wall_seconds > 0 ? simulated_seconds / wall_seconds : 0 ) << "x)\n";
+}
+} // namespace
+
+int main( int argc, char** argv )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    const SimConfig cfg = get_config( args );
+
+    // the Router reports every datagram on stderr, which would take most of the time
+    if ( not cfg.verbose ) {
+      cerr.setstate( ios::badbit );
+    }
+
+    Simulation sim { cfg };
+    const auto start = chrono::steady_clock::now();
+    sim.run();
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    sim.report( elapsed.count() );
+  } catch ( const exception& e ) {
+    cerr.clear();
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
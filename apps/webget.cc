@@ -1,9 +1,22 @@
+#include "eventloop.hh"
 #include "tcp_minnow_socket.hh"
+#include "tcp_stack.hh"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -29,6 +42,564 @@ void get_URL( const string& host, const string& path )
   clientSocket.wait_until_closed();
 }
 
+// With a list of URLs, webget fetches them all over one TCPStack (many connections sharing the TUN device):
+// each host gets a few persistent connections (HTTP/1.1 keep-alive), each connection has several requests in
+// flight at once (pipelining), and all the hosts are fetched concurrently from one EventLoop. It reports the
+// latency of each request, from writing it to reading the end of its response.
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+constexpr unsigned MAX_ATTEMPTS = 3; // times a request is sent before giving up on it
+
+struct FetchConfig
+{
+  vector<string> urls {};
+  size_t depth = 4;       // requests in flight per connection (1: no pipelining)
+  size_t connections = 1; // connections per host
+  size_t repeat = 1;      // times each URL is fetched
+  uint16_t rt_timeout = 100;
+  string tundev = "tun144";
+  string source_address = "169.254.144.9";
+  bool quiet = false;
+};
+
+void show_usage( const char* argv0, const char* msg )
+{
+  const FetchConfig dflt;
+  cout << "Usage: " << argv0 << " HOST PATH\n"
+       << "       " << argv0 << " [options] URL...\n\n"
+       << "   The first form fetches one page over its own connection and prints the response.\n"
+       << "   The second fetches every URL (http://host[:port]/path), reusing connections, and prints\n"
+       << "   the status, size and latency of each request and then latency percentiles.\n\n"
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -f <file>       Also fetch the URLs in <file>, one per line\n"
+       << "   -p <depth>      Requests in flight per connection (pipelining)  " << dflt.depth << "\n"
+       << "   -c <conns>      Connections per host                            " << dflt.connections << "\n"
+       << "   -n <times>      Fetch each URL this many times                  " << dflt.repeat << "\n"
+       << "   -t <tmout>      Set rt_timeout to tmout                         " << dflt.rt_timeout << "\n"
+       << "   -d <tundev>     Connect to <tundev>                             " << dflt.tundev << "\n"
+       << "   -a <addr>       Set source address                              " << dflt.source_address << "\n"
+       << "   -q              Print only the summary                          (off)\n\n"
+
+       << "   -h              Show this message.\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << "\n";
+}
+
+void read_url_file( const char* argv0, const string& filename, vector<string>& urls )
+{
+  ifstream file { filename };
+  if ( not file ) {
+    show_usage( argv0, string( "ERROR: could not open " + filename ).c_str() );
+    exit( 1 );
+  }
+  for ( string line; getline( file, line ); ) {
+    const auto start = line.find_first_not_of( " \t\r" );
+    if ( start == string::npos or line[start] == '#' ) {
+      continue;
+    }
+    const auto end = line.find_last_not_of( " \t\r" );
+    urls.push_back( line.substr( start, end - start + 1 ) );
+  }
+}
+
+FetchConfig get_config( const span<char*>& args )
+{
+  FetchConfig cfg {};
+
+  for ( size_t curr = 1; curr < args.size(); ++curr ) {
+    const string option = args[curr];
+    if ( option.empty() or option[0] != '-' ) {
+      cfg.urls.push_back( option );
+      continue;
+    }
+    if ( option == "-h" ) {
+      show_usage( args[0], nullptr );
+      exit( 0 );
+    }
+    if ( option == "-q" ) {
+      cfg.quiet = true;
+      continue;
+    }
+    if ( curr + 1 >= args.size() ) {
+      show_usage( args[0], string( "ERROR: " + option + " requires one argument." ).c_str() );
+      exit( 1 );
+    }
+
+    const char* value = args[++curr];
+    if ( option == "-f" ) {
+      read_url_file( args[0], value, cfg.urls );
+    } else if ( option == "-p" ) {
+      cfg.depth = strtoull( value, nullptr, 0 );
+    } else if ( option == "-c" ) {
+      cfg.connections = strtoull( value, nullptr, 0 );
+    } else if ( option == "-n" ) {
+      cfg.repeat = strtoull( value, nullptr, 0 );
+    } else if ( option == "-t" ) {
+      cfg.rt_timeout = static_cast<uint16_t>( strtoul( value, nullptr, 0 ) );
+    } else if ( option == "-d" ) {
+      cfg.tundev = value;
+    } else if ( option == "-a" ) {
+      cfg.source_address = value;
+    } else {
+      show_usage( args[0], string( "ERROR: unrecognized option " + option ).c_str() );
+      exit( 1 );
+    }
+  }
+
+  if ( cfg.urls.empty() ) {
+    show_usage( args[0], "ERROR: no URLs to fetch." );
+    exit( 1 );
+  }
+  if ( cfg.depth == 0 or cfg.connections == 0 ) {
+    show_usage( args[0], "ERROR: the pipeline depth and connections per host must be at least 1." );
+    exit( 1 );
+  }
+
+  return cfg;
+}
+
+struct URL
+{
+  string host;
+  string port;
+  string path;
+};
+
+// Split "http://host[:port][/path]" (the scheme is optional)
+URL parse_url( string_view text )
+{
+  if ( const auto scheme = text.find( "://" ); scheme != string_view::npos ) {
+    if ( text.substr( 0, scheme ) != "http" ) {
+      throw runtime_error( "webget: only http:// URLs are supported: " + string { text } );
+    }
+    text.remove_prefix( scheme + 3 );
+  }
+
+  const auto slash = text.find( '/' );
+  const string_view authority = text.substr( 0, slash );
+  URL url { string { authority }, "http", slash == string_view::npos ? "/" : string { text.substr( slash ) } };
+  if ( const auto colon = authority.find( ':' ); colon != string_view::npos ) {
+    url.host = authority.substr( 0, colon );
+    url.port = authority.substr( colon + 1 );
+  }
+  if ( url.host.empty() ) {
+    throw runtime_error( "webget: no host in URL: " + string { text } );
+  }
+  return url;
+}
+
+bool iequals( const string_view a, const string_view b )
+{
+  return ranges::equal( a, b, []( char x, char y ) { return tolower( x ) == tolower( y ); } );
+}
+
+bool icontains( const string_view haystack, const string_view needle )
+{
+  return not ranges::search( haystack, needle, []( char x, char y ) { return tolower( x ) == tolower( y ); } )
+               .empty();
+}
+
+// Incremental parser for a sequence of HTTP/1.x responses on one connection. Bodies are counted, not kept.
+class ResponseParser
+{
+  enum class State : uint8_t
+  {
+    StatusLine,
+    Headers,
+    Body,        // Content-Length bytes
+    ChunkSize,   // the line giving the size of the next chunk
+    ChunkData,   // the chunk itself
+    ChunkEnd,    // the CRLF after a chunk
+    Trailers,    // header lines after the last chunk
+    UntilClose,  // the body is the rest of the stream
+    Done
+  };
+
+  State state_ { State::StatusLine };
+  string line_ {};
+  unsigned status_ {};
+  bool keep_alive_ {};
+  bool chunked_ {};
+  optional<uint64_t> content_length_ {};
+  uint64_t remaining_ {};
+  uint64_t body_bytes_ {};
+
+  void start_body()
+  {
+    if ( ( status_ >= 100 and status_ < 200 ) or status_ == 204 or status_ == 304 ) {
+      state_ = status_ < 200 ? State::StatusLine : State::Done; // (an interim response comes before the real one)
+    } else if ( chunked_ ) {
+      state_ = State::ChunkSize;
+    } else if ( content_length_.has_value() ) {
+      remaining_ = *content_length_;
+      state_ = remaining_ > 0 ? State::Body : State::Done;
+    } else {
+      keep_alive_ = false;
+      state_ = State::UntilClose;
+    }
+  }
+
+  void parse_line( const string_view line )
+  {
+    switch ( state_ ) {
+      case State::StatusLine: {
+        if ( line.empty() ) {
+          return; // (tolerate a stray CRLF between responses)
+        }
+        if ( not line.starts_with( "HTTP/1." ) or line.size() < 12 ) {
+          throw runtime_error( "webget: bad status line: " + string { line } );
+        }
+        keep_alive_ = line[7] != '0'; // HTTP/1.0 closes unless it says otherwise
+        status_ = strtoul( string { line.substr( 9, 3 ) }.c_str(), nullptr, 10 );
+        chunked_ = false;
+        content_length_.reset();
+        state_ = State::Headers;
+        return;
+      }
+      case State::Headers: {
+        if ( line.empty() ) {
+          start_body();
+          return;
+        }
+        const auto colon = line.find( ':' );
+        if ( colon == string_view::npos ) {
+          return;
+        }
+        const string_view name = line.substr( 0, colon );
+        const string_view value = line.substr( colon + 1 );
+        if ( iequals( name, "Content-Length" ) ) {
+          content_length_ = strtoull( string { value }.c_str(), nullptr, 10 );
+        } else if ( iequals( name, "Transfer-Encoding" ) ) {
+          chunked_ = icontains( value, "chunked" );
+        } else if ( iequals( name, "Connection" ) ) {
+          keep_alive_ = icontains( value, "keep-alive" ) or ( keep_alive_ and not icontains( value, "close" ) );
+        }
+        return;
+      }
+      case State::ChunkSize:
+        remaining_ = strtoull( string { line.substr( 0, line.find( ';' ) ) }.c_str(), nullptr, 16 );
+        state_ = remaining_ > 0 ? State::ChunkData : State::Trailers;
+        return;
+      case State::ChunkEnd:
+        state_ = State::ChunkSize;
+        return;
+      case State::Trailers:
+        if ( line.empty() ) {
+          state_ = State::Done;
+        }
+        return;
+      default:
+        return;
+    }
+  }
+
+public:
+  // Parse from `data` up to the end of the current response; returns the number of bytes used
+  size_t parse( const string_view data )
+  {
+    size_t used = 0;
+    while ( used < data.size() and state_ != State::Done ) {
+      const string_view rest = data.substr( used );
+      if ( state_ == State::Body or state_ == State::ChunkData or state_ == State::UntilClose ) {
+        const size_t len = state_ == State::UntilClose ? rest.size() : min<uint64_t>( remaining_, rest.size() );
+        body_bytes_ += len;
+        remaining_ -= state_ == State::UntilClose ? 0 : len;
+        used += len;
+        if ( remaining_ == 0 and state_ != State::UntilClose ) {
+          state_ = state_ == State::Body ? State::Done : State::ChunkEnd;
+        }
+        continue;
+      }
+
+      const auto newline = rest.find( '\n' );
+      if ( newline == string_view::npos ) {
+        line_.append( rest );
+        used = data.size();
+        break;
+      }
+      line_.append( rest.substr( 0, newline ) );
+      used += newline + 1;
+      if ( line_.ends_with( '\r' ) ) {
+        line_.pop_back();
+      }
+      parse_line( line_ );
+      line_.clear();
+    }
+    return used;
+  }
+
+  // The stream has ended: a body that runs until the close is complete
+  void finish()
+  {
+    if ( state_ == State::UntilClose ) {
+      state_ = State::Done;
+    }
+  }
+
+  // Has a response been parsed? (Call reset() before parsing the next one.)
+  bool done() const { return state_ == State::Done; }
+
+  // Is the response under way? (If the connection ends now, it is incomplete.)
+  bool started() const { return state_ != State::StatusLine or not line_.empty(); }
+
+  unsigned status() const { return status_; }
+  bool keep_alive() const { return keep_alive_; }
+  uint64_t body_bytes() const { return body_bytes_; }
+
+  void reset()
+  {
+    state_ = State::StatusLine;
+    body_bytes_ = 0;
+  }
+};
+
+struct Request
+{
+  size_t index;      // position in the list of URLs
+  const string* url; // as given
+  string text;       // the HTTP request
+  unsigned attempts {};
+  Clock::time_point sent {};
+};
+
+// The outcome of each request
+struct Result
+{
+  unsigned status {}; // 0 if the request failed
+  uint64_t body_bytes {};
+  double latency_ms {};
+};
+
+struct Host;
+
+// A persistent connection to a Host, with the requests written to it and not yet answered (in order)
+struct HostConnection
+{
+  TCPOverIPv4Stack::ConnectionPtr conn;
+  deque<Request> in_flight {};
+  ResponseParser parser {};
+  bool retired {}; // no more requests will be written (the writer is closed)
+};
+
+struct Host
+{
+  Address address;
+  deque<Request> pending {}; // requests not yet written to a connection
+  vector<HostConnection> connections {};
+};
+
+class Fetcher
+{
+  const FetchConfig& cfg_;
+  TCPOverIPv4Stack stack_;
+  EventLoop loop_ {};
+  map<pair<string, string>, Host> hosts_ {};
+  vector<Result> results_ {};
+  size_t outstanding_ {}; // requests not yet answered or given up on
+
+  void report( const Request& request, const Result& result )
+  {
+    results_.at( request.index ) = result;
+    --outstanding_;
+    if ( not cfg_.quiet ) {
+      cout << setw( 3 ) << result.status << " " << setw( 10 ) << result.body_bytes << " bytes " << fixed
+           << setprecision( 3 ) << setw( 10 ) << result.latency_ms << " ms  " << *request.url << "\n";
+    }
+  }
+
+  // Send unanswered requests again on another connection (they go back to the front, in order)
+  void requeue( Host& host, deque<Request>& requests )
+  {
+    while ( not requests.empty() ) {
+      Request request = move( requests.back() );
+      requests.pop_back();
+      if ( ++request.attempts >= MAX_ATTEMPTS ) {
+        cerr << "webget: giving up on " << *request.url << "\n";
+        report( request, {} );
+      } else {
+        host.pending.push_front( move( request ) );
+      }
+    }
+  }
+
+  static void retire( HostConnection& hc )
+  {
+    if ( not hc.retired ) {
+      hc.retired = true;
+      hc.conn->outbound_writer().close();
+    }
+  }
+
+  // Read what the server has sent, and finish the responses it completes
+  void read_responses( Host& host, HostConnection& hc )
+  {
+    const TCPOverIPv4Stack::Connection& view = *hc.conn;
+    if ( view.inbound_reader().bytes_buffered() == 0 ) {
+      return;
+    }
+    Reader& reader = hc.conn->inbound_reader();
+    while ( reader.bytes_buffered() > 0 ) {
+      if ( hc.in_flight.empty() ) {
+        reader.pop( reader.bytes_buffered() ); // (nothing was asked for)
+        break;
+      }
+      reader.pop( hc.parser.parse( reader.peek() ) );
+      if ( hc.parser.done() ) {
+        finish_response( host, hc );
+      }
+    }
+  }
+
+  void finish_response( Host& host, HostConnection& hc )
+  {
+    const Request& request = hc.in_flight.front();
+    const chrono::duration<double, milli> latency = Clock::now() - request.sent;
+    report( request, { hc.parser.status(), hc.parser.body_bytes(), latency.count() } );
+    hc.in_flight.pop_front();
+    const bool keep_alive = hc.parser.keep_alive();
+    hc.parser.reset();
+
+    if ( not keep_alive ) {
+      // the server won't answer the requests behind this one
+      retire( hc );
+      requeue( host, hc.in_flight );
+    }
+  }
+
+  // Write pending requests to the connection, up to the pipeline depth
+  void write_requests( Host& host, HostConnection& hc )
+  {
+    while ( not hc.retired and hc.in_flight.size() < cfg_.depth and not host.pending.empty() ) {
+      const Request& next = host.pending.front();
+      const TCPOverIPv4Stack::Connection& view = *hc.conn;
+      if ( view.outbound_writer().available_capacity() < next.text.size() ) {
+        break;
+      }
+      hc.conn->outbound_writer().push( next.text );
+      hc.in_flight.push_back( move( host.pending.front() ) );
+      hc.in_flight.back().sent = Clock::now();
+      host.pending.pop_front();
+    }
+  }
+
+  void service( Host& host )
+  {
+    for ( auto& hc : host.connections ) {
+      read_responses( host, hc );
+
+      const TCPOverIPv4Stack::Connection& view = *hc.conn;
+      if ( view.failed() or view.inbound_reader().is_finished() or not view.active() ) {
+        // the connection is over: whatever was in flight has to go again
+        if ( not view.failed() and hc.parser.started() and not hc.in_flight.empty() ) {
+          hc.parser.finish();
+          if ( hc.parser.done() ) {
+            finish_response( host, hc );
+          }
+        }
+        retire( hc );
+        requeue( host, hc.in_flight );
+      }
+
+      write_requests( host, hc );
+    }
+
+    // forget the connections that have finished, and open more while there are requests left to send
+    erase_if( host.connections, []( const HostConnection& hc ) { return hc.retired and not hc.conn->active(); } );
+    size_t open = ranges::count_if( host.connections, []( const HostConnection& hc ) { return not hc.retired; } );
+    for ( ; open < cfg_.connections and not host.pending.empty(); ++open ) {
+      host.connections.push_back( { stack_.connect( Address { cfg_.source_address, 0 }, host.address ) } );
+      write_requests( host, host.connections.back() );
+    }
+  }
+
+  void print_summary( const Clock::duration elapsed ) const
+  {
+    vector<double> latencies;
+    uint64_t bytes = 0;
+    for ( const auto& result : results_ ) {
+      if ( result.status != 0 ) {
+        latencies.push_back( result.latency_ms );
+        bytes += result.body_bytes;
+      }
+    }
+    ranges::sort( latencies );
+
+    const double seconds = chrono::duration<double> { elapsed }.count();
+    cout << "\n"
+         << latencies.size() << " of " << results_.size() << " requests answered, " << bytes << " body bytes in "
+         << fixed << setprecision( 3 ) << seconds << " s (" << setprecision( 1 )
+         << static_cast<double>( latencies.size() ) / seconds << " requests/s)\n";
+    if ( latencies.empty() ) {
+      return;
+    }
+
+    // nearest-rank percentiles
+    const auto percentile = [&]( double p ) {
+      const auto rank = static_cast<size_t>( p / 100 * static_cast<double>( latencies.size() ) + 0.999999 );
+      return latencies.at( clamp<size_t>( rank, 1, latencies.size() ) - 1 );
+    };
+    cout << "latency (ms): min " << setprecision( 3 ) << latencies.front() << "  p50 " << percentile( 50 )
+         << "  p90 " << percentile( 90 ) << "  p99 " << percentile( 99 ) << "  max " << latencies.back() << "\n";
+  }
+
+public:
+  explicit Fetcher( const FetchConfig& cfg )
+    : cfg_( cfg ), stack_( TCPOverIPv4OverTunFdAdapter { TunFD { cfg.tundev } }, [&] {
+      TCPConfig tcp_config;
+      tcp_config.rt_timeout = cfg.rt_timeout;
+      return tcp_config;
+    }() )
+  {
+    for ( size_t round = 0; round < cfg.repeat; ++round ) {
+      for ( const auto& text : cfg.urls ) {
+        const URL url = parse_url( text );
+        auto [it, added] = hosts_.try_emplace( { url.host, url.port }, Host { Address { url.host, url.port } } );
+        const string host_header = url.port == "http" ? url.host : url.host + ":" + url.port;
+        it->second.pending.push_back(
+          { results_.size(), &text, "GET " + url.path + " HTTP/1.1\r\nHost: " + host_header + "\r\n\r\n" } );
+        results_.emplace_back();
+      }
+    }
+    outstanding_ = results_.size();
+    stack_.install( loop_ );
+  }
+
+  void run()
+  {
+    const auto start = Clock::now();
+    while ( outstanding_ > 0 ) {
+      for ( auto& [name, host] : hosts_ ) {
+        service( host );
+      }
+      loop_.wait_next_event( -1 );
+    }
+    print_summary( Clock::now() - start );
+
+    // close the connections that are still open, and wait for them to finish
+    for ( auto& [name, host] : hosts_ ) {
+      for ( auto& hc : host.connections ) {
+        retire( hc );
+      }
+    }
+    while ( stack_.connection_count() > 0 ) {
+      for ( auto& [name, host] : hosts_ ) {
+        service( host );
+      }
+      loop_.wait_next_event( -1 );
+    }
+  }
+};
+
+} // namespace
+
 int main( int argc, char* argv[] )
 {
   try {
@@ -41,18 +612,27 @@ int main( int argc, char* argv[] )
     // The program takes two command-line arguments: the hostname and "path" part of the URL.
     // Print the usage message unless there are these two arguments (plus the program name
     // itself, so arg count = 3 in total).
-    if ( argc != 3 ) {
+    if ( argc < 2 ) {
       cerr << "Usage: " << args.front() << " HOST PATH\n";
       cerr << "\tExample: " << args.front() << " stanford.edu /class/cs144\n";
+      cerr << "   or: " << args.front() << " [options] URL... (see -h)\n";
       return EXIT_FAILURE;
     }
 
-    // Get the command-line arguments.
-    const string host { args[1] };
-    const string path { args[2] };
+    // With a HOST and a PATH, fetch one page as before
+    if ( argc == 3 and args[1][0] != '-' and string_view { args[2] }.starts_with( '/' ) ) {
+      // Get the command-line arguments.
+      const string host { args[1] };
+      const string path { args[2] };
+
+      // Call the student-written function.
+      get_URL( host, path );
+      return EXIT_SUCCESS;
+    }
 
-    // Call the student-written function.
-    get_URL( host, path );
+    const FetchConfig cfg = get_config( args );
+    Fetcher fetcher { cfg };
+    fetcher.run();
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return EXIT_FAILURE;
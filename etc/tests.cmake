@@ -1,6 +1,6 @@
 include(CTest)
 
-list(APPEND CMAKE_CTEST_ARGUMENTS --output-on-failure --stop-on-failure --timeout 15 -E 'speed_test|optimization|webget')
+list(APPEND CMAKE_CTEST_ARGUMENTS --output-on-failure --stop-on-failure --timeout 15 -E 'speed_test|optimization|webget|tcp_sim')
 
 set(compile_name "compile with bug-checkers")
 add_test(NAME ${compile_name}
@@ -23,6 +23,7 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_alloc)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +32,7 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_alloc)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -53,10 +55,26 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_alloc)
 
 ttest(net_interface)
+ttest(net_interface_alloc)
 
 ttest(router)
+ttest(router_alloc)
+
+ttest(eventloop_group)
+ttest(eventloop_task)
+ttest(netem_adapter)
+ttest(packet_ring)
+ttest(udp_batch)
+ttest(tcp_stack)
+ttest(syn_cookie)
+ttest(tcp_ring_socket)
+ttest(tcp_inline_socket)
+ttest(header_parse)
+ttest(tun_offload)
+ttest(tun_multi_queue)
 
 ttest(no_skip)
 
@@ -78,7 +96,7 @@ add_custom_target (check6 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --s
 
 ###
 
-add_custom_target (speed COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 15 -R '_speed_test')
+add_custom_target (speed COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 15 -R '_speed_test|tcp_sim')
 
 set(compile_name_opt "compile with optimization")
 add_test(NAME ${compile_name_opt}
@@ -94,3 +112,11 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(tcp_loopback_speed_test)
+stest(udp_batch_speed_test)
+stest(tcp_socket_speed_test)
+stest(tcp_footprint_test)
+stest(tcp_alloc_test)
+
+add_test(NAME tcp_sim_repeatable COMMAND "${PROJECT_SOURCE_DIR}/tests/tcp_sim_t.sh" "${PROJECT_BINARY_DIR}")
+set_property(TEST tcp_sim_repeatable PROPERTY FIXTURES_REQUIRED compile_opt)
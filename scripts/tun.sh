@@ -3,13 +3,14 @@
 TUN_IP_PREFIX=169.254
 
 show_usage () {
-    echo "Usage: $0 <start | stop | restart | check> [tunnum ...]"
+    echo "Usage: $0 <start | stop | restart | check> [-m] [tunnum ...]"
+    echo "   -m   create multi-queue devices (one queue per TunFD::open_queues worker)"
     exit 1
 }
 
 start_tun () {
     local TUNNUM="$1" TUNDEV="tun$1"
-    ip tuntap add mode tun user "${SUDO_USER}" name "${TUNDEV}"
+    ip tuntap add mode tun ${MULTI_QUEUE} user "${SUDO_USER}" name "${TUNDEV}"
     ip addr add "${TUN_IP_PREFIX}.${TUNNUM}.1/24" dev "${TUNDEV}"
     ip link set dev "${TUNDEV}" up
     ip route change "${TUN_IP_PREFIX}.${TUNNUM}.0/24" dev "${TUNDEV}" rto_min 10ms
@@ -24,7 +25,7 @@ stop_tun () {
     local TUNDEV="tun$1"
     iptables -t nat -D PREROUTING -s ${TUN_IP_PREFIX}.${1}.0/24 -j CONNMARK --set-mark ${1}
     iptables -t nat -D POSTROUTING -j MASQUERADE -m connmark --mark ${1}
-    ip tuntap del mode tun name "$TUNDEV"
+    ip tuntap del mode tun ${MULTI_QUEUE} name "$TUNDEV"
 }
 
 start_all () {
@@ -61,7 +62,7 @@ check_sudo () {
     fi
     if [ -z "$SUDO_USER" ]; then
         # if the user didn't call us with sudo, re-execute
-        exec sudo $0 "$MODE" "$@"
+        exec sudo $0 "$MODE" ${MULTI_QUEUE:+-m} "$@"
     fi
 }
 
@@ -71,6 +72,12 @@ if [ -z "$1" ] || ([ "$1" != "start" ] && [ "$1" != "stop" ] && [ "$1" != "resta
 fi
 MODE=$1; shift
 
+MULTI_QUEUE=
+if [ "$1" = "-m" ]; then
+    MULTI_QUEUE=multi_queue
+    shift
+fi
+
 # set default argument
 if [ "$#" = "0" ]; then
     set -- 144 145
@@ -1,4 +1,7 @@
 #include "byte_stream.hh"
+#include "buffer_pool.hh"
+
+#include <utility>
 
 using namespace std;
 
@@ -8,7 +11,15 @@ void Writer::push( string data )
 {
   // Push data to the buffer, but only as much as available capacity allows.
   uint64_t to_write = min( available_capacity(), data.size() );
-  buffer_.append( data, 0, to_write );
+  if ( buffer_.empty() and to_write == data.size() ) {
+    // (an empty stream can take the caller's string instead of copying it)
+    BufferPool::release( exchange( buffer_, move( data ) ) );
+  } else {
+    // (growing and giving back the caller's string through the BufferPool, so a steady stream doesn't allocate)
+    BufferPool::reserve( buffer_, buffer_.size() + to_write );
+    buffer_.append( data, 0, to_write );
+    BufferPool::release( move( data ) );
+  }
   bytes_pushed_ += to_write;
 }
 
@@ -43,11 +54,14 @@ void Reader::pop( uint64_t len )
   // Pop as much data as possible from the buffer if len is greater than the amount of data available.
   uint64_t to_read = min( bytes_buffered(), len );
   read_index_ += to_read;
-  bytes_popped_ += to_read;
 
-  // When more than half of the buffer is read, shrink it to avoid unnecessary memory usage.
-  if ( read_index_ >= buffer_.size() / 2 ) {
-    buffer_ = buffer_.substr( read_index_ );
+  if ( read_index_ == buffer_.size() ) {
+    // Drained: give the memory back (to the BufferPool), so an idle stream holds none.
+    BufferPool::release( exchange( buffer_, string {} ) );
+    read_index_ = 0;
+  } else if ( read_index_ >= buffer_.size() / 2 ) {
+    // When more than half of the buffer is read, move the rest to the front (in place) to bound its size.
+    buffer_.erase( 0, read_index_ );
     read_index_ = 0;
   }
 }
@@ -64,5 +78,5 @@ uint64_t Reader::bytes_buffered() const
 
 uint64_t Reader::bytes_popped() const
 {
-  return bytes_popped_;
+  return bytes_pushed_ - bytes_buffered();
 }
\ No newline at end of file
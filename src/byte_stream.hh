@@ -23,10 +23,11 @@ public:
 
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
+  // (Bytes popped is bytes_pushed_ less what is buffered. The buffer holds no memory while the stream is drained,
+  // so an idle stream costs only these members.)
   uint64_t capacity_;
   uint64_t bytes_pushed_ {};
-  uint64_t bytes_popped_ {};
-  std::string buffer_ {};
+  std::string buffer_ {}; // buffered bytes start at read_index_
   uint64_t read_index_ {};
   bool error_ {};
   bool is_closed_ {};
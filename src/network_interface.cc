@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "arp_message.hh"
+#include "buffer_pool.hh"
 #include "debug.hh"
 #include "ethernet_frame.hh"
 #include "exception.hh"
@@ -47,8 +48,9 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
     dgram.serialize( serializer );
     eframe.payload = serializer.finish();
 
-    // Send the Ethernet frame
+    // Send the Ethernet frame, then give its buffers back to the BufferPool for the next one
     transmit( eframe );
+    BufferPool::release( move( eframe.payload ) );
     return;
   }
 
@@ -89,7 +91,7 @@ void NetworkInterface::recv_frame( EthernetFrame frame )
     dgram.parse( parser );
     if ( parser.has_error() )
       return;
-    datagrams_received_.push( dgram );
+    datagrams_received_.push( move( dgram ) );
   }
 
   // If the inbound frame is ARP, parse the payload as an ARPMessage
@@ -1,4 +1,5 @@
 #include "reassembler.hh"
+#include "buffer_pool.hh"
 #include "debug.hh"
 
 using namespace std;
@@ -17,17 +18,29 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
     last_index_ = first_index + data.size() - 1;
   }
 
+  // In-order data, with nothing pending, goes straight to the stream
+  if ( !data.empty() && first_index == next_pushed_index() && pending_substrings_.empty()
+       && data.size() <= available_capacity() ) {
+    const bool last = first_index + data.size() - 1 == last_index_;
+    output_writer().push( move( data ) );
+    if ( last ) {
+      output_writer().close();
+    }
+    return;
+  }
+
   // At least one byte of data is available to insert
   // next_pushed_index()返回滑动窗口的起始位置
   if ( first_index < next_pushed_index() + available_capacity()
        && first_index + data.length() > next_pushed_index() ) {
     // Calculate the inserted key
     uint64_t insert_key = ( first_index >= next_pushed_index() ) ? first_index : next_pushed_index();
-    // Insert only the bytes within the available capacity
-    pending_substrings_.insert( make_pair(
-      insert_key,
-      data.substr( insert_key - first_index,
-                   min( data.length(), ( next_pushed_index() + available_capacity() ) - insert_key ) ) ) );
+    // Insert only the bytes within the available capacity (in a buffer from the BufferPool)
+    const uint64_t length = min( data.length() - ( insert_key - first_index ),
+                                 ( next_pushed_index() + available_capacity() ) - insert_key );
+    string substring = BufferPool::acquire( length );
+    substring.append( data, insert_key - first_index, length );
+    pending_substrings_.emplace( insert_key, move( substring ) );
     // 怎么计算插入的字节数
 
     // Merge overlapping/adjacent substrings in the Reassembler's internal storage
@@ -36,9 +49,11 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
     // If next bytes are available, push these to the ByteStream
     // 如果下一个字节可用，则将其推送到 ByteStream
     if ( pending_substrings_.begin()->first == next_pushed_index() ) {
-      output_writer().push( pending_substrings_.begin()->second );
-      // Check if we have pushed the last byte of the stream
-      if ( pending_substrings_.begin()->first + pending_substrings_.begin()->second.length() - 1 == last_index_ ) {
+      // Check if we are pushing the last byte of the stream
+      const bool last
+        = pending_substrings_.begin()->first + pending_substrings_.begin()->second.length() - 1 == last_index_;
+      output_writer().push( move( pending_substrings_.begin()->second ) );
+      if ( last ) {
         output_writer().close();
       }
       pending_substrings_.erase( pending_substrings_.begin() );
@@ -46,6 +61,7 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   }
 
   // debug( "discarding substring at index {} with size {}", first_index, data.size() );
+  BufferPool::release( move( data ) );
 }
 
 // How many bytes are stored in the Reassembler itself?
@@ -73,12 +89,15 @@ void Reassembler::merge()
     if ( it->first + it->second.size() >= next_it->first ) {
       // Overlapping or adjacent substrings, merge them
       if ( it->first + it->second.size() >= next_it->first + next_it->second.size() ) {
+        BufferPool::release( move( next_it->second ) );
         next_it = pending_substrings_.erase( next_it );
         // The first substring fully contains the second one
         continue;
       }
       auto overlap_pos = it->first + it->second.size() - next_it->first;
-      it->second += next_it->second.substr( overlap_pos );
+      BufferPool::reserve( it->second, it->second.size() + next_it->second.size() - overlap_pos );
+      it->second.append( next_it->second, overlap_pos );
+      BufferPool::release( move( next_it->second ) );
       next_it = pending_substrings_.erase( next_it );
     } else {
       // No overlap, move to the next pair
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "byte_stream.hh"
 #include <map>
 #include <unordered_map>
@@ -11,7 +12,7 @@ class Reassembler
 public:
   // Construct Reassembler to write into given ByteStream.
   explicit Reassembler( ByteStream&& output )
-    : output_( std::move( output ) ), capacity_( writer().available_capacity() )
+    : output_( std::move( output ) )
   {}
 
   /*
@@ -49,9 +50,10 @@ public:
 
 private:
   ByteStream output_;
-  uint64_t capacity_;                                          // Capacity of the output stream
   uint64_t last_index_ = UINT64_MAX;                           // Last index written to the output stream
-  std::multimap<uint64_t, std::string> pending_substrings_ {}; // Maps first index to data
+  // Maps first index to data (from the BufferPool, where the nodes and merged-away buffers go back)
+  std::multimap<uint64_t, std::string, std::less<>, PoolAllocator<std::pair<const uint64_t, std::string>>>
+    pending_substrings_ {};
   bool SYN = false;                                            // Whether the first segment was received
   bool FIN = false;                                            // Whether the last segment was received
 
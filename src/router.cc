@@ -42,7 +42,7 @@ void Router::route()
   while ( i < interfaces_.size() ) {
     queue<InternetDatagram>& datagrams_queue = interface( i )->datagrams_received();
     while ( !datagrams_queue.empty() ) {
-      InternetDatagram dgram = datagrams_queue.front();
+      InternetDatagram dgram = move( datagrams_queue.front() );
       datagrams_queue.pop();
       if ( dgram.header.ttl <= 1 ) {
         // If the TTL field is already 0, or hits 0 after the decrement, drop the datagram.
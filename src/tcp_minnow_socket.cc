@@ -1,5 +1,29 @@
 #include "tcp_minnow_socket_impl.hh"
 
-//! Specializations of TCPMinnowSocket for TCPOverIPv4OverTunFdAdapter and its lossy version
+//! Specializations of TCPPeerThread and TCPMinnowSocket for TCPOverIPv4OverTunFdAdapter, TCPOverUDPAdapter (and
+//! their lossy and emulated-path versions), and LoopbackAdapter
+template class TCPPeerThread<TCPOverIPv4OverTunFdAdapter>;
+template class TCPPeerThread<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
+template class TCPPeerThread<TCPOverUDPAdapter>;
+template class TCPPeerThread<LossyFdAdapter<TCPOverUDPAdapter>>;
+template class TCPPeerThread<NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>>;
+template class TCPPeerThread<NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>>;
+template class TCPPeerThread<LoopbackAdapter>;
+
 template class TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
 template class TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
+template class TCPMinnowSocket<TCPOverUDPAdapter>;
+template class TCPMinnowSocket<LossyFdAdapter<TCPOverUDPAdapter>>;
+template class TCPMinnowSocket<NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>>;
+template class TCPMinnowSocket<NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>>;
+template class TCPMinnowSocket<LoopbackAdapter>;
+
+//! Specializations of TCPMinnowRingSocket
+template class TCPMinnowRingSocket<TCPOverIPv4OverTunFdAdapter>;
+template class TCPMinnowRingSocket<TCPOverUDPAdapter>;
+template class TCPMinnowRingSocket<LoopbackAdapter>;
+
+//! Specializations of TCPMinnowInlineSocket
+template class TCPMinnowInlineSocket<TCPOverIPv4OverTunFdAdapter>;
+template class TCPMinnowInlineSocket<TCPOverUDPAdapter>;
+template class TCPMinnowInlineSocket<LoopbackAdapter>;
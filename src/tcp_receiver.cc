@@ -27,7 +27,7 @@ void TCPReceiver::receive( TCPSenderMessage message )
   }
 
   uint64_t first_index = message.seqno.unwrap( zero_point_, reassembler_.next_pushed_index() ) + message.SYN;
-  reassembler_.insert( first_index, message.payload, message.FIN );
+  reassembler_.insert( first_index, move( message.payload ), message.FIN );
 
   if ( FIN && reassembler_.writer().is_closed() ) {
     reassembler_.FIN = true;
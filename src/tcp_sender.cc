@@ -30,7 +30,8 @@ void TCPSender::push( const TransmitFunction& transmit )
   // (void)transmit;
 
   // if fin is set or zero window size is received, we should not push any more data
-  while ( ( !FIN && sender_window_size_ > 0 ) || zero_windowsize_received_ ) {
+  // (a zero window gets a single probe, and only once nothing else is in flight; the timer retransmits it)
+  while ( ( !FIN && sender_window_size_ > 0 ) || ( zero_windowsize_received_ && outstanding_segments_.empty() ) ) {
     if ( FIN )
       return;
 
@@ -54,14 +55,17 @@ void TCPSender::push( const TransmitFunction& transmit )
                           sender_window_size_ - msg.SYN );
     }
 
-    msg.payload = reader().peek().substr( 0, payload_size );
+    if ( payload_size > 0 ) {
+      msg.payload = BufferPool::acquire( payload_size );
+      msg.payload.append( reader().peek().substr( 0, payload_size ) );
+    }
     msg.seqno = Wrap32::wrap( next_seqno_, isn_ );
 
     // if the writer is closed, we should set the FIN flag if this segment contains the last byte of the outbound
     // stream
     if ( writer().is_closed() ) {
-      last_sent_seqno_ = SYN + reader().bytes_popped() + reader().bytes_buffered() - 1;
-      if ( next_seqno_ + msg.sequence_length() - 1 >= last_sent_seqno_ ) {
+      const uint64_t last_seqno = SYN + reader().bytes_popped() + reader().bytes_buffered() - 1;
+      if ( next_seqno_ + msg.sequence_length() - 1 >= last_seqno ) {
         // This is the segment containing the last byte of the outbound stream
 
         // Don't add the FIN flag if it would make the segment exceed the sender's window
@@ -89,13 +93,14 @@ void TCPSender::push( const TransmitFunction& transmit )
     //        msg.sequence_length() );
 
     // Add the segment to the outstanding segments map and update the next sequence number.
-    outstanding_segments_[next_seqno_] = msg;
+    const auto& segment = outstanding_segments_.insert_or_assign( next_seqno_, move( msg ) ).first->second;
     reader().pop( payload_size );
     next_seqno_ = reader().bytes_popped() + SYN + FIN;
-    sender_window_size_ = rwindow_ - next_seqno_ + 1;
+    // a zero-window probe can leave next_seqno_ past the right edge; the window is then 0, not negative
+    sender_window_size_ = rwindow_ + 1 > next_seqno_ ? rwindow_ + 1 - next_seqno_ : 0;
 
-    transmit( msg );
-    if ( msg.sequence_length() > 0 && !timer_.is_running() ) {
+    transmit( segment );
+    if ( segment.sequence_length() > 0 && !timer_.is_running() ) {
       timer_.start();
     }
 
@@ -139,7 +144,7 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     }
 
     rwindow_ = last_ackno_ + receiver_window_size_ - 1;
-    sender_window_size_ = rwindow_ - next_seqno_ + 1;
+    sender_window_size_ = rwindow_ + 1 > next_seqno_ ? rwindow_ + 1 - next_seqno_ : 0;
     return;
   }
 
@@ -150,13 +155,14 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     zero_windowsize_received_ = true;
   }
   rwindow_ = last_ackno_ + msg.window_size - 1;
-  sender_window_size_ = rwindow_ - next_seqno_ + 1;
+  sender_window_size_ = rwindow_ + 1 > next_seqno_ ? rwindow_ + 1 - next_seqno_ : 0;
 
   // Remove any segments that have been acknowledged from the outstanding segments map.
   auto it = outstanding_segments_.begin();
   while ( it != outstanding_segments_.end() ) {
     if ( it->first + it->second.sequence_length() <= last_ackno_ ) {
       // This segment has been acknowledged.
+      BufferPool::release( move( it->second.payload ) );
       it = outstanding_segments_.erase( it );
     } else {
       ++it;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "byte_stream.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
@@ -53,7 +54,7 @@ class TCPSender
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
   TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms )
+    : input_( std::move( input ) ), timer_( initial_RTO_ms ), isn_( isn )
   {}
 
   /* Generate an empty TCPSenderMessage */
@@ -81,21 +82,21 @@ public:
 private:
   Reader& reader() { return input_.reader(); }
 
+  // (Ordered largest first, so the small fields pack together.)
   ByteStream input_;
+  RetransmissionTimer timer_;
+  uint64_t next_seqno_ {};                  // The next sequence number to be sent
+  uint64_t last_ackno_ {};                  // The last ACK number received, also the left edge of the window
+  uint64_t rwindow_ {};                     // The right edge of the sender's window
+  uint64_t sender_window_size_ = 1;         // The sender's window size
   Wrap32 isn_;
-  uint64_t initial_RTO_ms_;
-
-  RetransmissionTimer timer_ { initial_RTO_ms_ };
-  uint64_t next_seqno_ {};            // The next sequence number to be sent
-  uint64_t last_sent_seqno_ {};       // The last sequence number sent
-  uint64_t last_ackno_ {};            // The last ACK number received, also the left edge of the sender's window
-  uint64_t rwindow_ {};               // The right edge of the sender's window
-  uint64_t sender_window_size_ = 1;   // The sender's window size
-  uint64_t receiver_window_size_ = 1; // The receiver's window size
-  uint64_t consecutive_retransmissions_ {}; // How many consecutive retransmissions have happened
-  bool SYN {};                       // Whether the TCPSender has sent SYN flag
-  bool FIN {};                       // Whether the TCPSender has sent FIN flag
+  uint32_t consecutive_retransmissions_ {}; // How many consecutive retransmissions have happened
+  uint16_t receiver_window_size_ = 1;       // The receiver's window size
+  bool SYN {};                              // Whether the TCPSender has sent SYN flag
+  bool FIN {};                              // Whether the TCPSender has sent FIN flag
   bool zero_windowsize_received_ {}; // Whether the TCPSender has received a zero window size from the receiver
 
-  std::map<uint64_t, TCPSenderMessage> outstanding_segments_ {}; // Maps sequence number to the segment
+  // Maps sequence number to the segment (the nodes, and the payloads once acknowledged, go back to the BufferPool)
+  std::map<uint64_t, TCPSenderMessage, std::less<>, PoolAllocator<std::pair<const uint64_t, TCPSenderMessage>>>
+    outstanding_segments_ {};
 };
@@ -0,0 +1,77 @@
+#include "tcp_stack_impl.hh"
+
+#include <bit>
+#include <initializer_list>
+
+using namespace std;
+
+namespace {
+
+// SipHash-2-4 (Aumasson and Bernstein) of a message made of whole 64-bit words
+uint64_t siphash( const array<uint64_t, 2>& key, const initializer_list<uint64_t> words )
+{
+  uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+  uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+  uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+  uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+
+  const auto round = [&] {
+    v0 += v1;
+    v1 = rotl( v1, 13 ) ^ v0;
+    v0 = rotl( v0, 32 );
+    v2 += v3;
+    v3 = rotl( v3, 16 ) ^ v2;
+    v0 += v3;
+    v3 = rotl( v3, 21 ) ^ v0;
+    v2 += v1;
+    v1 = rotl( v1, 17 ) ^ v2;
+    v2 = rotl( v2, 32 );
+  };
+  const auto compress = [&]( const uint64_t m ) {
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  };
+
+  for ( const uint64_t m : words ) {
+    compress( m );
+  }
+  compress( static_cast<uint64_t>( words.size() * sizeof( uint64_t ) ) << 56 );
+
+  v2 ^= 0xff;
+  for ( int i = 0; i < 4; ++i ) {
+    round();
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// The 32-bit value of a sequence number
+uint32_t raw( const Wrap32 seqno )
+{
+  return static_cast<uint32_t>( seqno.unwrap( Wrap32 { 0 }, 0 ) );
+}
+
+} // namespace
+
+Wrap32 SynCookie::make( const FourTuple& tuple, const Wrap32 client_isn, const uint64_t period ) const
+{
+  const uint64_t hash = siphash( key_,
+                                 { static_cast<uint64_t>( tuple.src_ip ) << 32 | tuple.dst_ip,
+                                   static_cast<uint64_t>( tuple.src_port ) << 48
+                                     | static_cast<uint64_t>( tuple.dst_port ) << 32 | raw( client_isn ),
+                                   period } );
+  return Wrap32 { static_cast<uint32_t>( ( period % 32 ) << 27 | ( hash & ( ( 1U << 27 ) - 1 ) ) ) };
+}
+
+bool SynCookie::check( const FourTuple& tuple,
+                       const Wrap32 client_isn,
+                       const Wrap32 cookie,
+                       const uint64_t period ) const
+{
+  return cookie == make( tuple, client_isn, period ) or cookie == make( tuple, client_isn, period - 1 );
+}
+
+//! Specializations of TCPStack for TCPOverIPv4OverTunFdAdapter and LoopbackAdapter
+template class TCPStack<TCPOverIPv4OverTunFdAdapter>;
+template class TCPStack<LoopbackAdapter>;
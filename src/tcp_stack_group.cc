@@ -0,0 +1,45 @@
+#include "tcp_stack_group.hh"
+#include "tun.hh"
+
+#include <utility>
+
+using namespace std;
+
+namespace {
+vector<unique_ptr<TCPOverIPv4Stack>> open_stacks( const string& devname,
+                                                  const size_t count,
+                                                  const bool vnet_hdr,
+                                                  const TCPConfig& config )
+{
+  vector<unique_ptr<TCPOverIPv4Stack>> stacks;
+  for ( auto& queue : TunFD::open_queues( devname, count, vnet_hdr ) ) {
+    stacks.push_back( make_unique<TCPOverIPv4Stack>( TCPOverIPv4OverTunFdAdapter { move( queue ) }, config ) );
+  }
+  return stacks;
+}
+} // namespace
+
+TCPStackGroup::TCPStackGroup( const string& devname,
+                              const size_t count,
+                              const bool vnet_hdr,
+                              const TCPConfig& config,
+                              const bool pin_to_cores )
+  : _stacks( open_stacks( devname, count, vnet_hdr, config ) ), _loops( count, pin_to_cores )
+{
+  // each loop runs its jobs in order, so this comes before any job posted later
+  post_all( []( TCPOverIPv4Stack& stack, EventLoop& loop ) { stack.install( loop ); } );
+}
+
+void TCPStackGroup::post( const size_t index, Job job )
+{
+  _loops.post( index, [stack = _stacks.at( index ).get(), job = move( job )]( EventLoop& loop ) {
+    job( *stack, loop );
+  } );
+}
+
+void TCPStackGroup::post_all( const Job& job )
+{
+  for ( size_t i = 0; i < size(); ++i ) {
+    post( i, job );
+  }
+}
@@ -0,0 +1,166 @@
+#include "alloc_counter.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+// Totals for this thread (constant-initialized and never destroyed, so operator new can count at any point in
+// the thread's life)
+thread_local AllocationCount totals {};
+
+void* counted_alloc( size_t size )
+{
+  ++totals.allocations;
+  totals.bytes += size;
+  return malloc( size == 0 ? 1 : size );
+}
+
+void* counted_aligned_alloc( size_t size, align_val_t alignment )
+{
+  ++totals.allocations;
+  totals.bytes += size;
+  const auto align = static_cast<size_t>( alignment );
+  return aligned_alloc( align, ( max<size_t>( size, 1 ) + align - 1 ) / align * align );
+}
+
+void* checked( void* p )
+{
+  if ( not p ) {
+    throw bad_alloc {};
+  }
+  return p;
+}
+
+void counted_free( void* p ) noexcept
+{
+  if ( p ) {
+    ++totals.deallocations;
+    free( p );
+  }
+}
+
+} // namespace
+
+string to_string( const AllocationCount& count )
+{
+  return std::to_string( count.allocations ) + " allocations (" + std::to_string( count.bytes ) + " bytes) and "
+         + std::to_string( count.deallocations ) + " deallocations";
+}
+
+AllocationCounter::AllocationCounter() : start_( totals ) {}
+
+AllocationCount AllocationCounter::count() const
+{
+  return totals - start_;
+}
+
+void AllocationCounter::reset()
+{
+  start_ = totals;
+}
+
+// The replacements for the global allocation functions
+
+void* operator new( size_t size )
+{
+  return checked( counted_alloc( size ) );
+}
+
+void* operator new[]( size_t size )
+{
+  return checked( counted_alloc( size ) );
+}
+
+void* operator new( size_t size, const nothrow_t& /*unused*/ ) noexcept
+{
+  return counted_alloc( size );
+}
+
+void* operator new[]( size_t size, const nothrow_t& /*unused*/ ) noexcept
+{
+  return counted_alloc( size );
+}
+
+void* operator new( size_t size, align_val_t alignment )
+{
+  return checked( counted_aligned_alloc( size, alignment ) );
+}
+
+void* operator new[]( size_t size, align_val_t alignment )
+{
+  return checked( counted_aligned_alloc( size, alignment ) );
+}
+
+void* operator new( size_t size, align_val_t alignment, const nothrow_t& /*unused*/ ) noexcept
+{
+  return counted_aligned_alloc( size, alignment );
+}
+
+void* operator new[]( size_t size, align_val_t alignment, const nothrow_t& /*unused*/ ) noexcept
+{
+  return counted_aligned_alloc( size, alignment );
+}
+
+void operator delete( void* p ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete( void* p, size_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p, size_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete( void* p, const nothrow_t& /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p, const nothrow_t& /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete( void* p, align_val_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p, align_val_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete( void* p, size_t /*unused*/, align_val_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p, size_t /*unused*/, align_val_t /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete( void* p, align_val_t /*unused*/, const nothrow_t& /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
+
+void operator delete[]( void* p, align_val_t /*unused*/, const nothrow_t& /*unused*/ ) noexcept
+{
+  counted_free( p );
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//! Heap activity through the global operator new and delete
+struct AllocationCount
+{
+  uint64_t allocations {};   //!< Calls to operator new (of every form)
+  uint64_t deallocations {}; //!< Calls to operator delete with a non-null pointer
+  uint64_t bytes {};         //!< Bytes asked for by those calls to operator new
+
+  AllocationCount operator-( const AllocationCount& other ) const
+  {
+    return { allocations - other.allocations, deallocations - other.deallocations, bytes - other.bytes };
+  }
+};
+
+std::string to_string( const AllocationCount& count );
+
+//! \brief Counts the heap allocations this thread makes while the counter is in scope
+//! \details Linking the alloc_counter library replaces the global operator new and delete (in all their forms)
+//! with ones that count each call in thread-local totals before going to malloc and free, so only programs that
+//! ask for it pay for the counting. A counter remembers the totals when it is created, and count() is the
+//! difference since; counters can nest, and each sees everything made in its own scope.
+class AllocationCounter
+{
+  AllocationCount start_;
+
+public:
+  AllocationCounter();
+
+  //! Heap activity on this thread since the counter was created (or last reset)
+  AllocationCount count() const;
+
+  //! Start counting again from zero
+  void reset();
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "alloc_counter.hh"
+#include "common.hh"
+
+#include <utility>
+
+//! The type of object a TestStep acts on (declared only, for use in decltype)
+template<class T>
+T step_object( const TestStep<T>& step );
+
+template<class Step>
+using StepObject = decltype( step_object( std::declval<Step>() ) );
+
+//! Run a step (e.g. an Action) and expect it to make no more than `budget` heap allocations. The count covers
+//! everything the step does, so a step that copies its arguments (e.g. a string to push) spends budget on that.
+template<class Step>
+struct AllocationBudget : public TestStep<StepObject<Step>>
+{
+  Step step_;
+  uint64_t budget_;
+
+  AllocationBudget( Step step, uint64_t budget ) : step_( std::move( step ) ), budget_( budget ) {}
+
+  std::string str() const override
+  {
+    return step_.str() + " [with at most " + std::to_string( budget_ ) + " heap allocations]";
+  }
+  uint8_t color() const override { return step_.color(); }
+  constexpr std::string obj() const override { return step_.obj(); }
+
+  void execute( StepObject<Step>& obj ) const override
+  {
+    const AllocationCounter counter;
+    step_.execute( obj );
+    const AllocationCount count = counter.count();
+    if ( count.allocations > budget_ ) {
+      throw ExpectationViolation { "should have made at most " + std::to_string( budget_ )
+                                   + " heap allocations, but instead made " + to_string( count ) };
+    }
+  }
+};
@@ -0,0 +1,85 @@
+#include "alloc_test_harness.hh"
+#include "buffer_pool.hh"
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+// Push a copy of the data made in a buffer from the BufferPool, as the rest of the stack hands data to a stream
+struct PushPooled : public Push
+{
+  using Push::Push;
+
+  void execute( ByteStream& bs ) const override
+  {
+    string data = BufferPool::acquire( data_.size() );
+    data.append( data_ );
+    bs.writer().push( move( data ) );
+  }
+};
+
+// Once a few rounds have warmed up the BufferPool, pushing and popping should make no heap allocations: the
+// stream keeps each buffer it is given, or appends it to the one it has and gives it back.
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "push then pop, repeatedly", 4000 };
+      const string data( 1000, 'x' );
+
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( PushPooled { data } );
+        test.execute( Pop { 1000 } );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( AllocationBudget { PushPooled { data }, 0 } );
+        test.execute( AllocationBudget { Pop { 1000 }, 0 } );
+      }
+      test.execute( BytesPopped { 104000 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "fill, then drain in pieces, repeatedly", 4000 };
+      const string data( 1000, 'x' );
+
+      for ( size_t i = 0; i < 4; ++i ) {
+        for ( size_t j = 0; j < 4; ++j ) {
+          test.execute( PushPooled { data } );
+        }
+        test.execute( Pop { 4000 } );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        for ( size_t j = 0; j < 4; ++j ) {
+          test.execute( AllocationBudget { PushPooled { data }, 0 } );
+        }
+        test.execute( AvailableCapacity { 0 } );
+        for ( size_t j = 0; j < 8; ++j ) {
+          test.execute( AllocationBudget { Pop { 500 }, 0 } );
+        }
+      }
+      test.execute( BytesPopped { 416000 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "push more than fits", 1000 };
+      const string data( 1500, 'x' );
+
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( PushPooled { data } );
+        test.execute( Pop { 1000 } );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( AllocationBudget { PushPooled { data }, 0 } );
+        test.execute( AllocationBudget { Pop { 1000 }, 0 } );
+      }
+      test.execute( BytesPopped { 104000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include "eventloop_group.hh"
+#include "test_should_be.hh"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// What each job saw when it ran, recorded under a lock
+class JobLog
+{
+  mutex mutex_ {};
+  condition_variable done_ {};
+  vector<vector<size_t>> sequence_;   // per loop, the job numbers in the order they ran
+  vector<thread::id> thread_;         // per loop, the thread its jobs ran on
+  vector<EventLoop*> loop_;           // per loop, the EventLoop its jobs were given
+  size_t count_ {};
+  string error_ {};
+
+public:
+  explicit JobLog( size_t loops ) : sequence_( loops ), thread_( loops ), loop_( loops ) {}
+
+  void record( size_t index, size_t job, EventLoop& loop )
+  {
+    const lock_guard lock { mutex_ };
+    if ( sequence_.at( index ).empty() ) {
+      thread_.at( index ) = this_thread::get_id();
+      loop_.at( index ) = &loop;
+    } else if ( thread_.at( index ) != this_thread::get_id() or loop_.at( index ) != &loop ) {
+      error_ = "job " + to_string( job ) + " for loop " + to_string( index ) + " ran on another thread or loop";
+    }
+    sequence_.at( index ).push_back( job );
+    ++count_;
+    done_.notify_all();
+  }
+
+  void wait_for( size_t count )
+  {
+    unique_lock lock { mutex_ };
+    if ( not done_.wait_for( lock, chrono::seconds( 5 ), [&] { return count_ >= count; } ) ) {
+      throw runtime_error( "only " + to_string( count_ ) + " of " + to_string( count ) + " jobs ran" );
+    }
+    if ( not error_.empty() ) {
+      throw runtime_error( error_ );
+    }
+  }
+
+  const vector<size_t>& sequence( size_t index ) const { return sequence_.at( index ); }
+  thread::id thread_of( size_t index ) const { return thread_.at( index ); }
+  EventLoop* loop_of( size_t index ) const { return loop_.at( index ); }
+};
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // jobs posted from other threads run on their loop's thread, in the order each producer posted them
+      constexpr size_t loops = 3;
+      constexpr size_t jobs_per_loop = 1000;
+      EventLoopGroup group { loops, false };
+      JobLog log { loops };
+
+      vector<thread> producers;
+      for ( size_t index = 0; index < loops; ++index ) {
+        producers.emplace_back( [&, index] {
+          for ( size_t job = 0; job < jobs_per_loop; ++job ) {
+            group.post( index, [&, index, job]( EventLoop& loop ) { log.record( index, job, loop ); } );
+          }
+        } );
+      }
+      for ( auto& producer : producers ) {
+        producer.join();
+      }
+      log.wait_for( loops * jobs_per_loop );
+
+      for ( size_t index = 0; index < loops; ++index ) {
+        const auto& sequence = log.sequence( index );
+        test_should_be( sequence.size(), jobs_per_loop );
+        for ( size_t job = 0; job < jobs_per_loop; ++job ) {
+          test_should_be( sequence[job], job );
+        }
+        test_should_be( log.thread_of( index ) != this_thread::get_id(), true );
+        for ( size_t other = 0; other < index; ++other ) {
+          test_should_be( log.thread_of( index ) != log.thread_of( other ), true );
+          test_should_be( log.loop_of( index ) != log.loop_of( other ), true );
+        }
+      }
+
+      group.stop();
+      group.stop(); // idempotent
+    }
+
+    {
+      // a job can post to another loop, and jobs for one connection always go to the same loop
+      EventLoopGroup group { 2, false };
+      JobLog log { 2 };
+      const FourTuple tuple { 0x0a000001, 1234, 0x0a000002, 80 };
+      const size_t home = group.loop_for( tuple );
+      const size_t away = 1 - home;
+
+      group.post( away, [&]( EventLoop& loop ) {
+        log.record( away, 0, loop );
+        group.post( tuple, [&]( EventLoop& inner ) { log.record( home, 0, inner ); } );
+      } );
+      group.post( tuple, [&]( EventLoop& loop ) { log.record( home, 1, loop ); } );
+      log.wait_for( 3 );
+
+      test_should_be( log.sequence( away ).size(), 1UL );
+      test_should_be( log.sequence( home ).size(), 2UL ); // the connection's jobs all ran on its loop
+      test_should_be( group.loop_for( tuple ), home );
+      // the destructor stops the loops and joins their threads
+    }
+
+    {
+      // stopping idle loops returns promptly
+      const auto start = chrono::steady_clock::now();
+      {
+        const EventLoopGroup group { 4, false };
+      }
+      test_should_be( chrono::steady_clock::now() - start < chrono::seconds( 2 ), true );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
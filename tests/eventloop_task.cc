@@ -0,0 +1,151 @@
+#include "eventfd.hh"
+#include "eventloop_task.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// Counts how many times the coroutine that holds it has had its frame destroyed
+struct FrameGuard
+{
+  int& destroyed;
+  explicit FrameGuard( int& count ) : destroyed( count ) {}
+  ~FrameGuard() { ++destroyed; }
+  FrameGuard( const FrameGuard& other ) = delete;
+  FrameGuard& operator=( const FrameGuard& other ) = delete;
+  FrameGuard( FrameGuard&& other ) = delete;
+  FrameGuard& operator=( FrameGuard&& other ) = delete;
+};
+
+// Wait for the eventfd to become readable `rounds` times, adding up the counts read
+Task count_notifications( EventLoop& /*loop*/, EventFD& fd, int rounds, uint64_t& total, int& destroyed )
+{
+  const FrameGuard guard { destroyed };
+  for ( int i = 0; i < rounds; ++i ) {
+    co_await readable( fd );
+    total += fd.drain();
+  }
+}
+
+Task fail_after_wakeup( EventLoop& /*loop*/, EventFD& fd, int& destroyed )
+{
+  const FrameGuard guard { destroyed };
+  co_await readable( fd );
+  throw runtime_error( "expected failure" );
+}
+
+Task hold( EventLoop& /*loop*/, shared_ptr<int> /*token*/ )
+{
+  co_await sleep_for( 60000 );
+}
+
+Task sleep_then_set( EventLoop& /*loop*/, uint64_t delay_ms, bool& done )
+{
+  co_await sleep_for( delay_ms );
+  done = true;
+}
+
+void run_until( EventLoop& loop, const bool& done )
+{
+  for ( int i = 0; i < 100 and not done; ++i ) {
+    loop.wait_next_event( 100 );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // a coroutine suspends on a readable fd, is resumed each time the fd is notified, and completes
+      EventLoop loop;
+      EventFD fd;
+      uint64_t total = 0;
+      int destroyed = 0;
+
+      count_notifications( loop, fd, 3, total, destroyed );
+      test_should_be( total, 0UL ); // not run before the loop's next turn
+      test_should_be( destroyed, 0 );
+
+      loop.wait_next_event( 0 ); // start it: it suspends on the fd
+      loop.wait_next_event( 0 );
+      test_should_be( total, 0UL ); // not resumed before the fd was readable
+
+      for ( uint64_t round = 1; round <= 3; ++round ) {
+        fd.notify();
+        fd.notify();
+        loop.wait_next_event( 100 );
+        test_should_be( total, 2 * round );
+      }
+      test_should_be( destroyed, 1 ); // the finished coroutine's frame
+    }
+
+    {
+      // an exception that escapes a resumed coroutine propagates out of the loop, and the frame is destroyed
+      EventLoop loop;
+      EventFD fd;
+      int destroyed = 0;
+
+      fail_after_wakeup( loop, fd, destroyed );
+      loop.wait_next_event( 0 );
+      fd.notify();
+
+      bool threw = false;
+      try {
+        loop.wait_next_event( 100 );
+      } catch ( const runtime_error& e ) {
+        threw = string( e.what() ) == "expected failure";
+      }
+      test_should_be( threw, true );
+      test_should_be( destroyed, 1 );
+    }
+
+    {
+      // a coroutine that is still suspended when its loop goes away is destroyed without being resumed
+      int destroyed = 0;
+      uint64_t total = 0;
+      {
+        EventLoop loop;
+        EventFD fd;
+        count_notifications( loop, fd, 1, total, destroyed );
+        loop.wait_next_event( 0 );
+      }
+      test_should_be( total, 0UL );
+      test_should_be( destroyed, 1 ); // the suspended coroutine went with its loop
+
+      // the frame holds the coroutine's parameters from the start, so a shared_ptr shows whether it was destroyed
+      auto token = make_shared<int>();
+      const weak_ptr<int> watch = token;
+      {
+        EventLoop loop;
+        hold( loop, move( token ) ); // never started
+      }
+      test_should_be( watch.expired(), true ); // the unstarted coroutine went with its loop
+    }
+
+    {
+      // sleep_for resumes after the delay
+      EventLoop loop;
+      bool done = false;
+      const uint64_t start = EventLoop::now_ms();
+      sleep_then_set( loop, 20, done );
+      run_until( loop, done );
+      test_should_be( done, true );
+      test_should_be( EventLoop::now_ms() - start >= 20, true );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "ethernet_header.hh"
+#include "helpers.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// The headers of an Ethernet frame carrying a TCP segment in an IPv4 datagram, as parsed
+struct Headers
+{
+  EthernetHeader ethernet {};
+  IPv4Header ip {};
+  TCPSegment tcp {};
+  bool error {};
+};
+
+Headers parse_frame( vector<string> buffers )
+{
+  Headers headers;
+  Parser parser { move( buffers ) };
+  headers.ethernet.parse( parser );
+  headers.ip.parse( parser );
+  headers.tcp.parse( parser, headers.ip.pseudo_checksum() );
+  headers.error = parser.has_error();
+  return headers;
+}
+
+string serialize_frame( const Headers& headers )
+{
+  Serializer serializer;
+  headers.ethernet.serialize( serializer );
+  headers.ip.serialize( serializer );
+  headers.tcp.serialize( serializer );
+  return concat( serializer.finish() );
+}
+
+// A frame whose headers and payload give every field a value that stands out
+string test_frame()
+{
+  Headers headers;
+  headers.ethernet = { { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 }, { 0x02, 0x66, 0x77, 0x88, 0x99, 0xaa }, 0x800 };
+
+  headers.tcp.udinfo = { 40000, 80, 0 };
+  headers.tcp.message
+    = { TCPSenderMessage { .seqno = Wrap32 { 0x89abcdef }, .payload = string( 100, 'x' ), .FIN = true },
+        TCPReceiverMessage { .ackno = Wrap32 { 0x01234567 }, .window_size = 0xbeef } };
+
+  headers.ip.len = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + 100;
+  headers.ip.id = 0x1234;
+  headers.ip.src = 0x0a000001;
+  headers.ip.dst = 0x0a000002;
+  headers.ip.compute_checksum();
+  headers.tcp.compute_checksum( headers.ip.pseudo_checksum() );
+
+  return serialize_frame( headers );
+}
+
+// Cut `frame` into buffers at each of the (increasing) offsets in `cuts`
+vector<string> split( string_view frame, const vector<size_t>& cuts )
+{
+  vector<string> buffers;
+  size_t start = 0;
+  for ( const size_t cut : cuts ) {
+    buffers.emplace_back( frame.substr( start, cut - start ) );
+    start = cut;
+  }
+  buffers.emplace_back( frame.substr( start ) );
+  return buffers;
+}
+
+// Check that each header parsed from buffers split somehow is the same as when parsed from one buffer
+void expect_same( const Headers& whole, const Headers& pieces )
+{
+  test_should_be( pieces.error, false );
+  test_should_be( concat( serialize( pieces.ethernet ) ), concat( serialize( whole.ethernet ) ) );
+  test_should_be( concat( serialize( pieces.ip ) ), concat( serialize( whole.ip ) ) );
+  test_should_be( concat( serialize( pieces.tcp ) ), concat( serialize( whole.tcp ) ) );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const string frame = test_frame();
+
+    // from one buffer, each header parses to what was serialized
+    const Headers whole = parse_frame( { frame } );
+    test_should_be( whole.error, false );
+    test_should_be( serialize_frame( whole ), frame );
+    test_should_be( whole.tcp.message.sender->payload, string( 100, 'x' ) );
+
+    {
+      // split in two anywhere, including in the middle of a header or of an integer
+      for ( size_t cut = 1; cut < frame.size(); ++cut ) {
+        expect_same( whole, parse_frame( split( frame, { cut } ) ) );
+      }
+    }
+
+    {
+      // split into three around each header boundary
+      const size_t ip_start = EthernetHeader::LENGTH;
+      const size_t tcp_start = ip_start + IPv4Header::LENGTH;
+      const size_t payload_start = tcp_start + TCPSegment::HEADER_LENGTH;
+      for ( const size_t boundary : { ip_start, tcp_start, payload_start } ) {
+        for ( const size_t first : { boundary - 1, boundary, boundary + 1 } ) {
+          expect_same( whole, parse_frame( split( frame, { first, first + 7 } ) ) );
+        }
+      }
+    }
+
+    {
+      // one byte per buffer, so no header is ever contiguous
+      vector<size_t> cuts;
+      for ( size_t cut = 1; cut < frame.size(); ++cut ) {
+        cuts.push_back( cut );
+      }
+      expect_same( whole, parse_frame( split( frame, cuts ) ) );
+    }
+
+    {
+      // the Ethernet header read straight from a contiguous frame (as from a PacketRing) is the same too
+      EthernetHeader ethernet {};
+      test_should_be( ethernet.parse( string_view { frame } ), true );
+      test_should_be( concat( serialize( ethernet ) ), concat( serialize( whole.ethernet ) ) );
+      test_should_be( ethernet.parse( string_view { frame }.substr( 0, EthernetHeader::LENGTH - 1 ) ), false );
+    }
+
+    {
+      // a header cut short is an error whether it was in one buffer or split
+      const size_t ip_start = EthernetHeader::LENGTH;
+      const size_t tcp_start = ip_start + IPv4Header::LENGTH;
+      for ( const size_t length : { ip_start - 1, tcp_start - 1 } ) {
+        const string_view truncated = string_view { frame }.substr( 0, length );
+        test_should_be( parse_frame( { string { truncated } } ).error, true );
+        test_should_be( parse_frame( split( truncated, { length / 2 } ) ).error, true );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
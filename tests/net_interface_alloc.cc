@@ -0,0 +1,144 @@
+#include "alloc_test_harness.hh"
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface_test_harness.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+// An OutputPort that counts the IPv4 frames sent to one Ethernet address, rather than keeping a copy of each (as
+// FramesOut does, which would be counted against the NetworkInterface)
+class FramesCounted : public NetworkInterface::OutputPort
+{
+public:
+  EthernetAddress destination {};
+  uint64_t frames {};
+  uint64_t payload_bytes {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
+  {
+    if ( x.header.type == EthernetHeader::TYPE_IPv4 and x.header.dst == destination ) {
+      ++frames;
+      for ( const auto& buf : x.payload ) {
+        payload_bytes += buf->size();
+      }
+    }
+  }
+};
+
+using InterfaceAndCount = pair<NetworkInterface, shared_ptr<FramesCounted>>;
+
+class CountingInterfaceTestHarness : public TestHarness<InterfaceAndCount>
+{
+public:
+  CountingInterfaceTestHarness( string test_name,
+                                const EthernetAddress& ethernet_address,
+                                const Address& ip_address )
+    : TestHarness( move( test_name ), "eth=" + to_string( ethernet_address ) + ", ip=" + ip_address.ip(), [&] {
+      auto output = make_shared<FramesCounted>();
+      NetworkInterface iface { "test", output, ethernet_address, ip_address };
+      return InterfaceAndCount { move( iface ), move( output ) };
+    }() )
+  {}
+};
+
+struct LearnFromARPRequest : public Action<InterfaceAndCount>
+{
+  EthernetAddress sender_ethernet_address;
+  Address sender_ip_address;
+
+  LearnFromARPRequest( const EthernetAddress& e, const Address& a )
+    : sender_ethernet_address( e ), sender_ip_address( a )
+  {}
+
+  string description() const override
+  {
+    return "receive ARP request from " + to_string( sender_ethernet_address ) + " (" + sender_ip_address.ip() + ")";
+  }
+
+  void execute( InterfaceAndCount& interface ) const override
+  {
+    ARPMessage arp;
+    arp.opcode = ARPMessage::OPCODE_REQUEST;
+    arp.sender_ethernet_address = sender_ethernet_address;
+    arp.sender_ip_address = sender_ip_address.ipv4_numeric();
+    arp.target_ip_address = sender_ip_address.ipv4_numeric() + 1;
+
+    EthernetFrame frame;
+    frame.header.src = sender_ethernet_address;
+    frame.header.dst = ETHERNET_BROADCAST;
+    frame.header.type = EthernetHeader::TYPE_ARP;
+    frame.payload = serialize( arp );
+    interface.first.recv_frame( move( frame ) );
+    interface.second->destination = sender_ethernet_address;
+  }
+};
+
+struct SendDatagramCounted : public Action<InterfaceAndCount>
+{
+  InternetDatagram dgram;
+  Address next_hop;
+
+  SendDatagramCounted( const InternetDatagram& d, Address n ) : dgram( clone( d ) ), next_hop( n ) {}
+
+  string description() const override
+  {
+    return "request to send datagram (to next hop " + next_hop.ip() + "): " + dgram.header.to_string();
+  }
+
+  void execute( InterfaceAndCount& interface ) const override { interface.first.send_datagram( dgram, next_hop ); }
+};
+
+struct FramesSent : public ExpectNumber<InterfaceAndCount, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  string name() const override { return "IPv4 frames sent"; }
+  uint64_t value( const InterfaceAndCount& interface ) const override { return interface.second->frames; }
+};
+
+struct PayloadBytesSent : public ExpectNumber<InterfaceAndCount, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  string name() const override { return "IPv4 payload bytes sent"; }
+  uint64_t value( const InterfaceAndCount& interface ) const override { return interface.second->payload_bytes; }
+};
+
+// Frames are serialized into buffers from the BufferPool that go back to it once sent, so after the first few,
+// sending a datagram should make no heap allocations.
+int main()
+{
+  try {
+    {
+      const EthernetAddress remote_eth = { 0x02, 0, 0, 0, 0, 2 };
+      const Address next_hop { "10.0.1.1", 0 };
+      CountingInterfaceTestHarness test {
+        "send datagrams to a known next hop", { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.1.2", 0 ) };
+      test.execute( LearnFromARPRequest { remote_eth, next_hop } );
+
+      InternetDatagram dgram;
+      dgram.header.src = Address( "10.0.1.2", 0 ).ipv4_numeric();
+      dgram.header.dst = Address( "13.12.11.10", 0 ).ipv4_numeric();
+      dgram.payload.emplace_back( string( 1000, 'x' ) );
+      dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.front()->size();
+      dgram.header.compute_checksum();
+
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( SendDatagramCounted { dgram, next_hop } );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( AllocationBudget { SendDatagramCounted { dgram, next_hop }, 0 } );
+      }
+      test.execute( FramesSent { 104 } );
+      test.execute( PayloadBytesSent { uint64_t { 104 } * dgram.header.len } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,372 @@
+#include "loopback_adapter.hh"
+#include "netem_adapter.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A NetEmAdapter over one end of a LoopbackAdapter pair, and the other end, which sees what makes it through
+struct Path
+{
+  NetEmAdapter<LoopbackAdapter> sender;
+  LoopbackAdapter receiver;
+  uint64_t now_ms {};
+
+  static Path make( const NetEmConfig& netem )
+  {
+    auto [near, far] = LoopbackAdapter::make_pair( LoopbackAdapter::DEFAULT_QUEUE_CAPACITY, false );
+    near.config_mut().netem = netem;
+    return { NetEmAdapter<LoopbackAdapter> { move( near ) }, move( far ) };
+  }
+
+  // a segment whose payload is its number, padded to `size` bytes
+  static TCPMessage segment( uint64_t number, size_t size = 0 )
+  {
+    TCPSenderMessage msg;
+    msg.payload = to_string( number );
+    msg.payload.resize( max( size, msg.payload.size() ), ' ' );
+    return { move( msg ), TCPReceiverMessage {} };
+  }
+
+  void send( uint64_t number ) { sender.write( segment( number ) ); }
+
+  // send `count` segments numbered from 0, all at once (so they reach the queue before any leave it)
+  void send_burst( uint64_t count, size_t size = 0 )
+  {
+    vector<TCPMessage> segs;
+    for ( uint64_t i = 0; i < count; ++i ) {
+      segs.push_back( segment( i, size ) );
+    }
+    sender.write_batch( segs );
+  }
+
+  void tick( uint64_t ms )
+  {
+    now_ms += ms;
+    sender.tick( ms );
+  }
+
+  // the numbers of the segments that have arrived
+  vector<uint64_t> receive()
+  {
+    vector<uint64_t> numbers;
+    while ( auto msg = receiver.read() ) {
+      numbers.push_back( stoull( msg->sender.get().payload ) );
+    }
+    return numbers;
+  }
+
+  // the numbers of the segments that arrive within `ms` milliseconds (ticking once a millisecond)
+  vector<uint64_t> receive_for( uint64_t ms )
+  {
+    vector<uint64_t> numbers = receive();
+    for ( uint64_t i = 0; i < ms; ++i ) {
+      tick( 1 );
+      for ( const uint64_t number : receive() ) {
+        numbers.push_back( number );
+      }
+    }
+    return numbers;
+  }
+};
+
+// Send `count` segments, one per millisecond, and collect everything that arrives within a second after
+vector<uint64_t> run( const NetEmConfig& netem, uint64_t count )
+{
+  Path path = Path::make( netem );
+  vector<uint64_t> received;
+  for ( uint64_t i = 0; i < count + 1000; ++i ) {
+    if ( i < count ) {
+      path.send( i );
+    }
+    path.tick( 1 );
+    for ( const uint64_t number : path.receive() ) {
+      received.push_back( number );
+    }
+  }
+  return received;
+}
+
+// Send `count` segments at once, and collect everything that arrives within ten seconds
+vector<uint64_t> run_burst( const NetEmConfig& netem, uint64_t count )
+{
+  Path path = Path::make( netem );
+  path.send_burst( count );
+  return path.receive_for( 10000 );
+}
+
+// The numbers from 0 to count - 1
+vector<uint64_t> first( uint64_t count )
+{
+  vector<uint64_t> numbers( count );
+  for ( uint64_t i = 0; i < count; ++i ) {
+    numbers[i] = i;
+  }
+  return numbers;
+}
+
+bool rejected( const string& spec )
+{
+  try {
+    parse_netem( spec );
+  } catch ( const runtime_error& ) {
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // the same seed gives the same run
+      NetEmConfig netem;
+      netem.seed = 1;
+      netem.ge_loss_good = 0.2;
+      netem.duplicate = 0.1;
+      netem.reorder = 0.1;
+      netem.delay_ms = 10;
+      netem.jitter_ms = 5;
+      const auto first_run = run( netem, 2000 );
+      test_should_be( run( netem, 2000 ) == first_run, true );
+      netem.seed = 2;
+      test_should_be( run( netem, 2000 ) == first_run, false );
+    }
+
+    {
+      // independent loss at the configured rate
+      NetEmConfig netem;
+      netem.seed = 3;
+      netem.ge_loss_good = 0.1;
+      const auto received = run( netem, 10000 );
+      test_should_be( received.size() > 8800 and received.size() < 9200, true );
+      test_should_be( is_sorted( received.begin(), received.end() ), true ); // no reordering
+      test_should_be( adjacent_find( received.begin(), received.end() ) == received.end(), true ); // or duplicates
+    }
+
+    {
+      // Gilbert-Elliott loss comes in bursts: the chain stays bad for 1/r segments on average
+      NetEmConfig netem;
+      netem.seed = 4;
+      netem.ge_p = 0.01;
+      netem.ge_r = 0.1;
+      const auto received = run( netem, 20000 );
+      const double lost = 20000.0 - static_cast<double>( received.size() );
+      const double expected = 20000.0 * netem.ge_p / ( netem.ge_p + netem.ge_r );
+      test_should_be( lost > 0.7 * expected and lost < 1.3 * expected, true );
+      uint64_t gaps = 0;
+      for ( size_t i = 1; i < received.size(); ++i ) {
+        gaps += received[i] != received[i - 1] + 1;
+      }
+      test_should_be( lost / static_cast<double>( gaps ) > 5, true ); // bursty
+    }
+
+    {
+      // a segment is held for the delay, and jitter never reorders
+      NetEmConfig netem;
+      netem.seed = 5;
+      netem.delay_ms = 50;
+      Path path = Path::make( netem );
+      path.send( 0 );
+      path.tick( 49 );
+      test_should_be( path.receive().empty(), true );
+      path.tick( 1 );
+      test_should_be( path.receive() == vector<uint64_t> { 0 }, true );
+
+      netem.jitter_ms = 20;
+      path = Path::make( netem );
+      vector<uint64_t> sent_ms;
+      uint64_t next = 0;
+      for ( uint64_t i = 0; i < 1000; ++i ) {
+        if ( i < 500 ) {
+          sent_ms.push_back( path.now_ms );
+          path.send( i );
+        }
+        path.tick( 1 );
+        for ( const uint64_t number : path.receive() ) {
+          test_should_be( number, next++ );
+          const uint64_t delay = path.now_ms - sent_ms.at( number );
+          test_should_be( delay >= 30 and delay <= 71, true );
+        }
+      }
+      test_should_be( next, 500UL );
+    }
+
+    {
+      // reordered segments skip the delay, and overtake the ones before them
+      NetEmConfig netem;
+      netem.seed = 6;
+      netem.delay_ms = 20;
+      netem.reorder = 0.25;
+      const auto received = run( netem, 4000 );
+      test_should_be( received.size(), 4000UL );
+      uint64_t overtaken = 0;
+      for ( size_t i = 1; i < received.size(); ++i ) {
+        overtaken += received[i] < received[i - 1];
+      }
+      test_should_be( overtaken > 800 and overtaken < 1200, true );
+    }
+
+    {
+      // duplicates arrive next to the original
+      NetEmConfig netem;
+      netem.seed = 7;
+      netem.delay_ms = 10;
+      netem.duplicate = 0.2;
+      const auto received = run( netem, 10000 );
+      test_should_be( received.size() > 11800 and received.size() < 12200, true );
+      uint64_t next = 0;
+      for ( size_t i = 0; i < received.size(); ++i ) {
+        if ( received[i] != next ) {
+          // a duplicate, straight after its original (and not a third copy)
+          test_should_be( i > 0 and received[i] == received[i - 1] and ( i < 2 or received[i - 2] != received[i] ),
+                          true );
+        } else {
+          ++next;
+        }
+      }
+      test_should_be( next, 10000UL );
+    }
+
+    {
+      // the token bucket lets a burst of `burst` bytes straight through, then spaces segments out to `rate`
+      for ( const auto& [rate, burst] : { pair<uint64_t, uint64_t> { 800'000, 5000 }, { 1'600'000, 3000 } } ) {
+        NetEmConfig netem;
+        netem.seed = 8;
+        netem.rate = rate;
+        netem.burst = burst;
+        Path path = Path::make( netem );
+
+        // segments of 1000 bytes on the wire (with their headers)
+        constexpr size_t wire_size = 1000;
+        path.send_burst( 50, wire_size - 40 );
+        map<uint64_t, uint64_t> arrival_ms;
+        for ( const uint64_t number : path.receive() ) {
+          arrival_ms[number] = path.now_ms;
+        }
+        for ( uint64_t i = 0; i < 1000; ++i ) {
+          path.tick( 1 );
+          for ( const uint64_t number : path.receive() ) {
+            arrival_ms[number] = path.now_ms;
+          }
+        }
+
+        test_should_be( arrival_ms.size(), 50UL );
+        const uint64_t burst_segments = burst / wire_size;
+        const uint64_t spacing_ms = wire_size * 8 * 1000 / rate;
+        for ( const auto& [number, ms] : arrival_ms ) {
+          // the burst at once, then the first of the rest as soon as the bucket refills at all
+          const uint64_t expected_ms = number < burst_segments ? 0 : 1 + ( number - burst_segments ) * spacing_ms;
+          test_should_be( ms, expected_ms );
+        }
+      }
+    }
+
+    {
+      // segments beyond the queue limit are dropped from the tail: the ones that got in all arrive, in order
+      NetEmConfig netem;
+      netem.seed = 9;
+      netem.rate = 800'000;
+      netem.queue_limit = 20;
+      test_should_be( run_burst( netem, 20 ) == first( 20 ), true );
+      test_should_be( run_burst( netem, 21 ) == first( 20 ), true );
+      test_should_be( run_burst( netem, 100 ) == first( 20 ), true );
+
+      // ... and the queue takes segments again once it has room
+      Path path = Path::make( netem );
+      path.send_burst( 100 );
+      test_should_be( path.receive_for( 1000 ).size(), 20UL );
+      path.send_burst( 1 );
+      test_should_be( path.receive_for( 100 ) == first( 1 ), true );
+    }
+
+    {
+      // RED starts dropping before the queue is full, at random, where tail drop would keep everything
+      NetEmConfig netem;
+      netem.rate = 800'000;
+      netem.queue_limit = 100;
+      test_should_be( run_burst( netem, 100 ) == first( 100 ), true );
+
+      netem.red = true;
+      vector<vector<uint64_t>> runs;
+      bool dropped_inside = false;
+      for ( uint64_t seed = 1; seed <= 10; ++seed ) {
+        netem.seed = seed;
+        const auto received = run_burst( netem, 100 );
+        test_should_be( received.size() < 100, true );
+
+        // nothing is dropped while the average queue length is below a quarter of the limit
+        const auto first_drop = static_cast<uint64_t>(
+          mismatch( received.begin(), received.end(), first( 100 ).begin() ).first - received.begin() );
+        test_should_be( first_drop >= netem.queue_limit / 4, true );
+
+        // a segment that arrived after one was dropped shows the drops came early, not only at the tail
+        dropped_inside = dropped_inside or received.back() > first_drop;
+        runs.push_back( received );
+      }
+      test_should_be( dropped_inside, true );
+      test_should_be( adjacent_find( runs.begin(), runs.end(), not_equal_to<>() ) != runs.end(), true );
+    }
+
+    {
+      // parsing accepts the documented items, and rejects bad values
+      const NetEmConfig netem = parse_netem(
+        "delay=40,jitter=5,rate=20e6,burst=3000,limit=100,red,reorder=0.01,dup=0,gemodel=0.1:0.5,seed=9" );
+      test_should_be( netem.delay_ms, 40UL );
+      test_should_be( netem.jitter_ms, 5UL );
+      test_should_be( netem.rate, 20'000'000UL );
+      test_should_be( netem.burst, 3000UL );
+      test_should_be( netem.queue_limit, 100UL );
+      test_should_be( netem.red, true );
+      test_should_be( netem.reorder == 0.01, true );
+      test_should_be( netem.duplicate == 0, true );
+      test_should_be( netem.ge_p == 0.1 and netem.ge_r == 0.5, true );
+      test_should_be( netem.ge_loss_bad == 1 and netem.ge_loss_good == 0, true );
+      test_should_be( netem.seed, 9UL );
+      test_should_be( parse_netem( "gemodel=0.1:0.2:0.9:0.05" ).ge_loss_good == 0.05, true );
+      test_should_be( parse_netem( "rate=1.5e6" ).rate, 1'500'000UL );
+      test_should_be( parse_netem( "" ).enabled(), false );
+
+      for ( const char* spec : { "delay=-5",
+                                 "jitter=-1",
+                                 "rate=-1e6",
+                                 "limit=-1",
+                                 "delay=1.5",
+                                 "burst=0.5",
+                                 "seed=2.5",
+                                 "delay=abc",
+                                 "delay=10ms",
+                                 "delay=",
+                                 "reorder=1.5",
+                                 "reorder=-0.1",
+                                 "dup=2",
+                                 "dup=nan",
+                                 "gemodel=0.1:1.2",
+                                 "gemodel=-0.1",
+                                 "gemodel=0.1:0.2:0.3:0.4:0.5",
+                                 "gemodel=0.1:",
+                                 "loss=0.1" } ) {
+        test_should_be( rejected( spec ), true );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
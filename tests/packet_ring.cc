@@ -0,0 +1,214 @@
+#include "exception.hh"
+#include "packet_ring.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// An EtherType for local experiments (IEEE 802), so the frames can be told apart from other traffic on "lo"
+constexpr uint16_t TEST_TYPE = 0x88b5;
+
+// Small rings, so a test goes around each of them many times
+PacketRing::Config small_rings()
+{
+  PacketRing::Config config;
+  config.rx_block_size = 4096;
+  config.rx_block_count = 4;
+  config.rx_timeout_ms = 1;
+  config.tx_frame_size = 2048;
+  config.tx_frame_count = 4;
+  return config;
+}
+
+// A frame to the loopback interface carrying `number` and `size` bytes of filler
+EthernetFrame test_frame( uint32_t number, size_t size )
+{
+  EthernetFrame frame;
+  frame.header = { {}, {}, TEST_TYPE };
+  string payload( size, static_cast<char>( 'a' + number % 26 ) );
+  memcpy( payload.data(), &number, sizeof( number ) );
+  frame.payload.emplace_back( move( payload ) );
+  return frame;
+}
+
+// The number carried by a test frame, or -1 for any other frame
+int64_t frame_number( string_view frame )
+{
+  EthernetHeader header {};
+  if ( not header.parse( frame ) or header.type != TEST_TYPE or frame.size() < EthernetHeader::LENGTH + 4 ) {
+    return -1;
+  }
+  uint32_t number {};
+  memcpy( &number, frame.data() + EthernetHeader::LENGTH, sizeof( number ) );
+  const string_view filler = frame.substr( EthernetHeader::LENGTH + sizeof( number ) );
+  test_should_be( filler.find_first_not_of( static_cast<char>( 'a' + number % 26 ) ), string_view::npos );
+  return number;
+}
+
+// Collect the numbers of the test frames received until `count` have arrived (or the wait is over)
+vector<uint32_t> receive( PacketRing& ring, size_t count, chrono::milliseconds wait = chrono::seconds( 1 ) )
+{
+  vector<uint32_t> numbers;
+  const auto deadline = chrono::steady_clock::now() + wait;
+  while ( numbers.size() < count and chrono::steady_clock::now() < deadline ) {
+    const size_t got = ring.recv_frames( [&]( string_view frame ) {
+      const int64_t number = frame_number( frame );
+      if ( number >= 0 ) {
+        numbers.push_back( static_cast<uint32_t>( number ) );
+      }
+    } );
+    if ( got == 0 ) {
+      this_thread::sleep_for( chrono::milliseconds( 1 ) );
+    }
+  }
+  return numbers;
+}
+
+// Send frames first to last, `batch` at a time, waiting for the kernel to hand each batch's TX slots back
+void send( PacketRing& ring, uint32_t first, uint32_t last, size_t size, size_t batch )
+{
+  for ( uint32_t number = first; number < last; ) {
+    for ( size_t i = 0; i < batch and number < last; ++i, ++number ) {
+      const auto deadline = chrono::steady_clock::now() + chrono::seconds( 1 );
+      while ( not ring.send_frame( test_frame( number, size ) ) ) {
+        if ( chrono::steady_clock::now() >= deadline ) {
+          throw runtime_error( "TX slot was never handed back" );
+        }
+        this_thread::sleep_for( chrono::milliseconds( 1 ) );
+      }
+    }
+    ring.flush();
+  }
+}
+
+// Send frames first to last two at a time, receiving each pair before sending the next
+vector<uint32_t> exchange( PacketRing& sender, PacketRing& receiver, uint32_t first, uint32_t last, size_t size )
+{
+  vector<uint32_t> numbers;
+  for ( uint32_t number = first; number < last; number += 2 ) {
+    send( sender, number, min( number + 2, last ), size, 2 );
+    for ( const uint32_t received : receive( receiver, min( number + 2, last ) - number ) ) {
+      numbers.push_back( received );
+    }
+  }
+  return numbers;
+}
+
+void expect_in_order( const vector<uint32_t>& numbers, uint32_t first, uint32_t last )
+{
+  test_should_be( numbers.size(), size_t { last - first } );
+  for ( uint32_t i = 0; i < numbers.size(); ++i ) {
+    test_should_be( numbers[i], first + i );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    optional<PacketRing> sender_ring, receiver_ring;
+    try {
+      sender_ring.emplace( "lo", small_rings() );
+      receiver_ring.emplace( "lo", small_rings() );
+    } catch ( const unix_error& e ) {
+      if ( e.code().value() == EPERM ) {
+        cerr << "Skipping: opening a packet socket needs CAP_NET_RAW (" << e.what() << ")\n";
+        return EXIT_SUCCESS;
+      }
+      throw;
+    }
+    PacketRing& sender = sender_ring.value();
+    PacketRing& receiver = receiver_ring.value();
+
+    {
+      // nothing is handed over before anything is sent, and each frame is handed over once: a frame on "lo" is
+      // seen going out (which is skipped) and then coming back in, even by the ring that sent it
+      const chrono::milliseconds short_wait { 100 };
+      receive( receiver, SIZE_MAX, short_wait ); // drain anything already on the interface
+      test_should_be( receive( receiver, 1, short_wait ).empty(), true ); // nothing before anything was sent
+      send( sender, 0, 1, 100, 1 );
+      expect_in_order( receive( receiver, 2, short_wait ), 0, 1 );
+      expect_in_order( receive( sender, 2, short_wait ), 0, 1 );
+    }
+
+    {
+      // the TX ring is full when every slot waits to be sent, and frees its slots once the kernel sends them
+      const size_t slots = sender.config().tx_frame_count;
+      for ( uint32_t number = 0; number < slots; ++number ) {
+        test_should_be( sender.send_frame( test_frame( number, 100 ) ), true );
+      }
+      test_should_be( sender.send_frame( test_frame( 99, 100 ) ), false ); // every slot is in use
+      sender.flush();
+      expect_in_order( receive( receiver, slots ), 0, slots );
+
+      // each slot is handed back, so the ring wraps around (receiving each ringful before sending the next, so
+      // that the RX ring, whose blocks are retired every millisecond, doesn't overflow)
+      vector<uint32_t> numbers;
+      for ( uint32_t first = 0; first < slots * 10; first += slots ) {
+        send( sender, first, first + slots, 100, slots );
+        for ( const uint32_t number : receive( receiver, slots ) ) {
+          numbers.push_back( number );
+        }
+      }
+      expect_in_order( numbers, 0, slots * 10 );
+    }
+
+    {
+      // frames of any size span many RX blocks, which go around the ring while the receiver keeps up
+      uint32_t next = 0;
+      for ( const size_t size : { 60, 500, 1000, 1400 } ) {
+        expect_in_order( exchange( sender, receiver, next, next + 50, size ), next, next + 50 );
+        next += 50;
+      }
+    }
+
+    {
+      // a receiver that falls behind loses the frames that don't fit in the ring, but none of the ones that did,
+      // and the blocks it hands back are filled again
+      const uint32_t count = 100; // about 25 RX blocks' worth, against 4 blocks in the ring
+      send( sender, 0, count, 1000, sender.config().tx_frame_count );
+      this_thread::sleep_for( chrono::milliseconds( 20 ) );
+      const vector<uint32_t> kept = receive( receiver, count, chrono::milliseconds( 100 ) );
+      test_should_be( not kept.empty() and kept.size() < count, true );
+      test_should_be( adjacent_find( kept.begin(), kept.end(), greater_equal<>() ) == kept.end(), true );
+
+      expect_in_order( exchange( sender, receiver, count, count + 20, 1000 ), count, count + 20 );
+    }
+
+    {
+      // a frame the kernel won't send (here, one longer than the interface's MTU) is skipped and its slot handed
+      // back, so the ring keeps going round
+      PacketRing::Config large_slots = small_rings();
+      large_slots.tx_frame_size = 1 << 17;
+      large_slots.tx_frame_count = 2;
+      PacketRing large_sender { "lo", large_slots };
+      test_should_be( large_sender.send_frame( test_frame( 1000, 100'000 ) ), true ); // lo's MTU is 64 KiB
+      large_sender.flush();
+      send( large_sender, 1001, 1011, 100, 1 );
+      expect_in_order( receive( receiver, 10 ), 1001, 1011 );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
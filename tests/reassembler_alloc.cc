@@ -0,0 +1,71 @@
+#include "alloc_test_harness.hh"
+#include "buffer_pool.hh"
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+// Insert a copy of the data made in a buffer from the BufferPool, as the TCPReceiver hands over segment payloads
+struct InsertPooled : public Insert
+{
+  using Insert::Insert;
+
+  void execute( Reassembler& r ) const override
+  {
+    string data = BufferPool::acquire( data_.size() );
+    data.append( data_ );
+    r.insert( first_index_, move( data ), is_last_substring_ );
+  }
+};
+
+// Once the BufferPool is warm, inserting (in order or not) and reading should make no heap allocations
+int main()
+{
+  try {
+    {
+      ReassemblerTestHarness test { "in-order inserts", 4000 };
+      const string data( 1000, 'x' );
+
+      uint64_t index = 0;
+      for ( size_t i = 0; i < 4; ++i, index += 1000 ) {
+        test.execute( InsertPooled { data, index } );
+        test.execute( Pop { 1000 } );
+      }
+      for ( size_t i = 0; i < 100; ++i, index += 1000 ) {
+        test.execute( AllocationBudget { InsertPooled { data, index }, 1 } );
+        test.execute( BytesBuffered { 1000 } );
+        test.execute( AllocationBudget { Pop { 1000 }, 0 } );
+      }
+      test.execute( BytesPopped { 104000 } );
+    }
+
+    {
+      ReassemblerTestHarness test { "one substring out of order, repeatedly", 4000 };
+      const string data( 1000, 'x' );
+
+      uint64_t index = 0;
+      for ( size_t i = 0; i < 4; ++i, index += 2000 ) {
+        test.execute( InsertPooled { data, index + 1000 } );
+        test.execute( InsertPooled { data, index } );
+        test.execute( Pop { 2000 } );
+      }
+      for ( size_t i = 0; i < 100; ++i, index += 2000 ) {
+        test.execute( AllocationBudget { InsertPooled { data, index + 1000 }, 0 } );
+        test.execute( BytesPending { 1000 } );
+        test.execute( AllocationBudget { InsertPooled { data, index }, 0 } );
+        test.execute( BytesPending { 0 } );
+        test.execute( BytesBuffered { 2000 } );
+        test.execute( AllocationBudget { Pop { 2000 }, 0 } );
+      }
+      test.execute( BytesPopped { 208000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
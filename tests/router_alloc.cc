@@ -0,0 +1,159 @@
+#include "alloc_test_harness.hh"
+#include "arp_message.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// An OutputPort that counts the IPv4 frames sent, rather than keeping a copy of each (which would be counted
+// against the Router)
+class FramesCounted : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
+  {
+    frames += x.header.type == EthernetHeader::TYPE_IPv4;
+  }
+};
+
+struct RouterAndOutputs
+{
+  Router router {};
+  vector<shared_ptr<FramesCounted>> outputs {};
+
+  void add_interface( const EthernetAddress& ethernet_address, const Address& ip_address )
+  {
+    outputs.push_back( make_shared<FramesCounted>() );
+    router.add_interface( make_shared<NetworkInterface>(
+      "eth" + to_string( outputs.size() - 1 ), outputs.back(), ethernet_address, ip_address ) );
+  }
+};
+
+class RouterTestHarness : public TestHarness<RouterAndOutputs>
+{
+public:
+  explicit RouterTestHarness( string test_name, string_view desc, RouterAndOutputs&& router )
+    : TestHarness( move( test_name ), desc, move( router ) )
+  {}
+};
+
+EthernetFrame make_frame( const EthernetAddress& src, const uint16_t type, vector<Ref<string>> payload )
+{
+  EthernetFrame frame;
+  frame.header.src = src;
+  frame.header.dst = ETHERNET_BROADCAST;
+  frame.header.type = type;
+  frame.payload = move( payload );
+  return frame;
+}
+
+// Learn a neighbor's Ethernet address from its ARP request
+struct LearnFromARPRequest : public Action<RouterAndOutputs>
+{
+  size_t interface_num;
+  EthernetAddress sender_ethernet_address;
+  Address sender_ip_address;
+
+  LearnFromARPRequest( size_t n, const EthernetAddress& e, const Address& a )
+    : interface_num( n ), sender_ethernet_address( e ), sender_ip_address( a )
+  {}
+
+  string description() const override
+  {
+    return "interface " + to_string( interface_num ) + " receives ARP request from "
+           + to_string( sender_ethernet_address ) + " (" + sender_ip_address.ip() + ")";
+  }
+
+  void execute( RouterAndOutputs& r ) const override
+  {
+    ARPMessage arp;
+    arp.opcode = ARPMessage::OPCODE_REQUEST;
+    arp.sender_ethernet_address = sender_ethernet_address;
+    arp.sender_ip_address = sender_ip_address.ipv4_numeric();
+    arp.target_ip_address = sender_ip_address.ipv4_numeric() + 1;
+    r.router.interface( interface_num )
+      ->recv_frame( make_frame( sender_ethernet_address, EthernetHeader::TYPE_ARP, serialize( arp ) ) );
+  }
+};
+
+struct ReceiveDatagram : public Action<RouterAndOutputs>
+{
+  size_t interface_num;
+  InternetDatagram dgram;
+
+  ReceiveDatagram( size_t n, const InternetDatagram& d ) : interface_num( n ), dgram( clone( d ) ) {}
+
+  string description() const override
+  {
+    return "interface " + to_string( interface_num ) + " receives datagram: " + dgram.header.to_string();
+  }
+
+  void execute( RouterAndOutputs& r ) const override
+  {
+    const auto frame = make_frame( { 0x02, 0, 0, 0, 0, 0xff }, EthernetHeader::TYPE_IPv4, serialize( dgram ) );
+    r.router.interface( interface_num )->recv_frame( clone( frame ) );
+  }
+};
+
+struct Route : public Action<RouterAndOutputs>
+{
+  string description() const override { return "route"; }
+  void execute( RouterAndOutputs& r ) const override { r.router.route(); }
+};
+
+struct FramesSent : public ExpectNumber<RouterAndOutputs, uint64_t>
+{
+  size_t interface_num;
+
+  FramesSent( size_t n, uint64_t frames ) : ExpectNumber( frames ), interface_num( n ) {}
+  string name() const override { return "IPv4 frames sent on interface " + to_string( interface_num ); }
+  uint64_t value( const RouterAndOutputs& r ) const override { return r.outputs.at( interface_num )->frames; }
+};
+
+// The Router moves each datagram from the interface it arrived on to the one it leaves by, so once the first few
+// have warmed up the BufferPool, routing should make no heap allocations.
+int main()
+{
+  try {
+    {
+      RouterAndOutputs r;
+      r.add_interface( { 0x02, 0, 0, 0, 0, 1 }, Address { "10.0.0.1", 0 } );
+      r.add_interface( { 0x02, 0, 0, 0, 1, 1 }, Address { "192.168.0.1", 0 } );
+      r.router.add_route( Address { "10.0.0.0", 0 }.ipv4_numeric(), 8, {}, 0 );
+      r.router.add_route( 0, 0, Address { "192.168.0.2", 0 }, 1 );
+
+      RouterTestHarness test { "forward datagrams to the default route", "two interfaces", move( r ) };
+      test.execute( LearnFromARPRequest { 1, { 0x02, 0, 0, 0, 1, 2 }, Address { "192.168.0.2", 0 } } );
+
+      InternetDatagram dgram;
+      dgram.header.src = Address { "10.0.0.2", 0 }.ipv4_numeric();
+      dgram.header.dst = Address { "1.2.3.4", 0 }.ipv4_numeric();
+      dgram.payload.emplace_back( string( 1000, 'x' ) );
+      dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.front()->size();
+      dgram.header.compute_checksum();
+
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( ReceiveDatagram { 0, dgram } );
+        test.execute( Route {} );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( ReceiveDatagram { 0, dgram } );
+        test.execute( AllocationBudget { Route {}, 0 } );
+      }
+      test.execute( FramesSent { 0, 0 } );
+      test.execute( FramesSent { 1, 104 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
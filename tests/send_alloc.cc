@@ -0,0 +1,107 @@
+#include "alloc_test_harness.hh"
+#include "buffer_pool.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Write a copy of the data (made in a buffer from the BufferPool) to the stream, then push. The segments sent
+// are counted and dropped, rather than copied for ExpectMessage as Push does.
+struct PushPooled : public Action<SenderAndOutput>
+{
+  string data_;
+  uint64_t segments_;
+
+  PushPooled( string data, uint64_t segments ) : data_( move( data ) ), segments_( segments ) {}
+
+  string description() const override
+  {
+    return "push \"" + pretty_print( data_ ) + "\" to stream, then push to TCPSender (expecting "
+           + to_string( segments_ ) + " segments)";
+  }
+
+  void execute( SenderAndOutput& ss ) const override
+  {
+    string data = BufferPool::acquire( data_.size() );
+    data.append( data_ );
+    ss.sender.writer().push( move( data ) );
+
+    uint64_t segments = 0;
+    ss.sender.push( [&segments]( const TCPSenderMessage& /*unused*/ ) { ++segments; } );
+    if ( segments != segments_ ) {
+      throw ExpectationViolation { "segments sent", segments_, segments };
+    }
+  }
+
+  constexpr string obj() const override { return "TCPSender"; }
+};
+
+// Each payload comes from the BufferPool and goes back once acknowledged, so after the first few segments,
+// sending and acknowledging should make no heap allocations.
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "push, then acknowledge, repeatedly", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+
+      const string data( 1000, 'x' );
+      uint64_t acked = 1;
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( PushPooled { data, 1 } );
+        test.execute( AckReceived { isn + ( acked += 1000 ) }.with_win( 4000 ).without_push() );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( AllocationBudget { PushPooled { data, 1 }, 0 } );
+        test.execute( ExpectSeqnosInFlight { 1000 } );
+        test.execute(
+          AllocationBudget { AckReceived { isn + ( acked += 1000 ) }.with_win( 4000 ).without_push(), 0 } );
+        test.execute( ExpectSeqnosInFlight { 0 } );
+      }
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "fill the window with segments, then acknowledge them", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+
+      const string data( 4000, 'x' );
+      uint64_t acked = 1;
+      for ( size_t i = 0; i < 4; ++i ) {
+        test.execute( PushPooled { data, 4 } );
+        test.execute( AckReceived { isn + ( acked += 4000 ) }.with_win( 4000 ).without_push() );
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        test.execute( AllocationBudget { PushPooled { data, 4 }, 0 } );
+        test.execute( ExpectSeqnosInFlight { 4000 } );
+        test.execute(
+          AllocationBudget { AckReceived { isn + ( acked += 4000 ) }.with_win( 4000 ).without_push(), 0 } );
+        test.execute( ExpectSeqnosInFlight { 0 } );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
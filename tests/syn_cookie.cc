@@ -0,0 +1,133 @@
+#include "tcp_stack.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Turn the loop until the peer has received a segment, and return it
+pair<FourTuple, TCPMessage> next_reply( EventLoop& loop, LoopbackAdapter& peer )
+{
+  const uint64_t deadline = EventLoop::now_ms() + 5000;
+  while ( EventLoop::now_ms() < deadline ) {
+    auto replies = peer.read_any_batch( 1 );
+    if ( not replies.empty() ) {
+      return move( replies.front() );
+    }
+    loop.wait_next_event( 10 );
+  }
+  throw runtime_error( "no reply arrived" );
+}
+
+void send( LoopbackAdapter& peer, const FourTuple& tuple, const TCPMessage& msg )
+{
+  peer.write_batch( tuple, span { &msg, 1 } );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const FourTuple tuple { 0x0a000001, 40000, 0x0a000002, 80 };
+    const Wrap32 client_isn { 0x89abcdef };
+    const uint64_t period = 1000;
+
+    {
+      // a cookie is accepted back in the period it was made in, and in the next one
+      const SynCookie cookies { { 0x0123456789abcdefULL, 0xfedcba9876543210ULL } };
+      const Wrap32 cookie = cookies.make( tuple, client_isn, period );
+      test_should_be( cookies.check( tuple, client_isn, cookie, period ), true );
+      test_should_be( cookies.check( tuple, client_isn, cookie, period + 1 ), true );
+      test_should_be( cookies.make( tuple, client_isn, period ), cookie ); // deterministic
+
+      // but not once it has expired, nor before it was made
+      test_should_be( cookies.check( tuple, client_isn, cookie, period + 2 ), false );
+      test_should_be( cookies.check( tuple, client_isn, cookie, period + 32 ), false );
+      test_should_be( cookies.check( tuple, client_isn, cookie, period - 1 ), false );
+
+      // the period is in the top bits
+      test_should_be( cookies.make( tuple, client_isn, period ).unwrap( Wrap32 { 0 }, 0 ) >> 27, period % 32 );
+
+      // a different sequence number or connection doesn't match
+      const FourTuple other_port { tuple.src_ip, 40001, tuple.dst_ip, tuple.dst_port };
+      const FourTuple other_address { tuple.src_ip + 1, tuple.src_port, tuple.dst_ip, tuple.dst_port };
+      test_should_be( cookies.check( tuple, client_isn + 1, cookie, period ), false );
+      test_should_be( cookies.check( tuple, Wrap32 { 0 }, cookie, period ), false );
+      test_should_be( cookies.check( other_port, client_isn, cookie, period ), false );
+      test_should_be( cookies.check( other_address, client_isn, cookie, period ), false );
+      test_should_be( cookies.check( tuple.reversed(), client_isn, cookie, period ), false );
+
+      // flipping any bit of the cookie makes it invalid
+      for ( uint32_t bit = 0; bit < 32; ++bit ) {
+        const Wrap32 tampered { static_cast<uint32_t>( cookie.unwrap( Wrap32 { 0 }, 0 ) ) ^ ( 1U << bit ) };
+        test_should_be( cookies.check( tuple, client_isn, tampered, period ), false );
+      }
+
+      // and a cookie made with another key doesn't match
+      const SynCookie other { { 1, 2 } };
+      test_should_be( other.check( tuple, client_isn, cookie, period ), false );
+    }
+
+    {
+      // with no room in the SYN queue, a stack answers with a cookie and opens the connection when it comes back
+      auto [peer, server_end] = LoopbackAdapter::make_pair();
+      LoopbackStack server { move( server_end ) };
+      EventLoop loop;
+      server.install( loop );
+      server.listen( tuple.dst_port, LoopbackStack::DEFAULT_BACKLOG, 0 );
+
+      send( peer, tuple, { TCPSenderMessage { .seqno = client_isn, .SYN = true }, TCPReceiverMessage {} } );
+      const auto [reply_tuple, syn_ack] = next_reply( loop, peer );
+      test_should_be( reply_tuple == tuple.reversed(), true );
+      test_should_be( syn_ack.sender->SYN, true );
+      test_should_be( syn_ack.receiver->ackno == client_isn + 1, true );
+      test_should_be( server.listener_stats( tuple.dst_port ).syn_cookies_sent, 1UL );
+      test_should_be( server.connection_count(), 0UL ); // no state kept for a SYN answered with a cookie
+      const Wrap32 cookie = syn_ack.sender->seqno;
+
+      // an ACK with a tampered sequence number, or that acknowledges something else, is reset
+      const vector<pair<Wrap32, Wrap32>> tampered {
+        { client_isn + 2, cookie + 1 },
+        { client_isn + 1, cookie + 2 },
+      };
+      for ( const auto& [seqno, ackno] : tampered ) {
+        send( peer, tuple, { TCPSenderMessage { .seqno = seqno }, TCPReceiverMessage { .ackno = ackno } } );
+        const auto [rst_tuple, rst] = next_reply( loop, peer );
+        test_should_be( rst_tuple == tuple.reversed(), true );
+        test_should_be( rst.sender->RST or rst.receiver->RST, true );
+        test_should_be( server.connection_count(), 0UL );
+        test_should_be( server.accept_queue_size( tuple.dst_port ), 0UL );
+      }
+
+      // the real ACK opens the connection
+      send( peer,
+            tuple,
+            { TCPSenderMessage { .seqno = client_isn + 1, .payload = "hello" },
+              TCPReceiverMessage { .ackno = cookie + 1 } } );
+      const uint64_t deadline = EventLoop::now_ms() + 5000;
+      while ( server.accept_queue_size( tuple.dst_port ) == 0 and EventLoop::now_ms() < deadline ) {
+        loop.wait_next_event( 10 );
+      }
+      const auto conn = server.accept( tuple.dst_port );
+      test_should_be( conn and conn->established(), true );
+      test_should_be( server.listener_stats( tuple.dst_port ).syn_cookies_accepted, 1UL );
+      const LoopbackStack::Connection& view = *conn;
+      test_should_be( string { view.inbound_reader().peek() }, string { "hello" } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include "alloc_counter.hh"
+#include "buffer_pool.hh"
+#include "helpers.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One end of a connection, and the datagrams on their way to it (each in one piece, as a TUN device carries it)
+struct Endpoint
+{
+  TCPPeer peer;
+  FourTuple tuple {}; // outgoing
+  Endpoint* other {};
+  vector<string> wire {};
+  vector<TCPMessage> inbound {};
+  uint64_t bytes_read {};
+
+  explicit Endpoint( const TCPConfig& cfg ) : peer( cfg ) {}
+  Endpoint( const Endpoint& other ) = delete;
+  Endpoint& operator=( const Endpoint& other ) = delete;
+
+  // Wrap and serialize a segment to the other endpoint, as TCPOverIPv4OverTunFdAdapter does to write it
+  void transmit( const TCPMessage& msg ) const
+  {
+    auto ip_dgram = TCPOverIPv4Adapter::wrap_tcp_in_ip( tuple, msg );
+    auto buffers = serialize( ip_dgram );
+    size_t size = 0;
+    for ( const auto& buf : buffers ) {
+      size += buf->size();
+    }
+    string datagram = BufferPool::acquire( size );
+    for ( const auto& buf : buffers ) {
+      datagram.append( buf );
+    }
+    other->wire.push_back( move( datagram ) );
+    BufferPool::release( move( buffers ) );
+    BufferPool::release( move( ip_dgram.payload ) );
+  }
+
+  TCPPeer::TransmitFunction transmitter()
+  {
+    return [this]( const TCPMessage& msg ) { transmit( msg ); };
+  }
+
+  // Parse whatever has arrived, as TCPOverIPv4OverTunFdAdapter does to read it, and give it to the peer
+  void receive()
+  {
+    for ( auto& datagram : wire ) {
+      auto list = BufferPool::acquire_list();
+      list.emplace_back( move( datagram ) );
+      InternetDatagram ip_dgram;
+      if ( not parse( ip_dgram, move( list ) ) ) {
+        throw runtime_error( "could not parse datagram" );
+      }
+      auto segment = TCPOverIPv4Adapter::demux_tcp_in_ip( move( ip_dgram ) );
+      if ( not segment ) {
+        throw runtime_error( "could not parse segment" );
+      }
+      inbound.push_back( move( segment->second ) );
+    }
+    wire.clear();
+    peer.receive_batch( inbound, transmitter() );
+    inbound.clear();
+  }
+
+  // The application: read everything that has arrived, and write as much as will fit
+  void run_application( const string_view data )
+  {
+    bytes_read += peer.inbound_reader().bytes_buffered();
+    peer.inbound_reader().pop( peer.inbound_reader().bytes_buffered() );
+    peer.update_window( transmitter() );
+
+    auto& writer = peer.outbound_writer();
+    while ( writer.available_capacity() > 0 ) {
+      string chunk = BufferPool::acquire( data.size() );
+      chunk.append( data.substr( 0, writer.available_capacity() ) );
+      writer.push( move( chunk ) );
+    }
+    peer.push( transmitter() );
+  }
+};
+
+// Move data both ways between two TCPPeers through serialized IPv4 datagrams, and count the heap allocations
+// made once the connection is in a steady state: the BufferPool should by then have every buffer it needs.
+void alloc_test( fstream& debug_output, const size_t warmup_rounds, const size_t rounds )
+{
+  TCPConfig cfg;
+  Endpoint client { cfg };
+  Endpoint server { cfg };
+  client.tuple = { 0x0a000001, 40000, 0x0a000002, 80 };
+  server.tuple = client.tuple.reversed();
+  client.other = &server;
+  server.other = &client;
+
+  const string data( 4 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+  client.peer.push( client.transmitter() );
+
+  AllocationCounter counter;
+  for ( size_t round = 0; round < warmup_rounds + rounds; ++round ) {
+    if ( round == warmup_rounds ) {
+      client.bytes_read = server.bytes_read = 0;
+      counter.reset();
+    }
+    server.receive();
+    client.receive();
+    client.run_application( data );
+    server.run_application( data );
+  }
+  const uint64_t allocations = counter.count().allocations;
+
+  const uint64_t bytes = client.bytes_read + server.bytes_read;
+  cout << "Moved " << bytes << " bytes through " << rounds << " rounds with " << allocations
+       << " heap allocations.\n";
+  debug_output << "  " << bytes << " bytes in the steady state: " << allocations << " allocations\n";
+
+  if ( bytes < rounds * TCPConfig::MAX_PAYLOAD_SIZE ) {
+    throw runtime_error( "The connection did not carry data in both directions" );
+  }
+  if ( allocations != 0 ) {
+    throw runtime_error( "The steady-state packet path allocated " + to_string( allocations ) + " times" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  alloc_test( debug_output, 500, 2000 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
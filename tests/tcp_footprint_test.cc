@@ -0,0 +1,110 @@
+#include "buffer_pool.hh"
+#include "loopback_adapter.hh"
+#include "tcp_peer.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Heap bytes in use (from the allocator's own count, so it includes everything the peers allocated), less what
+// the thread's BufferPool is keeping for the next connection to use
+size_t heap_in_use()
+{
+  BufferPool::trim();
+  return mallinfo2().uordblks;
+}
+
+// Open `pairs` connections between pairs of TCPPeers, move `bytes_each_way` in each direction on each one and
+// read it all, then leave the connections open and idle. Measure the memory each idle peer holds (itself, on
+// the heap, and whatever its streams, reassembler and sender still hold), so a stack can keep many of them.
+void footprint_test( fstream& debug_output, const size_t pairs, const size_t bytes_each_way, const size_t limit )
+{
+  vector<unique_ptr<TCPPeer>> peers;
+  peers.reserve( 2 * pairs );
+  const string data( bytes_each_way, 'x' );
+
+  const size_t heap_before = heap_in_use();
+  for ( size_t i = 0; i < pairs; ++i ) {
+    TCPConfig cfg;
+    cfg.isn = Wrap32 { static_cast<uint32_t>( i ) };
+    auto client = make_unique<TCPPeer>( cfg );
+    auto server = make_unique<TCPPeer>( cfg );
+
+    {
+      auto [client_end, server_end] = LoopbackAdapter::make_pair( LoopbackAdapter::DEFAULT_QUEUE_CAPACITY, false );
+      const auto to_server = [&]( const TCPMessage& msg ) { client_end.write( msg ); };
+      const auto to_client = [&]( const TCPMessage& msg ) { server_end.write( msg ); };
+
+      client->push( to_server );
+      client->outbound_writer().push( data );
+      server->outbound_writer().push( data );
+      for ( size_t round = 0; round < 100; ++round ) {
+        client->push( to_server );
+        server->push( to_client );
+        auto inbound = server_end.read_batch( 64 );
+        server->receive_batch( inbound, to_client );
+        auto outbound = client_end.read_batch( 64 );
+        client->receive_batch( outbound, to_server );
+        for ( auto* peer : { client.get(), server.get() } ) {
+          peer->inbound_reader().pop( peer->inbound_reader().bytes_buffered() );
+        }
+        client->update_window( to_server );
+        server->update_window( to_client );
+        if ( inbound.empty() and outbound.empty() ) {
+          break;
+        }
+      }
+    }
+
+    for ( auto* peer : { client.get(), server.get() } ) {
+      if ( not peer->active() or peer->inbound_reader().bytes_popped() != bytes_each_way
+           or peer->sender().sequence_numbers_in_flight() != 0 ) {
+        throw runtime_error( "Connection did not reach an idle state" );
+      }
+    }
+    peers.push_back( move( client ) );
+    peers.push_back( move( server ) );
+  }
+  const size_t heap_after = heap_in_use();
+
+  const double bytes_per_peer
+    = static_cast<double>( heap_after - heap_before ) / static_cast<double>( peers.size() );
+
+  cout << "Idle TCPPeer (sizeof " << sizeof( TCPPeer ) << ") after moving " << bytes_each_way
+       << " bytes each way holds " << fixed << setprecision( 0 ) << bytes_per_peer << " bytes.\n";
+
+  debug_output << "  idle TCPPeer after " << setw( 6 ) << bytes_each_way << " bytes each way: " << setw( 5 )
+               << fixed << setprecision( 0 ) << bytes_per_peer << " bytes\n";
+
+  if ( bytes_per_peer > static_cast<double>( limit ) ) {
+    throw runtime_error( "Idle TCPPeer holds more than " + to_string( limit ) + " bytes" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  footprint_test( debug_output, 10000, 0, 512 );
+  footprint_test( debug_output, 10000, 3000, 512 );
+  footprint_test( debug_output, 1000, 60000, 512 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
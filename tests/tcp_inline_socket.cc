@@ -0,0 +1,169 @@
+#include "tcp_minnow_socket.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Two inline sockets connected over a LoopbackAdapter pair, both driven from this thread once connected
+struct Connection
+{
+  unique_ptr<LoopbackMinnowInlineSocket> client {};
+  unique_ptr<LoopbackMinnowInlineSocket> server {};
+
+  Connection()
+  {
+    auto [client_end, server_end] = LoopbackAdapter::make_pair();
+    client = make_unique<LoopbackMinnowInlineSocket>( move( client_end ) );
+    server = make_unique<LoopbackMinnowInlineSocket>( move( server_end ) );
+
+    // connect() and listen_and_accept() each run their own socket until the handshake is done
+    TCPConfig cfg;
+    cfg.rt_timeout = 10;
+    thread accepter { [&] { server->listen_and_accept( cfg, {} ); } };
+    client->connect( cfg, {} );
+    accepter.join();
+  }
+
+  // Wait (briefly) for segments, then let the sockets (those not yet destroyed) take them in and run their timers
+  void process()
+  {
+    array<pollfd, 2> fds {};
+    size_t count = 0;
+    for ( auto* socket : { client.get(), server.get() } ) {
+      if ( socket ) {
+        fds.at( count++ ) = { socket->fd().fd_num(), POLLIN, 0 };
+      }
+    }
+    ::poll( fds.data(), count, 10 );
+    for ( auto* socket : { client.get(), server.get() } ) {
+      if ( socket ) {
+        socket->process();
+      }
+    }
+  }
+};
+
+// Write `data` to `from` while reading it at `to`, and return what was read
+string transfer( Connection& conn,
+                 LoopbackMinnowInlineSocket& from,
+                 LoopbackMinnowInlineSocket& to,
+                 string_view data )
+{
+  string received, buffer;
+  size_t written = 0;
+  const uint64_t deadline = EventLoop::now_ms() + 10000;
+  while ( received.size() < data.size() and not to.eof() ) {
+    if ( EventLoop::now_ms() >= deadline ) {
+      throw runtime_error( "transfer timed out" );
+    }
+    if ( written < data.size() ) {
+      written += from.write( data.substr( written ) );
+    }
+    to.read( buffer );
+    received += buffer;
+    conn.process();
+  }
+  return received;
+}
+
+// Read from `socket` until its inbound stream ends, and return what was read
+string read_to_eof( Connection& conn, LoopbackMinnowInlineSocket& socket )
+{
+  string received, buffer;
+  const uint64_t deadline = EventLoop::now_ms() + 5000;
+  while ( true ) {
+    socket.read( buffer );
+    received += buffer;
+    if ( socket.eof() ) {
+      return received;
+    }
+    if ( EventLoop::now_ms() >= deadline ) {
+      throw runtime_error( "no EOF" );
+    }
+    conn.process();
+  }
+}
+
+// A megabyte of bytes that differ from their neighbours
+string test_data( size_t seed )
+{
+  string data( 1 << 20, '\0' );
+  for ( size_t i = 0; i < data.size(); ++i ) {
+    data[i] = static_cast<char>( ( i * 131 + seed ) >> 3 );
+  }
+  return data;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // connect, carry a transfer each way, and close cleanly from both ends
+      Connection conn;
+      test_should_be( conn.client->active(), true );
+      test_should_be( conn.server->active(), true );
+
+      const string upload = test_data( 1 );
+      const string download = test_data( 2 );
+      test_should_be( transfer( conn, *conn.client, *conn.server, upload ), upload );
+      test_should_be( transfer( conn, *conn.server, *conn.client, download ), download );
+
+      conn.client->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( conn, *conn.server ), string {} );
+      test_should_be( conn.client->eof(), false );
+
+      bool threw = false;
+      try {
+        conn.client->write( "more" );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      test_should_be( threw, true );
+
+      conn.server->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( conn, *conn.client ), string {} );
+      test_should_be( conn.client->has_error(), false );
+      test_should_be( conn.server->has_error(), false );
+
+      // one thread drives both ends, so neither can wait_until_closed() on its own
+      const uint64_t deadline = EventLoop::now_ms() + 5000;
+      while ( conn.client->active() or conn.server->active() ) {
+        if ( EventLoop::now_ms() >= deadline ) {
+          throw runtime_error( "connection did not finish" );
+        }
+        conn.process();
+      }
+    }
+
+    {
+      // a socket destroyed without closing resets the connection, which the peer sees as an error
+      Connection conn;
+      test_should_be( transfer( conn, *conn.server, *conn.client, "hello" ), string { "hello" } );
+      conn.server.reset();
+      read_to_eof( conn, *conn.client );
+      test_should_be( conn.client->has_error(), true );
+      test_should_be( conn.client->active(), false );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
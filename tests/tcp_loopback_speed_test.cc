@@ -0,0 +1,125 @@
+#include "loopback_adapter.hh"
+#include "tcp_peer.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// Move `input_len` bytes from one TCPPeer to another through a LoopbackAdapter pair, in one thread and without
+// any system calls, so the time is all spent in the sender, receiver, reassembler and ByteStreams.
+void speed_test( fstream& debug_output,
+                 const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t burst )      // NOLINT(bugprone-easily-swappable-parameters)
+{
+  // Generate a block of data to be written (repeatedly)
+  const string block = [&] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < 1 << 20; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig cfg;
+  cfg.isn = Wrap32 { static_cast<uint32_t>( random_seed ) };
+  TCPPeer client { cfg }, server { cfg };
+  auto [client_end, server_end] = LoopbackAdapter::make_pair( LoopbackAdapter::DEFAULT_QUEUE_CAPACITY, false );
+
+  uint64_t segments = 0;
+  const auto to_server = [&]( const TCPMessage& msg ) {
+    segments += not msg.sender->payload.empty();
+    client_end.write( msg );
+  };
+  const auto to_client = [&]( const TCPMessage& msg ) { server_end.write( msg ); };
+
+  size_t bytes_written = 0;
+  size_t bytes_read = 0;
+
+  const auto start_time = steady_clock::now();
+  while ( not server.inbound_reader().is_finished() ) {
+    auto& writer = client.outbound_writer();
+    while ( bytes_written < input_len and writer.available_capacity() > 0 ) {
+      const size_t offset = bytes_written % block.size();
+      const size_t len = min( { write_size, writer.available_capacity(), input_len - bytes_written } );
+      writer.push( block.substr( offset, min( len, block.size() - offset ) ) );
+      bytes_written += min( len, block.size() - offset );
+    }
+    if ( bytes_written == input_len and not writer.is_closed() ) {
+      writer.close();
+    }
+    client.push( to_server );
+
+    auto inbound = server_end.read_batch( burst );
+    server.receive_batch( inbound, to_client );
+
+    auto& reader = server.inbound_reader();
+    while ( reader.bytes_buffered() ) {
+      const size_t offset = bytes_read % block.size();
+      const string_view peeked = reader.peek().substr( 0, block.size() - offset );
+      if ( peeked != string_view { block }.substr( offset, peeked.size() ) ) {
+        throw runtime_error( "Mismatch between data written and read" );
+      }
+      bytes_read += peeked.size();
+      reader.pop( peeked.size() );
+    }
+    server.update_window( to_client );
+
+    auto acks = client_end.read_batch( burst );
+    client.receive_batch( acks, to_server );
+
+    if ( inbound.empty() and acks.empty() and writer.available_capacity() == 0 ) {
+      throw runtime_error( "TCPPeer stalled" );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes_read != input_len ) {
+    throw runtime_error( "Wrong number of bytes received" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+  auto segments_per_second = static_cast<double>( segments ) / test_duration.count();
+
+  cout << "TCPPeer -> TCPPeer with write_size=" << write_size << ", burst=" << burst << " reached " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s, " << setprecision( 0 ) << segments_per_second
+       << " segments/s.\n";
+
+  debug_output << "        TCPPeer loopback throughput (burst " << setw( 2 ) << burst << "): " << fixed
+               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "TCPPeer loopback did not meet minimum speed of 0.1 Gbit/s" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, 1e9, 16384, 1234, 64 );
+  speed_test( debug_output, 1e8, 16384, 1234, 1 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
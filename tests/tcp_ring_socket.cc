@@ -0,0 +1,165 @@
+#include "tcp_minnow_socket.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Small rings, so that a transfer goes around them many times
+constexpr uint64_t RING_CAPACITY = 4096;
+
+// Two ring sockets connected over a LoopbackAdapter pair
+struct Connection
+{
+  unique_ptr<LoopbackMinnowRingSocket> client {};
+  unique_ptr<LoopbackMinnowRingSocket> server {};
+
+  Connection()
+  {
+    auto [client_end, server_end] = LoopbackAdapter::make_pair();
+    client = make_unique<LoopbackMinnowRingSocket>( move( client_end ), RING_CAPACITY );
+    server = make_unique<LoopbackMinnowRingSocket>( move( server_end ), RING_CAPACITY );
+
+    TCPConfig cfg;
+    cfg.rt_timeout = 10;
+    thread accepter { [&] { server->listen_and_accept( cfg, {} ); } };
+    client->connect( cfg, {} );
+    accepter.join();
+  }
+};
+
+// Wait (briefly) until either socket may make progress
+void wait( LoopbackMinnowRingSocket& a, LoopbackMinnowRingSocket& b )
+{
+  array<pollfd, 2> fds { { { a.fd().fd_num(), POLLIN, 0 }, { b.fd().fd_num(), POLLIN, 0 } } };
+  ::poll( fds.data(), fds.size(), 10 );
+}
+
+// Write `data` to `from` while reading it at `to`, and return what was read
+string transfer( LoopbackMinnowRingSocket& from, LoopbackMinnowRingSocket& to, string_view data )
+{
+  string received, buffer;
+  size_t written = 0;
+  const uint64_t deadline = EventLoop::now_ms() + 10000;
+  while ( received.size() < data.size() and not to.eof() ) {
+    if ( EventLoop::now_ms() >= deadline ) {
+      throw runtime_error( "transfer timed out" );
+    }
+    const size_t n = written < data.size() ? from.write( data.substr( written ) ) : 0;
+    written += n;
+    to.read( buffer );
+    received += buffer;
+    if ( n == 0 and buffer.empty() ) {
+      wait( from, to );
+    }
+  }
+  return received;
+}
+
+// Read from `socket` until its inbound stream ends, and return what was read
+string read_to_eof( LoopbackMinnowRingSocket& socket )
+{
+  string received, buffer;
+  const uint64_t deadline = EventLoop::now_ms() + 5000;
+  while ( not socket.eof() ) {
+    if ( EventLoop::now_ms() >= deadline ) {
+      throw runtime_error( "no EOF" );
+    }
+    socket.read( buffer );
+    received += buffer;
+    if ( buffer.empty() and not socket.eof() ) {
+      wait( socket, socket );
+    }
+  }
+  return received;
+}
+
+// A megabyte of bytes that differ from their neighbours
+string test_data( size_t seed )
+{
+  string data( 1 << 20, '\0' );
+  for ( size_t i = 0; i < data.size(); ++i ) {
+    data[i] = static_cast<char>( ( i * 131 + seed ) >> 3 );
+  }
+  return data;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // transfers much larger than the rings arrive whole, in both directions
+      Connection conn;
+      const string upload = test_data( 1 );
+      const string download = test_data( 2 );
+      test_should_be( transfer( *conn.client, *conn.server, upload ), upload );
+      test_should_be( transfer( *conn.server, *conn.client, download ), download );
+
+      conn.client->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( *conn.server ), string {} );
+      conn.server->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( *conn.client ), string {} );
+      test_should_be( conn.client->has_error(), false );
+      test_should_be( conn.server->has_error(), false );
+      conn.server->wait_until_closed();
+      conn.client->wait_until_closed();
+    }
+
+    {
+      // shutting down the outbound stream ends the peer's inbound stream, while the other direction carries on
+      Connection conn;
+      test_should_be( transfer( *conn.client, *conn.server, "request" ), string { "request" } );
+      conn.client->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( *conn.server ), string {} );
+      test_should_be( conn.server->eof(), true );
+      test_should_be( conn.server->has_error(), false );
+
+      bool threw = false;
+      try {
+        conn.client->write( "more" );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      test_should_be( threw, true );
+
+      const string response = test_data( 3 );
+      test_should_be( transfer( *conn.server, *conn.client, response ), response );
+      test_should_be( conn.client->eof(), false );
+      conn.server->shutdown( SHUT_WR );
+      test_should_be( read_to_eof( *conn.client ), string {} );
+      test_should_be( conn.client->eof(), true );
+      conn.server->wait_until_closed();
+      conn.client->wait_until_closed();
+    }
+
+    {
+      // a socket destroyed without closing resets the connection, which the peer sees as an error
+      Connection conn;
+      test_should_be( transfer( *conn.server, *conn.client, "hello" ), string { "hello" } );
+      conn.server.reset();
+      read_to_eof( *conn.client );
+      test_should_be( conn.client->has_error(), true );
+      conn.client->wait_until_closed();
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
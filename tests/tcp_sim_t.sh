@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Two runs of the simulator with the same seed should report the same results (all but the real time taken)
+SIM="${1}/apps/tcp_sim -n 4 -t 5 -b 0 -D 5 -i 100 -q 30 -S 7"
+
+FIRST=`${SIM} | grep -v "of real time"`
+SECOND=`${SIM} | grep -v "of real time"`
+
+echo "${FIRST}"
+if [ -z "${FIRST}" ] || [ "${FIRST}" != "${SECOND}" ]; then
+    echo ERROR: two runs of tcp_sim with the same seed gave different results
+    diff <(echo "${FIRST}") <(echo "${SECOND}")
+    exit 1
+fi
+exit 0
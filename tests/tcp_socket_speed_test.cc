@@ -0,0 +1,289 @@
+#include "tcp_minnow_socket.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <string_view>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+// What to poll to wait until a socket can be written or read
+pollfd writable( LoopbackMinnowSocket& socket )
+{
+  return { socket.fd_num(), POLLOUT, 0 };
+}
+pollfd readable( LoopbackMinnowSocket& socket )
+{
+  return { socket.fd_num(), POLLIN, 0 };
+}
+pollfd writable( LoopbackMinnowRingSocket& socket )
+{
+  return { socket.fd().fd_num(), POLLIN, 0 };
+}
+pollfd readable( LoopbackMinnowRingSocket& socket )
+{
+  return { socket.fd().fd_num(), POLLIN, 0 };
+}
+pollfd writable( LoopbackMinnowInlineSocket& socket )
+{
+  return { socket.fd().fd_num(), POLLIN, 0 };
+}
+pollfd readable( LoopbackMinnowInlineSocket& socket )
+{
+  return { socket.fd().fd_num(), POLLIN, 0 };
+}
+
+// An inline socket is driven by its owner: let it take in segments and run its timers (the others have a
+// TCPPeer thread for that)
+template<class Socket>
+void service( Socket& /* socket */ )
+{}
+void service( LoopbackMinnowInlineSocket& socket )
+{
+  socket.process();
+}
+
+// How long the owner may wait in poll()
+template<class Socket>
+int poll_timeout( Socket& /* socket */ )
+{
+  return 100;
+}
+int poll_timeout( LoopbackMinnowInlineSocket& socket )
+{
+  return socket.timeout_ms();
+}
+
+template<class Socket>
+void wait( Socket& client, pollfd client_event, Socket& server, pollfd server_event )
+{
+  array<pollfd, 2> fds { client_event, server_event };
+  ::poll( fds.data(), fds.size(), min( poll_timeout( client ), poll_timeout( server ) ) );
+}
+
+// Connect a client to a server over a LoopbackAdapter pair
+template<class Socket>
+void open( Socket& client, Socket& server, const TCPConfig& cfg )
+{
+  thread accepter { [&] { server.listen_and_accept( cfg, {} ); } };
+  client.connect( cfg, {} );
+  accepter.join();
+}
+
+// Shut both sockets down and wait for the connection to finish
+template<class Socket>
+void close( Socket& client, Socket& server )
+{
+  client.shutdown( SHUT_WR );
+  server.wait_until_closed();
+  client.wait_until_closed();
+}
+void close( LoopbackMinnowInlineSocket& client, LoopbackMinnowInlineSocket& server )
+{
+  // one thread drives both ends, so neither can wait_until_closed() on its own
+  client.shutdown( SHUT_RDWR );
+  server.shutdown( SHUT_RDWR );
+  while ( client.active() or server.active() ) {
+    array<pollfd, 2> fds { readable( client ), readable( server ) };
+    const int timeout = client.active() and server.active()
+                          ? min( client.timeout_ms(), server.timeout_ms() )
+                          : max( client.timeout_ms(), server.timeout_ms() );
+    ::poll( fds.data(), fds.size(), timeout );
+    client.process();
+    server.process();
+  }
+}
+
+// Move `input_len` bytes between two sockets joined by a LoopbackAdapter pair, writing to one and reading from
+// the other in this thread (while each socket's TCPPeer thread, or this one, runs the connection), and so
+// measure what it costs to carry bytes between the owner and the TCPPeer.
+template<class Socket>
+void speed_test( fstream& debug_output,
+                 const string_view name,
+                 const size_t input_len,  // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t write_size, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed )
+{
+  // Generate a block of data to be written (repeatedly)
+  const string block = [&] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < 1 << 20; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 10; // (so the client doesn't linger long once the connection is over)
+  cfg.isn = Wrap32 { static_cast<uint32_t>( random_seed ) };
+  auto [client_end, server_end] = LoopbackAdapter::make_pair();
+  Socket client { move( client_end ) }, server { move( server_end ) };
+  open( client, server, cfg );
+
+  size_t bytes_written = 0;
+  size_t bytes_read = 0;
+  string buffer;
+
+  const auto start_time = steady_clock::now();
+  while ( not server.eof() ) {
+    bool progress = false;
+    service( client );
+    service( server );
+
+    if ( bytes_written < input_len ) {
+      const size_t offset = bytes_written % block.size();
+      const size_t len = min( { write_size, block.size() - offset, input_len - bytes_written } );
+      const size_t written = client.write( string_view { block }.substr( offset, len ) );
+      bytes_written += written;
+      progress |= written > 0;
+      if ( bytes_written == input_len ) {
+        client.shutdown( SHUT_WR );
+      }
+    }
+
+    buffer.clear();
+    server.read( buffer );
+    for ( string_view rest = buffer; not rest.empty(); ) {
+      const size_t offset = bytes_read % block.size();
+      const string_view expected = string_view { block }.substr( offset, rest.size() );
+      if ( rest.substr( 0, expected.size() ) != expected ) {
+        throw runtime_error( "Mismatch between data written and read" );
+      }
+      bytes_read += expected.size();
+      rest.remove_prefix( expected.size() );
+    }
+    progress |= not buffer.empty();
+
+    if ( not progress and not server.eof() ) {
+      const pollfd client_event = bytes_written < input_len ? writable( client ) : pollfd { -1, 0, 0 };
+      wait( client, client_event, server, readable( server ) );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  close( client, server );
+
+  if ( bytes_read != input_len ) {
+    throw runtime_error( "Wrong number of bytes received" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+
+  cout << name << " with write_size=" << write_size << " reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s.\n";
+
+  debug_output << "  " << setw( 26 ) << name << " throughput: " << fixed << setprecision( 2 ) << setw( 5 )
+               << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( string { name } + " did not meet minimum speed of 0.1 Gbit/s" );
+  }
+}
+
+// Send `message` from one socket to the other, and read it there
+template<class Socket>
+void send_message( Socket& from, Socket& to, const string_view message, string& buffer )
+{
+  size_t bytes_written = 0;
+  size_t bytes_read = 0;
+  while ( bytes_read < message.size() ) {
+    bool progress = false;
+    service( from );
+    service( to );
+
+    if ( bytes_written < message.size() ) {
+      const size_t written = from.write( message.substr( bytes_written ) );
+      bytes_written += written;
+      progress |= written > 0;
+    }
+
+    to.read( buffer );
+    if ( buffer != message.substr( bytes_read, buffer.size() ) ) {
+      throw runtime_error( "Mismatch between message written and read" );
+    }
+    bytes_read += buffer.size();
+    progress |= not buffer.empty();
+
+    if ( not progress and bytes_read < message.size() ) {
+      wait( from, bytes_written < message.size() ? writable( from ) : pollfd { -1, 0, 0 }, to, readable( to ) );
+    }
+  }
+}
+
+// Trade `round_trips` requests and responses of `message_size` bytes, one at a time, and so measure the
+// latency that the TCPPeer thread's handoffs (or their absence) add to each message.
+template<class Socket>
+void latency_test( fstream& debug_output,
+                   const string_view name,
+                   const size_t round_trips,  // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t message_size, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t random_seed )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+  cfg.isn = Wrap32 { static_cast<uint32_t>( random_seed ) };
+  auto [client_end, server_end] = LoopbackAdapter::make_pair();
+  Socket client { move( client_end ) }, server { move( server_end ) };
+  open( client, server, cfg );
+
+  const string request( message_size, 'q' );
+  const string response( message_size, 'r' );
+  string buffer;
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < round_trips; ++i ) {
+    send_message( client, server, request, buffer );
+    send_message( server, client, response, buffer );
+  }
+  const auto stop_time = steady_clock::now();
+
+  close( client, server );
+
+  const auto microseconds_per_round_trip
+    = duration_cast<duration<double, micro>>( stop_time - start_time ).count() / static_cast<double>( round_trips );
+
+  cout << name << " with message_size=" << message_size << " took " << fixed << setprecision( 1 )
+       << microseconds_per_round_trip << " us per round trip.\n";
+
+  debug_output << "  " << setw( 26 ) << name << " round trip: " << fixed << setprecision( 1 ) << setw( 6 )
+               << microseconds_per_round_trip << " us\n";
+
+  if ( microseconds_per_round_trip > 10'000 ) {
+    throw runtime_error( string { name } + " did not meet maximum latency of 10 ms per round trip" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test<LoopbackMinnowSocket>( debug_output, "TCPMinnowSocket", 2e8, 16384, 1234 );
+  speed_test<LoopbackMinnowRingSocket>( debug_output, "TCPMinnowRingSocket", 2e8, 16384, 1234 );
+  speed_test<LoopbackMinnowInlineSocket>( debug_output, "TCPMinnowInlineSocket", 2e8, 16384, 1234 );
+
+  latency_test<LoopbackMinnowSocket>( debug_output, "TCPMinnowSocket", 20000, 64, 1234 );
+  latency_test<LoopbackMinnowRingSocket>( debug_output, "TCPMinnowRingSocket", 20000, 64, 1234 );
+  latency_test<LoopbackMinnowInlineSocket>( debug_output, "TCPMinnowInlineSocket", 20000, 64, 1234 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
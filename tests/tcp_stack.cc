@@ -0,0 +1,184 @@
+#include "tcp_stack.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const Address client_address { "10.0.0.1", 0 };
+const Address server_address { "10.0.0.2", 80 };
+
+// Quick retransmissions, so a SYN ignored by a full accept queue is soon sent again
+TCPConfig quick_config()
+{
+  TCPConfig config;
+  config.rt_timeout = 10;
+  return config;
+}
+
+// Turn the loop until `done` (or give up after a few seconds)
+void run_until( EventLoop& loop, const function<bool()>& done )
+{
+  const uint64_t deadline = EventLoop::now_ms() + 5000;
+  while ( not done() and EventLoop::now_ms() < deadline ) {
+    loop.wait_next_event( 10 );
+  }
+}
+
+// Read everything waiting in a connection's inbound stream. Only using the streams marks a connection to be
+// pushed (which the loop does before it reads any segments), so look first through a const view.
+string read_all( LoopbackStack::Connection& conn )
+{
+  string data;
+  const LoopbackStack::Connection& view = conn;
+  if ( view.inbound_reader().bytes_buffered() > 0 ) {
+    read( conn.inbound_reader(), UINT64_MAX, data );
+  }
+  return data;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // connections between the same pair of addresses are told apart by port, and each one's bytes stay its own
+      auto [client_end, server_end] = LoopbackAdapter::make_pair();
+      LoopbackStack client { move( client_end ), quick_config() };
+      LoopbackStack server { move( server_end ), quick_config() };
+      EventLoop loop;
+      client.install( loop );
+      server.install( loop );
+      server.listen( server_address.port() );
+
+      constexpr size_t count = 8;
+      vector<LoopbackStack::ConnectionPtr> clients;
+      for ( size_t i = 0; i < count; ++i ) {
+        clients.push_back( client.connect( client_address, server_address ) );
+        clients.back()->outbound_writer().push( "request " + to_string( i ) + string( i * 500, '.' ) );
+        clients.back()->outbound_writer().close();
+      }
+
+      // the server echoes each connection's request back in reverse, once it has all of it
+      vector<pair<LoopbackStack::ConnectionPtr, string>> accepted;
+      size_t answered = 0;
+      run_until( loop, [&] {
+        while ( auto conn = server.accept( server_address.port() ) ) {
+          accepted.emplace_back( move( conn ), string {} );
+        }
+        for ( auto& [conn, request] : accepted ) {
+          request += read_all( *conn );
+          const LoopbackStack::Connection& view = *conn;
+          if ( view.inbound_reader().is_finished() and not view.outbound_writer().is_closed() ) {
+            conn->outbound_writer().push( { request.rbegin(), request.rend() } );
+            conn->outbound_writer().close();
+            ++answered;
+          }
+        }
+        return answered == count;
+      } );
+      test_should_be( accepted.size(), count );
+      test_should_be( answered, count ); // each request arrived whole
+      test_should_be( server.connection_count(), count );
+      test_should_be( client.connection_count(), count );
+
+      vector<string> replies( count );
+      run_until( loop, [&] {
+        bool all_finished = true;
+        for ( size_t i = 0; i < count; ++i ) {
+          replies[i] += read_all( *clients[i] );
+          const LoopbackStack::Connection& view = *clients[i];
+          all_finished = all_finished and view.inbound_reader().is_finished();
+        }
+        return all_finished;
+      } );
+      for ( size_t i = 0; i < count; ++i ) {
+        const string request = "request " + to_string( i ) + string( i * 500, '.' );
+        const string reply { request.rbegin(), request.rend() };
+        test_should_be( replies[i], reply );
+        test_should_be( clients[i]->established() and not clients[i]->failed(), true );
+      }
+    }
+
+    {
+      // SYNs are ignored while the accept queue is full, and the clients get in once there is room
+      auto [client_end, server_end] = LoopbackAdapter::make_pair();
+      LoopbackStack client { move( client_end ), quick_config() };
+      LoopbackStack server { move( server_end ), quick_config() };
+      EventLoop loop;
+      client.install( loop );
+      server.install( loop );
+      constexpr size_t backlog = 2;
+      server.listen( server_address.port(), backlog );
+
+      vector<LoopbackStack::ConnectionPtr> clients;
+      for ( size_t i = 0; i < backlog; ++i ) {
+        clients.push_back( client.connect( client_address, server_address ) );
+      }
+      run_until( loop, [&] { return server.accept_queue_size( server_address.port() ) == backlog; } );
+      for ( size_t i = 0; i < backlog; ++i ) {
+        clients.push_back( client.connect( client_address, server_address ) );
+      }
+      run_until( loop, [&] { return server.listener_stats( server_address.port() ).syns_dropped > 0; } );
+      test_should_be( server.accept_queue_size( server_address.port() ), backlog );
+      test_should_be( server.listener_stats( server_address.port() ).syns_dropped > 0, true );
+      test_should_be( server.listener_stats( server_address.port() ).syn_cookies_sent, uint64_t { 0 } );
+
+      vector<LoopbackStack::ConnectionPtr> accepted;
+      run_until( loop, [&] {
+        while ( auto conn = server.accept( server_address.port() ) ) {
+          accepted.push_back( move( conn ) );
+        }
+        return accepted.size() == clients.size();
+      } );
+      test_should_be( accepted.size(), clients.size() );
+      for ( const auto& conn : clients ) {
+        test_should_be( conn->established() and not conn->failed(), true );
+      }
+    }
+
+    {
+      // a SYN to a port nobody is listening on is answered with a RST that acknowledges it
+      auto [peer, server_end] = LoopbackAdapter::make_pair();
+      LoopbackStack server { move( server_end ) };
+      EventLoop loop;
+      server.install( loop );
+      server.listen( server_address.port() );
+
+      const FourTuple closed { client_address.ipv4_numeric(), 40000, server_address.ipv4_numeric(), 81 };
+      const Wrap32 isn { 12345 };
+      const TCPMessage syn { TCPSenderMessage { .seqno = isn, .SYN = true }, TCPReceiverMessage {} };
+      peer.write_batch( closed, span { &syn, 1 } );
+
+      vector<pair<FourTuple, TCPMessage>> replies;
+      run_until( loop, [&] {
+        for ( auto& reply : peer.read_any_batch( 16 ) ) {
+          replies.push_back( move( reply ) );
+        }
+        return not replies.empty();
+      } );
+      test_should_be( replies.size(), 1UL );
+      const auto& [tuple, reply] = replies.front();
+      test_should_be( tuple == closed.reversed(), true );
+      test_should_be( reply.sender->RST or reply.receiver->RST, true );
+      test_should_be( reply.sender->SYN, false );
+      test_should_be( reply.receiver->ackno == isn + 1, true ); // the RST acknowledges the SYN
+      test_should_be( server.connection_count(), 0UL );         // no state kept for a SYN to a closed port
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <type_traits>
 
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage))
@@ -77,6 +79,19 @@ inline std::string human_compare( const Wrap32& actual, const Wrap32& expected )
   return ss.str();
 }
 
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+inline std::string human_compare( std::string_view actual, std::string_view expected )
+{
+  size_t offset = 0;
+  while ( offset < actual.size() and offset < expected.size() and actual[offset] == expected[offset] ) {
+    ++offset;
+  }
+  std::ostringstream ss;
+  ss << "The strings first differ at byte " << offset << " (the actual string was " << actual.size()
+     << " bytes long, and the expected one " << expected.size() << " bytes).\n";
+  return ss.str();
+}
+
 template<typename T>
 static void test_should_be_helper( const T& actual,
                                    const T& expected,
@@ -90,7 +105,10 @@ static void test_should_be_helper( const T& actual,
        << ",\nbut was expected to equal `" << expected_s << "` (which evaluates to " << to_string( expected )
        << ").\n\n";
 
-    ss << "Difference: " << human_compare( actual, expected );
+    // a condition that should (or shouldn't) have held: the expression says everything there is to say
+    if constexpr ( not std::is_same_v<T, bool> ) {
+      ss << "Difference: " << human_compare( actual, expected );
+    }
 
     ss << "\n(at line " << lineno << ")\n";
     throw std::runtime_error( ss.str() );
@@ -0,0 +1,171 @@
+#include "exception.hh"
+#include "socket.hh"
+#include "tcp_stack_group.hh"
+#include "test_should_be.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <net/if.h>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A multi-queue device of the test's own, which goes away when its last queue is closed
+constexpr const char* devname = "minnow_mq";
+const Address device_address { "169.254.199.1", 0 };
+const Address server_address { "169.254.199.2", 7 };
+
+// Give the device its address (on a /24, so the kernel routes the rest of the subnet to it) and bring it up, as
+// scripts/tun.sh does
+void configure_device()
+{
+  const UDPSocket sock;
+  const Address netmask { "255.255.255.0", 0 };
+
+  ifreq req {};
+  strncpy( static_cast<char*>( req.ifr_name ), devname, IFNAMSIZ - 1 );
+  memcpy( &req.ifr_addr, device_address.raw(), sizeof( req.ifr_addr ) );
+  CheckSystemCall( "SIOCSIFADDR", ioctl( sock.fd_num(), SIOCSIFADDR, &req ) );
+  memcpy( &req.ifr_netmask, netmask.raw(), sizeof( req.ifr_netmask ) );
+  CheckSystemCall( "SIOCSIFNETMASK", ioctl( sock.fd_num(), SIOCSIFNETMASK, &req ) );
+  CheckSystemCall( "SIOCGIFFLAGS", ioctl( sock.fd_num(), SIOCGIFFLAGS, &req ) );
+  req.ifr_flags = static_cast<int16_t>( req.ifr_flags | IFF_UP );
+  CheckSystemCall( "SIOCSIFFLAGS", ioctl( sock.fd_num(), SIOCSIFFLAGS, &req ) );
+}
+
+// What one stack has accepted: the connections are only touched on the stack's own thread
+struct Worker
+{
+  vector<TCPOverIPv4Stack::ConnectionPtr> connections {};
+  atomic<size_t> accepted {};
+};
+
+// Accept new connections, and echo whatever has arrived on each
+void serve( TCPOverIPv4Stack& stack, Worker& worker )
+{
+  while ( auto conn = stack.accept( server_address.port() ) ) {
+    worker.connections.push_back( move( conn ) );
+    ++worker.accepted;
+  }
+  for ( const auto& conn : worker.connections ) {
+    const auto& view = *conn; // using the streams marks the connection to be pushed, so look first
+    if ( view.inbound_reader().bytes_buffered() > 0 ) {
+      string data;
+      read( conn->inbound_reader(), UINT64_MAX, data );
+      conn->outbound_writer().push( move( data ) );
+    }
+  }
+}
+
+// A kernel TCP connection to the stacks: send `request`, and return what comes back
+string round_trip( const string& request )
+{
+  TCPSocket sock;
+  const timeval timeout { 5, 0 }; // connect and read give up (and throw) after this long
+  for ( const int option : { SO_SNDTIMEO, SO_RCVTIMEO } ) {
+    CheckSystemCall( "setsockopt", setsockopt( sock.fd_num(), SOL_SOCKET, option, &timeout, sizeof( timeout ) ) );
+  }
+  sock.connect( server_address );
+  sock.write( request );
+
+  string reply;
+  while ( reply.size() < request.size() and not sock.eof() ) {
+    string buffer;
+    sock.read( buffer );
+    reply += buffer;
+  }
+  return reply;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    if ( geteuid() != 0 ) {
+      cerr << "Skipping: making a TUN device needs root.\n";
+      return EXIT_SUCCESS;
+    }
+
+    {
+      // flows from the kernel are spread over the queues, and each is served start to finish by one stack: the
+      // kernel steers a flow to the queue the stack answered its SYN on
+      constexpr size_t queues = 4;
+      constexpr size_t flows = 16;
+      vector<Worker> workers( queues ); // before the group, whose jobs use them
+      TCPStackGroup group { devname, queues, false, {}, false };
+      configure_device();
+
+      // every stack must be listening before the first SYN, or the stack it reaches answers with a RST
+      vector<promise<void>> listening( queues );
+      for ( size_t i = 0; i < queues; ++i ) {
+        group.post( i, [&started = listening[i]]( TCPOverIPv4Stack& stack, EventLoop& ) {
+          stack.listen( server_address.port() );
+          started.set_value();
+        } );
+      }
+      for ( auto& started : listening ) {
+        if ( started.get_future().wait_for( chrono::seconds( 5 ) ) != future_status::ready ) {
+          throw runtime_error( "a stack did not start listening" );
+        }
+      }
+
+      vector<string> requests;
+      vector<future<string>> replies;
+      for ( size_t i = 0; i < flows; ++i ) {
+        requests.push_back( "flow " + to_string( i ) + string( i * 100, '.' ) );
+        replies.push_back( async( launch::async, round_trip, requests.back() ) );
+      }
+
+      // the main thread reaches the stacks only through jobs
+      const uint64_t deadline = EventLoop::now_ms() + 10000;
+      for ( auto& reply : replies ) {
+        while ( reply.wait_for( chrono::milliseconds( 5 ) ) != future_status::ready ) {
+          if ( EventLoop::now_ms() >= deadline ) {
+            throw runtime_error( "the flows did not finish" );
+          }
+          for ( size_t i = 0; i < queues; ++i ) {
+            group.post( i, [&worker = workers[i]]( TCPOverIPv4Stack& stack, EventLoop& ) {
+              serve( stack, worker );
+            } );
+          }
+        }
+      }
+
+      for ( size_t i = 0; i < flows; ++i ) {
+        const string reply = replies[i].get();
+        test_should_be( reply, requests[i] );
+      }
+
+      size_t accepted = 0;
+      size_t queues_used = 0;
+      for ( const auto& worker : workers ) {
+        accepted += worker.accepted;
+        queues_used += worker.accepted > 0 ? 1 : 0;
+      }
+      test_should_be( accepted, flows );
+      test_should_be( queues_used > 1, true );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+#include "checksum.hh"
+#include "helpers.hh"
+#include "tcp_over_ip.hh"
+#include "test_should_be.hh"
+#include "tun.hh"
+#include "tuntap_adapter.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const FourTuple connection { 0x0a000001, 40000, 0x0a000002, 80 };
+
+// A segment carrying `size` bytes starting at `seqno`, with the same acknowledgment as every other one
+TCPMessage segment( const uint32_t seqno, const size_t size, const char fill = 'x' )
+{
+  return { TCPSenderMessage { .seqno = Wrap32 { seqno }, .payload = string( size, fill ) },
+           TCPReceiverMessage { .ackno = Wrap32 { 0x01234567 }, .window_size = 1000 } };
+}
+
+bool extends( const vector<TCPMessage>& run, const TCPMessage& next )
+{
+  return TCPOverIPv4Adapter::extends_tcp_run( run, next );
+}
+
+// The longest run of `size`-byte segments that extends_tcp_run builds
+size_t longest_run( const size_t size )
+{
+  vector<TCPMessage> run { segment( 0, size ) };
+  while ( extends( run, segment( run.size() * size, size ) ) ) {
+    run.push_back( segment( run.size() * size, size ) );
+  }
+  return run.size();
+}
+
+// Finish the TCP checksum of a serialized datagram as the kernel does for a virtio-net header with F_NEEDS_CSUM:
+// sum from csum_start to the end (starting from the partial checksum already there), and store the result
+string finish_checksum( string datagram )
+{
+  InternetChecksum check;
+  check.add( string_view { datagram }.substr( IPv4Header::LENGTH ) );
+  const uint16_t cksum = check.value();
+  datagram[IPv4Header::LENGTH + 16] = static_cast<char>( cksum >> 8 );
+  datagram[IPv4Header::LENGTH + 17] = static_cast<char>( cksum & 0xff );
+  return datagram;
+}
+
+VirtioNetHeader read_vnet_header( const string& buffer )
+{
+  VirtioNetHeader hdr {};
+  if ( buffer.size() != sizeof( hdr ) ) {
+    throw runtime_error( "virtio-net header of the wrong size" );
+  }
+  memcpy( &hdr, buffer.data(), sizeof( hdr ) );
+  return hdr;
+}
+
+// Buffers shaped like those the TUN adapter reads into (with a virtio-net header if `vnet_hdr`), holding
+// `contents` as readv would leave it, after a longer datagram read earlier
+vector<string> read_into_buffers( const string_view contents, const bool vnet_hdr )
+{
+  vector<string> buffers;
+  if ( vnet_hdr ) {
+    buffers.emplace_back( sizeof( VirtioNetHeader ), 'z' );
+  }
+  buffers.emplace_back( IPv4Header::LENGTH, 'z' );
+  buffers.emplace_back( TCPSegment::HEADER_LENGTH, 'z' );
+  buffers.emplace_back( UINT16_MAX, 'z' );
+
+  size_t offset = 0;
+  for ( auto& buf : buffers ) {
+    const size_t chunk = min( buf.size(), contents.size() - offset );
+    buf.replace( 0, chunk, contents.substr( offset, chunk ) );
+    offset += chunk;
+  }
+  return buffers;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // a run continues only where the previous payload finished
+      const vector<TCPMessage> run { segment( 1000, 100 ) };
+      test_should_be( extends( run, segment( 1100, 100 ) ), true );
+      test_should_be( extends( run, segment( 1101, 100 ) ), false );
+      test_should_be( extends( run, segment( 1099, 100 ) ), false );
+      test_should_be( extends( run, segment( 1100, 0 ) ), false );
+
+      // every segment but the last is the size of the first
+      test_should_be( extends( run, segment( 1100, 50 ) ), true );
+      test_should_be( extends( run, segment( 1100, 101 ) ), false );
+      const vector<TCPMessage> short_last { segment( 1000, 100 ), segment( 1100, 50 ) };
+      test_should_be( extends( short_last, segment( 1150, 50 ) ), false );
+
+      // with the same acknowledgment and window
+      TCPMessage other_ack = segment( 1100, 100 );
+      other_ack.receiver->ackno = Wrap32 { 0x01234568 };
+      test_should_be( extends( run, other_ack ), false );
+      TCPMessage other_window = segment( 1100, 100 );
+      other_window.receiver->window_size = 999;
+      test_should_be( extends( run, other_window ), false );
+    }
+
+    {
+      // a SYN or RST travels alone, and a FIN may only finish a run
+      vector<TCPMessage> syn_run { segment( 1000, 100 ) };
+      syn_run.front().sender->SYN = true;
+      test_should_be( extends( syn_run, segment( 1101, 100 ) ), false );
+
+      const vector<TCPMessage> run { segment( 1000, 100 ) };
+      TCPMessage syn = segment( 1100, 100 );
+      syn.sender->SYN = true;
+      test_should_be( extends( run, syn ), false );
+      TCPMessage rst = segment( 1100, 100 );
+      rst.sender->RST = true;
+      test_should_be( extends( run, rst ), false );
+      TCPMessage fin = segment( 1100, 100 );
+      fin.sender->FIN = true;
+      test_should_be( extends( run, fin ), true );
+
+      vector<TCPMessage> fin_run { segment( 1000, 100 ) };
+      fin_run.back().sender->FIN = true;
+      test_should_be( extends( fin_run, segment( 1101, 100 ) ), false );
+    }
+
+    {
+      // a run fills at most one IPv4 datagram: 40 bytes of headers and up to 65,495 of payload
+      test_should_be( longest_run( 1460 ), 44UL );
+      test_should_be( longest_run( 13099 ), 5UL ); // exactly 65,535 bytes
+      test_should_be( longest_run( 13100 ), 4UL );
+      test_should_be( longest_run( 40000 ), 1UL );
+    }
+
+    {
+      // a run is one datagram from the first segment's seqno, carrying every payload and the last one's FIN
+      vector<TCPMessage> run { segment( 5000, 1000, 'a' ), segment( 6000, 1000, 'b' ), segment( 7000, 400, 'c' ) };
+      run.back().sender->FIN = true;
+      const InternetDatagram ip_dgram = TCPOverIPv4Adapter::wrap_tcp_run_in_ip( connection, run );
+      test_should_be( ip_dgram.header.len, uint16_t { IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + 2400 } );
+      test_should_be( ip_dgram.header.src, connection.src_ip );
+      test_should_be( ip_dgram.header.dst, connection.dst_ip );
+
+      // once the kernel has finished its checksum, it parses (and checks) like any other datagram
+      const string datagram = finish_checksum( concat( serialize( ip_dgram ) ) );
+      InternetDatagram parsed;
+      test_should_be( parse( parsed, vector { datagram } ), true );
+      TCPSegment seg;
+      test_should_be( parse( seg, move( parsed.payload ), parsed.header.pseudo_checksum() ), true );
+      test_should_be( seg.udinfo.src_port, connection.src_port );
+      test_should_be( seg.udinfo.dst_port, connection.dst_port );
+      test_should_be( seg.message.sender->seqno, Wrap32 { 5000 } );
+      test_should_be( seg.message.sender->FIN, true );
+      test_should_be( seg.message.sender->payload, string( 1000, 'a' ) + string( 1000, 'b' ) + string( 400, 'c' ) );
+      test_should_be( seg.message.receiver->ackno.value(), Wrap32 { 0x01234567 } );
+    }
+
+    {
+      // finishing the partial checksum of a run of one gives the same datagram as checksumming it in full
+      const vector<TCPMessage> run { segment( 5000, 777 ) };
+      const string partial = concat( serialize( TCPOverIPv4Adapter::wrap_tcp_run_in_ip( connection, run ) ) );
+      const string full = concat( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( connection, run.front() ) ) );
+      test_should_be( finish_checksum( partial ), full );
+      test_should_be( partial == full, false ); // the partial checksum is not the full one
+    }
+
+    {
+      // a lone segment asks the kernel only to finish its checksum
+      const VirtioNetHeader one = read_vnet_header( TCPOverIPv4OverTunFdAdapter::make_vnet_header( 1, 1000 ) );
+      test_should_be( one.flags, VirtioNetHeader::F_NEEDS_CSUM );
+      test_should_be( one.gso_type, VirtioNetHeader::GSO_NONE );
+      test_should_be( one.gso_size, uint16_t { 0 } );
+      test_should_be( one.hdr_len, uint16_t { IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH } );
+      test_should_be( one.csum_start, uint16_t { IPv4Header::LENGTH } );
+      test_should_be( one.csum_offset, uint16_t { 16 } );
+
+      // a run of several, also to split it into segments the size of the first
+      const VirtioNetHeader many = read_vnet_header( TCPOverIPv4OverTunFdAdapter::make_vnet_header( 3, 1460 ) );
+      test_should_be( many.flags, VirtioNetHeader::F_NEEDS_CSUM );
+      test_should_be( many.gso_type, VirtioNetHeader::GSO_TCPV4 );
+      test_should_be( many.gso_size, uint16_t { 1460 } );
+      test_should_be( many.hdr_len, one.hdr_len );
+      test_should_be( many.csum_start, one.csum_start );
+      test_should_be( many.csum_offset, one.csum_offset );
+    }
+
+    {
+      // a datagram read into reused buffers is parsed up to its length, ignoring what an earlier one left behind
+      const InternetDatagram ip_dgram = TCPOverIPv4Adapter::wrap_tcp_in_ip( connection, segment( 0, 300 ) );
+      const string datagram = concat( serialize( ip_dgram ) );
+      const string tcp_bytes = datagram.substr( IPv4Header::LENGTH );
+
+      bool verify_checksum = false;
+      auto parsed = TCPOverIPv4OverTunFdAdapter::parse_buffers(
+        read_into_buffers( datagram, false ), datagram.size(), false, verify_checksum );
+      test_should_be( parsed.has_value(), true );
+      test_should_be( concat( parsed->payload ), tcp_bytes );
+      test_should_be( verify_checksum, true );
+
+      // after a virtio-net header, the TCP checksum is checked only if the kernel has neither checked it nor left
+      // it to be filled in
+      for ( const uint8_t flags :
+            { uint8_t { 0 }, VirtioNetHeader::F_NEEDS_CSUM, VirtioNetHeader::F_DATA_VALID } ) {
+        VirtioNetHeader hdr {};
+        hdr.flags = flags;
+        string contents( sizeof( hdr ), 0 );
+        memcpy( contents.data(), &hdr, sizeof( hdr ) );
+        contents += datagram;
+
+        verify_checksum = flags != 0;
+        parsed = TCPOverIPv4OverTunFdAdapter::parse_buffers(
+          read_into_buffers( contents, true ), contents.size(), true, verify_checksum );
+        test_should_be( parsed.has_value(), true );
+        test_should_be( concat( parsed->payload ), tcp_bytes );
+        test_should_be( verify_checksum, flags == 0 );
+      }
+
+      // a read too short for the virtio-net header, or for the IPv4 header, is not a datagram
+      const auto buffers = read_into_buffers( string( sizeof( VirtioNetHeader ), 0 ) + datagram, true );
+      for ( const size_t length : { sizeof( VirtioNetHeader ) - 1, sizeof( VirtioNetHeader ) + 10 } ) {
+        parsed = TCPOverIPv4OverTunFdAdapter::parse_buffers( buffers, length, true, verify_checksum );
+        test_should_be( parsed.has_value(), false );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
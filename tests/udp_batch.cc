@@ -0,0 +1,109 @@
+#include "socket.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+struct Link
+{
+  UDPSocket sender {};
+  UDPSocket receiver {};
+
+  Link()
+  {
+    sender.bind( Address { "127.0.0.1", 0 } );
+    receiver.bind( Address { "127.0.0.1", 0 } );
+  }
+};
+
+// Send the batch's datagrams, then receive them into `inbound` and check they arrived intact
+void send_and_receive( Link& link, DatagramBatch& outbound, DatagramBatch& inbound, const vector<string>& payloads )
+{
+  test_should_be( link.sender.send_batch( outbound ), payloads.size() );
+
+  size_t got = 0;
+  while ( got < payloads.size() ) {
+    link.receiver.recv_batch( inbound );
+    for ( size_t i = 0; i < inbound.size(); ++i, ++got ) {
+      test_should_be( string { inbound.payload( i ) }, payloads.at( got ) );
+      test_should_be( inbound.address( i ).to_string(), link.sender.local_address().to_string() );
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const vector<string> payloads { "minnow", "tcp" };
+
+    {
+      // batches small enough that their storage would fit in a std::string's own buffer, moved before use
+      Link link;
+      DatagramBatch outbound_original { 2, 7 }, inbound_original { 2, 7 };
+      DatagramBatch outbound { move( outbound_original ) };
+      DatagramBatch inbound;
+      inbound = move( inbound_original );
+      test_should_be( outbound.capacity(), 2UL );
+      test_should_be( inbound.capacity(), 2UL );
+
+      for ( const auto& payload : payloads ) {
+        test_should_be( outbound.push( link.receiver.local_address(), payload ), true );
+      }
+      test_should_be( outbound.push( link.receiver.local_address(), "x" ), false ); // the batch is full
+      send_and_receive( link, outbound, inbound, payloads );
+    }
+
+    {
+      // a batch moved after it has been filled keeps its datagrams
+      Link link;
+      DatagramBatch outbound { 2, 7 }, inbound { 2, 7 };
+      for ( const auto& payload : payloads ) {
+        outbound.push( link.receiver.local_address(), payload );
+      }
+      DatagramBatch moved { move( outbound ) };
+      test_should_be( moved.size(), 2UL );
+      test_should_be( string { moved.payload( 0 ) }, payloads[0] );
+      test_should_be( string { moved.payload( 1 ) }, payloads[1] );
+      send_and_receive( link, moved, inbound, payloads );
+
+      // ... and so does a batch moved after receiving
+      DatagramBatch received { move( inbound ) };
+      test_should_be( received.size(), 2UL );
+      test_should_be( string { received.payload( 0 ) }, payloads[0] );
+      test_should_be( string { received.payload( 1 ) }, payloads[1] );
+
+      // reuse, after clear()
+      moved.clear();
+      moved.push( link.receiver.local_address(), "again" );
+      send_and_receive( link, moved, received, { "again" } );
+    }
+
+    {
+      // an oversized datagram is refused
+      DatagramBatch batch { 1, 4 };
+      bool threw = false;
+      try {
+        batch.push( Address { "127.0.0.1", 9 }, "too long" );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      test_should_be( threw, true );
+      test_should_be( batch.empty(), true );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
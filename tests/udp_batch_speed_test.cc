@@ -0,0 +1,118 @@
+#include "socket.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Send `count` datagrams of `datagram_size` bytes over loopback, `burst` at a time, and receive each burst before
+// sending the next (so the receive buffer never overflows). With burst=1 this uses sendto() and recv(), one
+// system call per datagram; otherwise it uses DatagramBatch with sendmmsg and recvmmsg.
+void speed_test( fstream& debug_output,
+                 const size_t count,         // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t datagram_size, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t burst )        // NOLINT(bugprone-easily-swappable-parameters)
+{
+  UDPSocket sender, receiver;
+  sender.bind( Address { "127.0.0.1", 0 } );
+  receiver.bind( Address { "127.0.0.1", 0 } );
+  receiver.set_blocking( false );
+  const Address destination = receiver.local_address();
+  const Address source = sender.local_address();
+
+  DatagramBatch outbound { burst, datagram_size }, inbound { burst, datagram_size };
+  string payload( datagram_size, 'x' );
+  string received;
+  Address received_from { "0", 0 };
+
+  size_t sent = 0, received_count = 0;
+  const auto start_time = steady_clock::now();
+  while ( sent < count ) {
+    const size_t n = min( burst, count - sent );
+
+    if ( burst == 1 ) {
+      payload.front() = static_cast<char>( sent );
+      sender.sendto( destination, payload );
+    } else {
+      outbound.clear();
+      for ( size_t i = 0; i < n; ++i ) {
+        payload.front() = static_cast<char>( sent + i );
+        outbound.push( destination, payload );
+      }
+      if ( sender.send_batch( outbound ) != n ) {
+        throw runtime_error( "sendmmsg did not send the whole burst" );
+      }
+    }
+
+    for ( size_t got = 0; got < n; ) {
+      if ( burst == 1 ) {
+        receiver.recv( received_from, received );
+        if ( received.empty() ) {
+          continue;
+        }
+        if ( received.size() != datagram_size or received.front() != static_cast<char>( sent + got )
+             or received_from != source ) {
+          throw runtime_error( "Mismatch between datagram sent and received" );
+        }
+        ++got;
+        continue;
+      }
+
+      receiver.recv_batch( inbound );
+      for ( size_t i = 0; i < inbound.size(); ++i ) {
+        if ( inbound.payload( i ).size() != datagram_size
+             or inbound.payload( i ).front() != static_cast<char>( sent + got ) or inbound.address( i ) != source ) {
+          throw runtime_error( "Mismatch between datagram sent and received" );
+        }
+        ++got;
+      }
+    }
+
+    sent += n;
+    received_count += n;
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( received_count != count ) {
+    throw runtime_error( "Wrong number of datagrams received" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto datagrams_per_second = static_cast<double>( count ) / test_duration.count();
+
+  cout << "UDP loopback with datagram_size=" << datagram_size << ", burst=" << burst << " reached " << fixed
+       << setprecision( 0 ) << datagrams_per_second << " datagrams/s (sent and received).\n";
+
+  debug_output << "            UDP loopback datagram rate (burst " << setw( 2 ) << burst << "): " << fixed
+               << setprecision( 2 ) << setw( 5 ) << datagrams_per_second / 1e6 << " Mpps\n";
+
+  if ( datagrams_per_second < 1e5 ) {
+    throw runtime_error( "UDP loopback did not meet minimum speed of 100,000 datagrams/s" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, 2'000'000, 64, 64 );
+  speed_test( debug_output, 500'000, 64, 1 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include "buffer_pool.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <new>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t min_buffer_exponent = countr_zero( BufferPool::MIN_BUFFER_SIZE );
+constexpr size_t max_buffer_exponent = countr_zero( BufferPool::MAX_BUFFER_SIZE );
+constexpr size_t buffer_class_count = max_buffer_exponent - min_buffer_exponent + 1;
+constexpr size_t kept_bytes_per_class = 2 << 20; // keep up to 2 MiB of free buffers of each size...
+constexpr size_t max_kept_buffers = 4096;        // ... but no more than this many
+
+constexpr size_t list_capacity = 4; // a list usually holds a header or two and a payload
+constexpr size_t max_kept_lists = 1024;
+
+constexpr size_t block_alignment = alignof( max_align_t );
+constexpr size_t block_class_count = BufferPool::MAX_BLOCK_SIZE / block_alignment;
+constexpr size_t max_kept_blocks = 4096;
+
+static_assert( has_single_bit( BufferPool::MIN_BUFFER_SIZE ) and has_single_bit( BufferPool::MAX_BUFFER_SIZE ) );
+static_assert( BufferPool::MAX_BLOCK_SIZE % block_alignment == 0 );
+
+// The size class that holds buffers of at least `capacity` bytes
+size_t class_to_hold( const size_t capacity )
+{
+  return bit_width( max( capacity, BufferPool::MIN_BUFFER_SIZE ) - 1 ) - min_buffer_exponent;
+}
+
+constexpr size_t class_size( const size_t size_class )
+{
+  return BufferPool::MIN_BUFFER_SIZE << size_class;
+}
+
+// A free block holds the link to the next one
+struct FreeBlock
+{
+  FreeBlock* next;
+};
+
+struct BlockList
+{
+  FreeBlock* head {};
+  size_t count {};
+};
+
+struct LocalPool
+{
+  array<vector<string>, buffer_class_count> buffers {};
+  vector<vector<Ref<string>>> lists {};
+  array<BlockList, block_class_count> blocks {};
+
+  LocalPool() = default;
+  LocalPool( const LocalPool& other ) = delete;
+  LocalPool& operator=( const LocalPool& other ) = delete;
+
+  void trim()
+  {
+    for ( auto& free_buffers : buffers ) {
+      vector<string> {}.swap( free_buffers );
+    }
+    vector<vector<Ref<string>>> {}.swap( lists );
+    for ( auto& list : blocks ) {
+      while ( list.head ) {
+        ::operator delete( exchange( list.head, list.head->next ) );
+      }
+      list.count = 0;
+    }
+  }
+
+  ~LocalPool();
+};
+
+// Set once the thread's pool has been destroyed at thread exit. (A trivial type, so it is never destroyed itself,
+// and buffers released by the destructors of other thread-local or static objects after that are just freed.)
+thread_local bool local_pool_destroyed = false;
+
+LocalPool::~LocalPool()
+{
+  trim();
+  local_pool_destroyed = true;
+}
+
+LocalPool* local_pool()
+{
+  if ( local_pool_destroyed ) {
+    return nullptr;
+  }
+  thread_local LocalPool pool;
+  return &pool;
+}
+
+} // namespace
+
+string BufferPool::acquire( const size_t capacity )
+{
+  string ret;
+  if ( capacity > MAX_BUFFER_SIZE ) {
+    ret.reserve( capacity );
+    return ret;
+  }
+
+  const size_t size_class = class_to_hold( capacity );
+  LocalPool* pool = local_pool();
+  if ( pool and not pool->buffers[size_class].empty() ) {
+    ret = move( pool->buffers[size_class].back() );
+    pool->buffers[size_class].pop_back();
+  } else {
+    ret.reserve( class_size( size_class ) );
+  }
+  return ret;
+}
+
+void BufferPool::release( string&& buffer )
+{
+  const size_t capacity = buffer.capacity();
+  if ( capacity < MIN_BUFFER_SIZE or capacity >= 2 * MAX_BUFFER_SIZE ) {
+    return;
+  }
+
+  // a buffer from elsewhere goes in the biggest class it can serve
+  const size_t size_class = min<size_t>( bit_width( capacity ) - 1, max_buffer_exponent ) - min_buffer_exponent;
+  LocalPool* pool = local_pool();
+  if ( not pool ) {
+    return;
+  }
+  auto& free_buffers = pool->buffers[size_class];
+  if ( free_buffers.size() < min( max_kept_buffers, kept_bytes_per_class / class_size( size_class ) ) ) {
+    buffer.clear();
+    free_buffers.push_back( move( buffer ) );
+  }
+}
+
+void BufferPool::reserve( string& buffer, const size_t capacity )
+{
+  if ( buffer.capacity() >= capacity ) {
+    return;
+  }
+  string bigger = acquire( max( capacity, 2 * buffer.capacity() ) );
+  bigger.append( buffer );
+  release( exchange( buffer, move( bigger ) ) );
+}
+
+vector<Ref<string>> BufferPool::acquire_list()
+{
+  LocalPool* pool = local_pool();
+  if ( pool and not pool->lists.empty() ) {
+    auto ret = move( pool->lists.back() );
+    pool->lists.pop_back();
+    return ret;
+  }
+
+  vector<Ref<string>> ret;
+  ret.reserve( list_capacity );
+  return ret;
+}
+
+void BufferPool::release( vector<Ref<string>>&& buffers )
+{
+  for ( auto& buffer : buffers ) {
+    if ( buffer.is_owned() ) {
+      release( buffer.release() );
+    }
+  }
+  buffers.clear();
+
+  LocalPool* pool = local_pool();
+  if ( pool and buffers.capacity() > 0 and pool->lists.size() < max_kept_lists ) {
+    pool->lists.push_back( move( buffers ) );
+  }
+}
+
+void* BufferPool::allocate_block( const size_t size )
+{
+  LocalPool* pool = local_pool();
+  if ( size > MAX_BLOCK_SIZE or not pool ) {
+    return ::operator new( size );
+  }
+
+  const size_t size_class = ( max<size_t>( size, 1 ) - 1 ) / block_alignment;
+  auto& list = pool->blocks[size_class];
+  if ( not list.head ) {
+    return ::operator new( ( size_class + 1 ) * block_alignment );
+  }
+  --list.count;
+  return exchange( list.head, list.head->next );
+}
+
+void BufferPool::deallocate_block( void* block, const size_t size ) noexcept
+{
+  LocalPool* pool = local_pool();
+  if ( size > MAX_BLOCK_SIZE or not pool ) {
+    ::operator delete( block );
+    return;
+  }
+
+  auto& list = pool->blocks[( max<size_t>( size, 1 ) - 1 ) / block_alignment];
+  if ( list.count >= max_kept_blocks ) {
+    ::operator delete( block );
+    return;
+  }
+  list.head = new ( block ) FreeBlock { list.head };
+  ++list.count;
+}
+
+void BufferPool::trim()
+{
+  if ( LocalPool* pool = local_pool() ) {
+    pool->trim();
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ref.hh"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//! \brief A per-thread pool of the buffers that segments, datagrams and frames are made of
+//! \details Buffers are strings whose capacity is a power of two from MIN_BUFFER_SIZE to MAX_BUFFER_SIZE; a
+//! datagram of a 1500-byte MTU fits in one SLAB_SIZE buffer. A released buffer goes on its thread's free list
+//! for its size, and the next acquire() of that size takes it back, so once the lists are warm a steady flow of
+//! packets makes no calls to the heap. A buffer may be released on a different thread than acquired it.
+//!
+//! The pool also keeps lists of buffers (for Serializer, Parser and datagram payloads), and fixed-size blocks
+//! for the nodes of containers on the packet path (see PoolAllocator).
+//!
+//! Nothing is returned to the pool automatically: a buffer that is destroyed instead of released is freed as
+//! usual, and its replacement comes from the heap.
+class BufferPool
+{
+public:
+  static constexpr size_t MIN_BUFFER_SIZE = 64;    //!< Smallest size class (e.g. for headers)
+  static constexpr size_t SLAB_SIZE = 2048;        //!< Size class of an MTU-sized datagram or frame
+  static constexpr size_t MAX_BUFFER_SIZE = 65536; //!< Largest size class; bigger buffers aren't kept
+  static constexpr size_t MAX_BLOCK_SIZE = 256;    //!< Largest block handed out by allocate_block
+
+  //! An empty string with room for at least `capacity` bytes
+  static std::string acquire( size_t capacity = SLAB_SIZE );
+
+  //! Give back a buffer whose contents are no longer needed (one too small or too big is just freed)
+  static void release( std::string&& buffer );
+
+  //! Make room for at least `capacity` bytes in `buffer`, moving it to a bigger buffer from the pool if needed
+  static void reserve( std::string& buffer, size_t capacity );
+
+  //! An empty list of buffers
+  static std::vector<Ref<std::string>> acquire_list();
+
+  //! Give back a list of buffers, and each buffer it owns
+  static void release( std::vector<Ref<std::string>>&& buffers );
+
+  //! \name
+  //! Raw blocks of up to MAX_BLOCK_SIZE bytes (bigger ones come from the heap), aligned like operator new's
+
+  //!@{
+  static void* allocate_block( size_t size );
+  static void deallocate_block( void* block, size_t size ) noexcept;
+  //!@}
+
+  //! Free everything this thread's pool is keeping (e.g. before measuring how much memory something else uses)
+  static void trim();
+};
+
+//! An allocator for containers on the packet path (e.g. the nodes of a std::map), drawing on BufferPool's blocks
+template<typename T>
+class PoolAllocator
+{
+  static_assert( alignof( T ) <= alignof( std::max_align_t ) );
+
+public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+
+  template<typename U>
+  PoolAllocator( const PoolAllocator<U>& /*unused*/ ) noexcept // NOLINT(*-explicit-*)
+  {}
+
+  T* allocate( size_t n ) { return static_cast<T*>( BufferPool::allocate_block( n * sizeof( T ) ) ); }
+  void deallocate( T* p, size_t n ) noexcept { BufferPool::deallocate_block( p, n * sizeof( T ) ); }
+
+  template<typename U>
+  bool operator==( const PoolAllocator<U>& /*unused*/ ) const noexcept
+  {
+    return true;
+  }
+};
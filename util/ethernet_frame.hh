@@ -3,6 +3,8 @@
 #include "ethernet_header.hh"
 #include "parser.hh"
 
+#include <string>
+#include <string_view>
 #include <vector>
 
 struct EthernetFrame
@@ -22,3 +24,31 @@ struct EthernetFrame
     serializer.buffer( payload );
   }
 };
+
+// An Ethernet frame parsed in place: the payload still points into the buffer it was received in
+// (e.g. a PacketRing's RX ring), so it is only valid as long as that buffer is
+struct EthernetFrameView
+{
+  EthernetHeader header {};
+  std::string_view payload {};
+
+  // Returns false if the frame is too short to have a header
+  bool parse( std::string_view frame )
+  {
+    if ( not header.parse( frame ) ) {
+      return false;
+    }
+    payload = frame.substr( EthernetHeader::LENGTH );
+    return true;
+  }
+
+  // Copy the payload out, for a consumer that keeps the frame (e.g. NetworkInterface::recv_frame)
+  EthernetFrame to_frame() const
+  {
+    EthernetFrame frame { header, {} };
+    if ( not payload.empty() ) {
+      frame.payload.emplace_back( std::string { payload } );
+    }
+    return frame;
+  }
+};
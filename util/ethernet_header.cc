@@ -41,20 +41,38 @@ string EthernetHeader::to_string() const
   return ss.str();
 }
 
-void EthernetHeader::parse( Parser& parser )
+namespace {
+// Read the header's fields, with a Parser or (when they are known to be in one buffer) a ContiguousParser
+void read_fields( EthernetHeader& h, auto& header )
 {
   // read destination address
-  for ( auto& b : dst ) {
-    parser.integer( b );
+  for ( auto& b : h.dst ) {
+    header.integer( b );
   }
 
   // read source address
-  for ( auto& b : src ) {
-    parser.integer( b );
+  for ( auto& b : h.src ) {
+    header.integer( b );
   }
 
   // read frame type (e.g. IPv4, ARP, or something else)
-  parser.integer( type );
+  header.integer( h.type );
+}
+} // namespace
+
+void EthernetHeader::parse( Parser& parser )
+{
+  parser.fixed( LENGTH, [&]( auto& header ) { read_fields( *this, header ); } );
+}
+
+bool EthernetHeader::parse( const string_view frame )
+{
+  if ( frame.size() < LENGTH ) {
+    return false;
+  }
+  ContiguousParser header { frame.substr( 0, LENGTH ) };
+  read_fields( *this, header );
+  return not header.has_error();
 }
 
 void EthernetHeader::serialize( Serializer& serializer ) const
@@ -5,6 +5,7 @@
 #include <array>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 // Helper type for an Ethernet address (an array of six bytes)
 using EthernetAddress = std::array<uint8_t, 6>;
@@ -30,5 +31,9 @@ struct EthernetHeader
   std::string to_string() const;
 
   void parse( Parser& parser );
+
+  //! Read the header from the front of a contiguous frame (e.g. one still in a PacketRing), without a Parser
+  //! \returns false if `frame` is shorter than a header
+  bool parse( std::string_view frame );
   void serialize( Serializer& serializer ) const;
 };
@@ -0,0 +1,59 @@
+#include "eventfd.hh"
+#include "exception.hh"
+
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor( ::CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ) {}
+
+void EventFD::notify()
+{
+  const uint64_t one = 1;
+  CheckSystemCall( "write", ::write( fd_num(), &one, sizeof( one ) ) );
+  register_write();
+}
+
+uint64_t EventFD::drain()
+{
+  uint64_t value = 0;
+  const ssize_t bytes_read = CheckSystemCall( "read", ::read( fd_num(), &value, sizeof( value ) ) );
+  register_read();
+  return bytes_read == sizeof( value ) ? value : 0;
+}
+
+// The fences pair up as in Dekker's algorithm: either the waiting thread's check for work (after arm) sees
+// the work, or the ringing thread (after making the work) sees the doorbell armed.
+void Doorbell::arm()
+{
+  State expected = State::Idle;
+  state_.compare_exchange_strong( expected, State::Armed, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+}
+
+void Doorbell::ring()
+{
+  atomic_thread_fence( memory_order_seq_cst );
+  State expected = State::Armed;
+  if ( state_.compare_exchange_strong( expected, State::Ringing, memory_order_relaxed ) ) {
+    fd_.notify();
+    state_.store( State::Rung, memory_order_release );
+  }
+}
+
+// The eventfd is readable only in the Ringing and Rung states, so waiting out a ring() in progress means that
+// whenever it is readable here, it gets drained (as an EventLoop rule on it requires).
+void Doorbell::clear()
+{
+  State state = state_.load( memory_order_acquire );
+  while ( state == State::Ringing ) {
+    this_thread::yield();
+    state = state_.load( memory_order_acquire );
+  }
+  if ( state == State::Rung ) {
+    fd_.drain();
+    state_.store( State::Idle, memory_order_relaxed );
+  }
+}
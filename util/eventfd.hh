@@ -0,0 +1,54 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <atomic>
+#include <cstdint>
+
+//! A FileDescriptor to a Linux [eventfd](\ref man2::eventfd) counter, used to wake up an EventLoop
+class EventFD : public FileDescriptor
+{
+public:
+  //! Create a new, non-blocking eventfd with a counter of zero
+  EventFD();
+
+  //! Add one to the counter, making the eventfd readable
+  void notify();
+
+  //! Reset the counter to zero
+  //! \returns the counter's value before it was reset (zero if it was not readable)
+  uint64_t drain();
+};
+
+//! \brief An EventFD that one thread rings to wake another, making a system call only if the other is waiting
+//! \details The waiting thread arm()s the doorbell when it runs out of work, then checks once more for work
+//! before it sleeps on fd(). The other thread calls ring() after making work, which notifies the eventfd only
+//! if the doorbell was armed. The waiting thread calls clear() when it wakes, which drains the eventfd if it
+//! was rung. While both threads are busy, neither makes a system call.
+class Doorbell
+{
+public:
+  //! (Waiting thread) Ask to be woken by the next ring(). Does nothing if a ring is already pending.
+  void arm();
+
+  //! (Other thread) Wake the waiting thread, if it armed the doorbell
+  void ring();
+
+  //! (Waiting thread) Drain the eventfd, if a ring() notified it
+  void clear();
+
+  //! Readable when a ring() is pending
+  EventFD& fd() { return fd_; }
+
+private:
+  enum class State : uint8_t
+  {
+    Idle,
+    Armed,
+    Ringing, //!< ring() is between claiming the doorbell and notifying the eventfd
+    Rung
+  };
+
+  EventFD fd_ {};
+  std::atomic<State> state_ { State::Idle };
+};
@@ -1,12 +1,92 @@
 #include "eventloop.hh"
 #include "exception.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <sys/socket.h>
 
 using namespace std;
 
+namespace {
+uint64_t timestamp_ns()
+{
+  static_assert( is_same_v<chrono::steady_clock::duration, chrono::nanoseconds> );
+
+  return chrono::steady_clock::now().time_since_epoch().count();
+}
+} // namespace
+
+EventLoop::EventLoop() : _collect_statistics( getenv( "MINNOW_EVENTLOOP_STATS" ) != nullptr )
+{
+  _rule_categories.reserve( 64 );
+}
+
+EventLoop::~EventLoop()
+{
+  if ( _collect_statistics ) {
+    summary( cerr );
+  }
+}
+
+bool EventLoop::interested( const BasicRule& rule )
+{
+  if ( not _collect_statistics ) {
+    return rule.interest();
+  }
+
+  const uint64_t start = timestamp_ns();
+  const bool ret = rule.interest();
+  _rule_categories.at( rule.category_id ).stats.interest_ns += timestamp_ns() - start;
+  return ret;
+}
+
+void EventLoop::fire( const BasicRule& rule )
+{
+  _progress = true;
+  if ( not _collect_statistics ) {
+    rule.callback();
+    return;
+  }
+
+  const uint64_t start = timestamp_ns();
+  rule.callback();
+  const uint64_t elapsed = timestamp_ns() - start;
+
+  auto& stats = _rule_categories.at( rule.category_id ).stats;
+  ++stats.fires;
+  stats.callback_ns += elapsed;
+  stats.max_callback_ns = max( stats.max_callback_ns, elapsed );
+}
+
+void EventLoop::summary( ostream& out ) const
+{
+  constexpr double ns_per_ms = 1e6;
+  constexpr double ns_per_us = 1e3;
+
+  const auto flags = out.flags();
+  out << "EventLoop summary: " << _polls << " polls, " << fixed << setprecision( 2 )
+      << static_cast<double>( _poll_ns ) / ns_per_ms << " ms blocked in poll\n";
+  out << "  " << left << setw( 48 ) << "category" << right << setw( 10 ) << "fires" << setw( 14 ) << "callback ms"
+      << setw( 12 ) << "mean us" << setw( 12 ) << "max us" << setw( 14 ) << "interest ms" << setw( 10 ) << "deferred"
+      << setw( 14 ) << "max wait us" << "\n";
+
+  for ( const auto& category : _rule_categories ) {
+    const auto& stats = category.stats;
+    const double mean_us
+      = stats.fires ? static_cast<double>( stats.callback_ns ) / static_cast<double>( stats.fires ) / ns_per_us : 0;
+    out << "  " << left << setw( 48 ) << category.name.substr( 0, 47 ) << right << setw( 10 ) << stats.fires
+        << setw( 14 ) << static_cast<double>( stats.callback_ns ) / ns_per_ms << setw( 12 ) << mean_us << setw( 12 )
+        << static_cast<double>( stats.max_callback_ns ) / ns_per_us << setw( 14 )
+        << static_cast<double>( stats.interest_ns ) / ns_per_ms << setw( 10 ) << stats.deferrals << setw( 14 )
+        << static_cast<double>( stats.max_ready_wait_ns ) / ns_per_us << "\n";
+  }
+  out.flags( flags );
+}
+
 unsigned int EventLoop::FDRule::service_count() const
 {
   return direction == Direction::In ? fd.read_count() : fd.write_count();
@@ -69,6 +149,61 @@ EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
   return RuleHandle { _non_fd_rules.back() };
 }
 
+uint64_t EventLoop::now_ms()
+{
+  return timestamp_ns() / 1000000;
+}
+
+void EventLoop::run_when_ready( FileDescriptor& fd, const Direction direction, CallbackT callback )
+{
+  _fd_waiters.push_back( { fd.duplicate(), direction, move( callback ) } );
+}
+
+void EventLoop::run_after( const uint64_t delay_ms, CallbackT callback )
+{
+  _timers.emplace( now_ms() + delay_ms, move( callback ) );
+}
+
+void EventLoop::run_when( InterestT condition, CallbackT callback )
+{
+  _condition_waiters.push_back( { move( condition ), move( callback ) } );
+  _progress = true; // make sure the new condition is checked at least once
+}
+
+bool EventLoop::run_timers_and_conditions()
+{
+  bool fired = false;
+
+  const uint64_t now = now_ms();
+  while ( not _timers.empty() and _timers.begin()->first <= now ) {
+    // remove the timer before running it, since the callback may add more
+    const CallbackT callback = move( _timers.begin()->second );
+    _timers.erase( _timers.begin() );
+    callback();
+    fired = true;
+  }
+
+  // each satisfied condition can make others true, so keep going until a pass fires nothing
+  while ( _progress or fired ) {
+    _progress = fired = false;
+    for ( auto it = _condition_waiters.begin(); it != _condition_waiters.end(); ) {
+      if ( it->condition() ) {
+        const CallbackT callback = move( it->callback );
+        it = _condition_waiters.erase( it );
+        callback();
+        fired = true;
+      } else {
+        ++it;
+      }
+    }
+    if ( fired ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void EventLoop::RuleHandle::cancel()
 {
   const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
@@ -77,11 +212,52 @@ void EventLoop::RuleHandle::cancel()
   }
 }
 
+void EventLoop::RuleHandle::set_priority( const Priority priority )
+{
+  const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
+  if ( rule_shared_ptr ) {
+    rule_shared_ptr->priority = priority;
+  }
+}
+
+void EventLoop::sort_rules_by_priority()
+{
+  const auto by_priority = []( const auto& a, const auto& b ) { return a->priority < b->priority; };
+
+  // list::sort is stable, and priorities rarely change, so check first
+  if ( not is_sorted( _fd_rules.begin(), _fd_rules.end(), by_priority ) ) {
+    _fd_rules.sort( by_priority );
+  }
+  if ( not is_sorted( _non_fd_rules.begin(), _non_fd_rules.end(), by_priority ) ) {
+    _non_fd_rules.sort( by_priority );
+  }
+}
+
+void EventLoop::RuleHandle::set_drain_budget( const unsigned budget )
+{
+  if ( budget == 0 ) {
+    throw runtime_error( "drain budget must be at least 1" );
+  }
+
+  const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
+  if ( rule_shared_ptr ) {
+    rule_shared_ptr->drain_budget = budget;
+  }
+}
+
 // NOLINTBEGIN(*-cognitive-complexity)
 // NOLINTBEGIN(*-signed-bitwise)
 EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 {
-  // first, handle the non-file-descriptor-related rules
+  // first, one-shot timers and conditions
+  if ( run_timers_and_conditions() ) {
+    return Result::Success;
+  }
+
+  // rules are considered (and, when several are ready, served) in priority order
+  sort_rules_by_priority();
+
+  // then the non-file-descriptor-related rules
   {
     for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
       auto& this_rule = **it;
@@ -93,7 +269,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       }
 
       uint8_t iterations = 0;
-      while ( this_rule.interest() ) {
+      while ( interested( this_rule ) ) {
         if ( iterations++ >= 128 ) {
           throw runtime_error( "EventLoop: busy wait detected: rule \""
                                + _rule_categories.at( this_rule.category_id ).name + "\" is still interested after "
@@ -101,7 +277,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
         }
 
         rule_fired = true;
-        this_rule.callback();
+        fire( this_rule );
       }
 
       if ( rule_fired ) {
@@ -142,7 +318,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       continue;
     }
 
-    if ( this_rule.interest() ) {
+    if ( interested( this_rule ) ) {
       pollfds.push_back( { this_rule.fd.fd_num(),
                            static_cast<int16_t>( this_rule.direction == Direction::In ? POLLIN : POLLOUT ),
                            0 } );
@@ -153,18 +329,87 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     ++it;
   }
 
-  // quit if there is nothing left to poll
-  if ( not something_to_poll ) {
+  // a waiter on a closed fd would never see an event, so let it find out now
+  {
+    list<FDWaiter> closed;
+    for ( auto it = _fd_waiters.begin(); it != _fd_waiters.end(); ) {
+      auto next = std::next( it );
+      if ( it->fd.closed() ) {
+        closed.splice( closed.end(), _fd_waiters, it );
+      }
+      it = next;
+    }
+
+    for ( auto& waiter : closed ) {
+      _progress = true;
+      waiter.callback();
+    }
+
+    if ( not closed.empty() ) {
+      return Result::Success;
+    }
+  }
+
+  // the one-shot fd waiters come after the rules in pollfds
+  const size_t rule_count = pollfds.size();
+  for ( const auto& waiter : _fd_waiters ) {
+    pollfds.push_back(
+      { waiter.fd.fd_num(), static_cast<int16_t>( waiter.direction == Direction::In ? POLLIN : POLLOUT ), 0 } );
+  }
+  something_to_poll |= not _fd_waiters.empty();
+
+  // quit if there is nothing left to poll or wait for
+  if ( not something_to_poll and _timers.empty() ) {
     return Result::Exit;
   }
 
+  // don't sleep past the next timer
+  int poll_timeout_ms = timeout_ms;
+  if ( not _timers.empty() ) {
+    const uint64_t now = now_ms();
+    const uint64_t until_timer = _timers.begin()->first > now ? _timers.begin()->first - now : 0;
+    if ( poll_timeout_ms < 0 or until_timer < static_cast<uint64_t>( poll_timeout_ms ) ) {
+      poll_timeout_ms = static_cast<int>( until_timer );
+    }
+  }
+
   // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
-    return Result::Timeout;
+  const uint64_t poll_start = _collect_statistics ? timestamp_ns() : 0;
+  const int ready_count = CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), poll_timeout_ms ) );
+  if ( _collect_statistics ) {
+    ++_polls;
+    _poll_ns += timestamp_ns() - poll_start;
+  }
+
+  if ( ready_count == 0 ) {
+    return run_timers_and_conditions() ? Result::Success : Result::Timeout;
   }
 
-  // go through the poll results
-  for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); it != _fd_rules.end(); ++idx ) {
+  // fire the ready waiters (any event counts, including errors and hangups: the callback will find out)
+  {
+    list<FDWaiter> ready;
+    auto it = _fd_waiters.begin();
+    for ( size_t idx = rule_count; idx < pollfds.size(); ++idx ) {
+      auto next = std::next( it );
+      if ( pollfds[idx].revents ) {
+        ready.splice( ready.end(), _fd_waiters, it );
+      }
+      it = next;
+    }
+
+    for ( auto& waiter : ready ) {
+      _progress = true;
+      waiter.callback();
+    }
+
+    if ( not ready.empty() ) {
+      return Result::Success;
+    }
+  }
+
+  // go through the poll results, handling errors and hangups and collecting the ready rules
+  vector<list<shared_ptr<FDRule>>::iterator> ready_rules;
+  for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); idx < rule_count; ++idx ) {
     const auto& this_pollfd = pollfds.at( idx );
     auto& this_rule = **it;
 
@@ -206,22 +451,72 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 
     if ( poll_ready ) {
       // we only want to call callback if revents includes the event we asked for
-      const auto count_before = this_rule.service_count();
-      this_rule.callback();
+      ready_rules.push_back( it );
+    } else {
+      this_rule.deferrals = 0;
+    }
 
-      if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() ) and this_rule.interest() ) {
-        throw runtime_error( "EventLoop: busy wait detected: rule \""
-                             + _rule_categories.at( this_rule.category_id ).name
-                             + "\" did not read/write fd and is still interested" );
-      }
+    ++it; // if we got here, it means we didn't call _fd_rules.erase()
+  }
 
-      return Result::Success; /* only serve one rule on each iteration */
+  if ( ready_rules.empty() ) {
+    return Result::Success;
+  }
+
+  // serve the highest-priority ready rule, unless a lower-priority one has been passed over too often
+  auto served = ready_rules.front();
+  for ( const auto& candidate : ready_rules ) {
+    if ( ( *candidate )->deferrals >= max_deferrals ) {
+      served = candidate;
+      break;
     }
+  }
 
-    ++it; // if we got here, it means we didn't call _fd_rules.erase()
+  const uint64_t now_ns = _collect_statistics ? timestamp_ns() : 0;
+  for ( const auto& other : ready_rules ) {
+    auto& other_rule = **other;
+    if ( other == served ) {
+      continue;
+    }
+    if ( other_rule.deferrals++ == 0 ) {
+      other_rule.ready_since_ns = now_ns;
+    }
+    if ( _collect_statistics ) {
+      ++_rule_categories.at( other_rule.category_id ).stats.deferrals;
+    }
+  }
+
+  auto& this_rule = **served;
+  if ( _collect_statistics and this_rule.deferrals ) {
+    auto& stats = _rule_categories.at( this_rule.category_id ).stats;
+    stats.max_ready_wait_ns = max( stats.max_ready_wait_ns, now_ns - this_rule.ready_since_ns );
+  }
+  this_rule.deferrals = 0;
+
+  const auto count_before = this_rule.service_count();
+  fire( this_rule );
+
+  if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() ) and interested( this_rule ) ) {
+    throw runtime_error( "EventLoop: busy wait detected: rule \""
+                         + _rule_categories.at( this_rule.category_id ).name
+                         + "\" did not read/write fd and is still interested" );
+  }
+
+  // drain mode: keep going until the callback stops making progress (EAGAIN) or the budget runs out
+  for ( unsigned fired = 1; fired < this_rule.drain_budget; ++fired ) {
+    if ( this_rule.fd.closed() or ( this_rule.direction == Direction::In and this_rule.fd.eof() )
+         or this_rule.cancel_requested or not interested( this_rule ) ) {
+      break;
+    }
+
+    const auto count_before_drain = this_rule.service_count();
+    fire( this_rule );
+    if ( count_before_drain == this_rule.service_count() ) {
+      break;
+    }
   }
 
-  return Result::Success;
+  return Result::Success; /* only serve one rule on each iteration */
 }
 // NOLINTEND(*-signed-bitwise)
 // NOLINTEND(*-cognitive-complexity)
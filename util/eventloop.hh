@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
+#include <ostream>
 #include <poll.h>
 
 #include "file_descriptor.hh"
@@ -18,6 +21,29 @@ public:
     Out // Callback will be triggered when Rule::fd is writable.
   };
 
+  //! When several FD rules are ready at once, the loop serves the one with the highest priority first
+  //! (rules of equal priority are served in the order they were added).
+  enum class Priority : uint8_t
+  {
+    High,   //!< e.g. processing inbound segments and ACKs
+    Normal, //!< the default
+    Low     //!< e.g. bulk movement of application data
+  };
+
+  //! A ready rule passed over this many times in a row is served next regardless of priority
+  static constexpr unsigned max_deferrals = 8;
+
+  //! Per-category counters, collected only while statistics are enabled (see EventLoop::enable_statistics).
+  struct RuleStatistics
+  {
+    uint64_t fires {};             //!< Number of times a callback in this category ran
+    uint64_t callback_ns {};       //!< Total time spent in callbacks
+    uint64_t max_callback_ns {};   //!< Longest single callback
+    uint64_t interest_ns {};       //!< Total time spent evaluating interest functions
+    uint64_t deferrals {};         //!< Times a ready rule was passed over for a higher-priority one
+    uint64_t max_ready_wait_ns {}; //!< Longest time from a rule first being passed over to being served
+  };
+
 private:
   using CallbackT = std::function<void( void )>;
   using InterestT = std::function<bool( void )>;
@@ -25,6 +51,7 @@ private:
   struct RuleCategory
   {
     std::string name;
+    RuleStatistics stats {};
   };
 
   struct BasicRule
@@ -33,6 +60,10 @@ private:
     InterestT interest;
     CallbackT callback;
     bool cancel_requested {};
+    unsigned drain_budget { 1 };            //!< FD rules: max callbacks per wakeup (see set_drain_budget)
+    Priority priority { Priority::Normal }; //!< see RuleHandle::set_priority
+    unsigned deferrals {};                  //!< FD rules: consecutive wakeups passed over while ready
+    uint64_t ready_since_ns {};             //!< FD rules: when first passed over (only while collecting statistics)
 
     BasicRule( size_t s_category_id, InterestT s_interest, CallbackT s_callback );
   };
@@ -55,8 +86,53 @@ private:
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
 
+  //! A one-shot wait for a file descriptor to become ready (see EventLoop::run_when_ready)
+  struct FDWaiter
+  {
+    FileDescriptor fd;
+    Direction direction;
+    CallbackT callback;
+  };
+
+  //! A one-shot wait for a condition to hold (see EventLoop::run_when)
+  struct ConditionWaiter
+  {
+    InterestT condition;
+    CallbackT callback;
+  };
+
+  std::list<FDWaiter> _fd_waiters {};
+  std::multimap<uint64_t, CallbackT> _timers {}; //!< Keyed by deadline (EventLoop::now_ms)
+  std::list<ConditionWaiter> _condition_waiters {};
+  bool _progress { true }; //!< Has anything run since the condition waiters were last checked?
+
+  //! Fire due timers, then any condition waiters that now hold. Returns true if anything fired.
+  bool run_timers_and_conditions();
+
+  bool _collect_statistics {}; //!< Time interest functions, callbacks and poll(2)?
+  uint64_t _polls {};          //!< Number of calls to poll(2) while collecting statistics
+  uint64_t _poll_ns {};        //!< Time spent blocked in poll(2) while collecting statistics
+
+  //! Evaluate a rule's interest function, timing it if statistics are enabled
+  bool interested( const BasicRule& rule );
+
+  //! Run a rule's callback, timing it if statistics are enabled
+  void fire( const BasicRule& rule );
+
+  //! Keep each rule list in priority order (stable, so equal priorities stay in insertion order)
+  void sort_rules_by_priority();
+
 public:
-  EventLoop() { _rule_categories.reserve( 64 ); }
+  //! Statistics are enabled from the start if the MINNOW_EVENTLOOP_STATS environment variable is set.
+  EventLoop();
+
+  //! Prints the summary table to stderr if statistics were enabled.
+  ~EventLoop();
+
+  EventLoop( const EventLoop& other ) = delete;
+  EventLoop& operator=( const EventLoop& other ) = delete;
+  EventLoop( EventLoop&& other ) = delete;
+  EventLoop& operator=( EventLoop&& other ) = delete;
 
   //! Returned by each call to EventLoop::wait_next_event.
   enum class Result : uint8_t
@@ -79,6 +155,15 @@ public:
     {}
 
     void cancel();
+
+    //! Let an FD rule run its callback up to `budget` times per wakeup instead of once. After the first call,
+    //! the loop keeps calling while the rule is interested and each call reads or writes the fd, so the
+    //! callback drains (or fills) the fd until it would block (EAGAIN) or the budget runs out.
+    //! The fd must be non-blocking.
+    void set_drain_budget( unsigned budget );
+
+    //! Serve this rule before (or after) ready rules of lower (or higher) priority. See EventLoop::Priority.
+    void set_priority( Priority priority );
   };
 
   RuleHandle add_rule(
@@ -96,6 +181,42 @@ public:
   //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
   Result wait_next_event( int timeout_ms );
 
+  //! \name
+  //! One-shot waits
+  //! Unlike rules, these have no interest function: each callback runs once, when its event happens,
+  //! and costs nothing to the loop until then. They are the building blocks for the awaitables in eventloop_task.hh.
+
+  //!@{
+  //! Run `callback` once `fd` is readable (Direction::In) or writable (Direction::Out), or has an error or hangup.
+  void run_when_ready( FileDescriptor& fd, Direction direction, CallbackT callback );
+
+  //! Run `callback` once `delay_ms` milliseconds have passed.
+  void run_after( uint64_t delay_ms, CallbackT callback );
+
+  //! Run `callback` once `condition` holds. The condition is re-checked only after some other callback
+  //! has run in this loop, since nothing else can change state owned by the loop's thread.
+  void run_when( InterestT condition, CallbackT callback );
+
+  //! Milliseconds on the clock used by run_after()
+  static uint64_t now_ms();
+  //!@}
+
+  //! \name
+  //! Per-category instrumentation
+
+  //!@{
+  void enable_statistics( bool enabled = true ) { _collect_statistics = enabled; }
+  bool statistics_enabled() const { return _collect_statistics; }
+  size_t category_count() const { return _rule_categories.size(); }
+  const std::string& category_name( size_t category_id ) const { return _rule_categories.at( category_id ).name; }
+  const RuleStatistics& statistics( size_t category_id ) const { return _rule_categories.at( category_id ).stats; }
+  uint64_t poll_count() const { return _polls; }
+  uint64_t poll_ns() const { return _poll_ns; }
+
+  //! Print a table of the per-category counters
+  void summary( std::ostream& out ) const;
+  //!@}
+
   // convenience function to add category and rule at the same time
   template<typename... Targs>
   auto add_rule( const std::string& name, Targs&&... Fargs )
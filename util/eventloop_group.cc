@@ -0,0 +1,119 @@
+#include "eventloop_group.hh"
+#include "exception.hh"
+
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+void JobQueue::push( Job job )
+{
+  bool was_empty {};
+  {
+    const lock_guard lock { _mutex };
+    was_empty = _pending.empty();
+    _pending.push_back( move( job ) );
+  }
+
+  // a non-empty queue has already been signalled, and the consumer will take everything in it
+  if ( was_empty ) {
+    _doorbell.notify();
+  }
+}
+
+void JobQueue::run_all( EventLoop& loop )
+{
+  // reset the doorbell before taking the jobs, so a push() that races with us rings it again
+  _doorbell.drain();
+  {
+    const lock_guard lock { _mutex };
+    swap( _pending, _running );
+  }
+
+  for ( auto& job : _running ) {
+    job( loop );
+  }
+  _running.clear();
+}
+
+EventLoopGroup::EventLoopGroup( const size_t loop_count, const bool pin_to_cores )
+{
+  if ( loop_count == 0 ) {
+    throw runtime_error( "EventLoopGroup needs at least one loop" );
+  }
+
+  _workers.reserve( loop_count );
+  for ( size_t i = 0; i < loop_count; ++i ) {
+    _workers.push_back( make_unique<Worker>() );
+  }
+
+  // start the threads only after every Worker exists, since jobs may post to other loops
+  for ( size_t i = 0; i < loop_count; ++i ) {
+    Worker& worker = *_workers[i];
+    worker.thread = thread( &EventLoopGroup::run, this, ref( worker ), i, pin_to_cores );
+  }
+}
+
+EventLoopGroup::~EventLoopGroup()
+{
+  try {
+    stop();
+  } catch ( const exception& e ) {
+    cerr << "Exception destructing EventLoopGroup: " << e.what() << "\n";
+  }
+}
+
+void EventLoopGroup::post( const size_t index, JobQueue::Job job )
+{
+  _workers.at( index )->jobs.push( move( job ) );
+}
+
+void EventLoopGroup::stop()
+{
+  _stop.store( true );
+  for ( auto& worker : _workers ) {
+    if ( worker->thread.joinable() ) {
+      worker->jobs.fd().notify(); // wake the loop so it notices _stop
+    }
+  }
+
+  for ( auto& worker : _workers ) {
+    if ( worker->thread.joinable() ) {
+      worker->thread.join();
+    }
+  }
+}
+
+void EventLoopGroup::run( Worker& worker, const size_t index, const bool pin_to_core )
+{
+  if ( pin_to_core ) {
+    const unsigned cores = max( 1U, thread::hardware_concurrency() );
+    cpu_set_t cpus;
+    CPU_ZERO( &cpus );
+    CPU_SET( index % cores, &cpus );
+    const int err = pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus );
+    if ( err ) {
+      // e.g. a restricted cpuset in a container: keep running, just unpinned
+      cerr << "Warning: could not pin event loop " << index << " to core " << index % cores << ": "
+           << unix_error( "pthread_setaffinity_np", err ).what() << "\n";
+    }
+  }
+
+  worker.loop.add_rule(
+    "run jobs posted to loop " + to_string( index ), worker.jobs.fd(), Direction::In, [&] {
+      worker.jobs.run_all( worker.loop );
+    } );
+
+  try {
+    while ( not _stop.load() ) {
+      if ( worker.loop.wait_next_event( -1 ) == EventLoop::Result::Exit ) {
+        break;
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in event loop " << index << ": " << e.what() << "\n";
+  }
+}
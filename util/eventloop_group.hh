@@ -0,0 +1,79 @@
+#pragma once
+
+#include "eventfd.hh"
+#include "eventloop.hh"
+#include "four_tuple.hh"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A multi-producer, single-consumer queue of jobs for one EventLoop.
+//! Any thread may push(); the loop's own thread runs the jobs when the queue's eventfd becomes readable.
+class JobQueue
+{
+public:
+  using Job = std::function<void( EventLoop& )>;
+
+  //! Append a job, waking up the consumer if the queue was empty
+  void push( Job job );
+
+  //! Run every job queued so far (called by the consumer)
+  void run_all( EventLoop& loop );
+
+  //! Readable whenever jobs are waiting
+  EventFD& fd() { return _doorbell; }
+
+private:
+  std::mutex _mutex {};
+  std::vector<Job> _pending {};
+  std::vector<Job> _running {};
+  EventFD _doorbell {};
+};
+
+//! A fixed set of EventLoops, each run by its own thread pinned to one CPU core.
+//! Work reaches a loop only through post(); connections are spread over loops by hashing their FourTuple.
+class EventLoopGroup
+{
+public:
+  //! Start `loop_count` loops; if `pin_to_cores`, loop i runs on core i (mod the number of cores)
+  explicit EventLoopGroup( size_t loop_count = std::thread::hardware_concurrency(), bool pin_to_cores = true );
+
+  //! Stop all loops and wait for their threads
+  ~EventLoopGroup();
+
+  EventLoopGroup( const EventLoopGroup& other ) = delete;
+  EventLoopGroup& operator=( const EventLoopGroup& other ) = delete;
+  EventLoopGroup( EventLoopGroup&& other ) = delete;
+  EventLoopGroup& operator=( EventLoopGroup&& other ) = delete;
+
+  size_t size() const { return _workers.size(); }
+
+  //! Run `job` on the thread of loop `index` (safe to call from any thread, including the loops' own)
+  void post( size_t index, JobQueue::Job job );
+
+  //! The loop responsible for the connection identified by `tuple`
+  size_t loop_for( const FourTuple& tuple ) const { return std::hash<FourTuple> {}( tuple ) % size(); }
+
+  //! Run `job` on the loop responsible for `tuple`
+  void post( const FourTuple& tuple, JobQueue::Job job ) { post( loop_for( tuple ), std::move( job ) ); }
+
+  //! Ask every loop to exit and wait for their threads (idempotent)
+  void stop();
+
+private:
+  struct Worker
+  {
+    EventLoop loop {};
+    JobQueue jobs {};
+    std::thread thread {};
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers {};
+  std::atomic_bool _stop { false };
+
+  void run( Worker& worker, size_t index, bool pin_to_core );
+};
@@ -0,0 +1,51 @@
+#include "eventloop_task.hh"
+
+using namespace std;
+
+namespace {
+//! Owns a suspended coroutine until it is resumed, and destroys it if it never is
+class SuspendedTask
+{
+  Task::Handle handle_;
+
+public:
+  explicit SuspendedTask( Task::Handle handle ) : handle_( handle ) {}
+
+  ~SuspendedTask()
+  {
+    if ( handle_ ) {
+      handle_.destroy();
+    }
+  }
+
+  SuspendedTask( const SuspendedTask& other ) = delete;
+  SuspendedTask& operator=( const SuspendedTask& other ) = delete;
+  SuspendedTask( SuspendedTask&& other ) = delete;
+  SuspendedTask& operator=( SuspendedTask&& other ) = delete;
+
+  //! Resume the coroutine. If that finishes it, destroy it and rethrow any exception that escaped it;
+  //! otherwise it has suspended again, and is now owned by the callback it registered.
+  void resume()
+  {
+    const Task::Handle handle = exchange( handle_, {} );
+    handle.resume();
+    if ( handle.done() ) {
+      const exception_ptr exception = handle.promise().exception();
+      handle.destroy();
+      if ( exception ) {
+        rethrow_exception( exception );
+      }
+    }
+  }
+};
+} // namespace
+
+void Task::Start::await_suspend( const Handle handle ) const
+{
+  loop_.run_when( [] { return true; }, resumer( handle ) );
+}
+
+function<void( void )> Task::resumer( Handle handle )
+{
+  return [task = make_shared<SuspendedTask>( handle )] { task->resume(); };
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "byte_stream.hh"
+#include "eventloop.hh"
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+
+//! A detached coroutine run by an EventLoop.
+//!
+//! A coroutine that returns Task and takes an EventLoop& as its first parameter runs on that loop. It starts
+//! on the loop's next turn (the next call to EventLoop::wait_next_event), and each `co_await` on one of the
+//! awaitables below suspends it until the loop sees the matching event. A suspended Task costs the loop nothing
+//! until then (no interest function is polled on its behalf).
+//!
+//!     Task copy_to_stdout( EventLoop& loop, FileDescriptor& in, FileDescriptor& out )
+//!     {
+//!       std::string buf;
+//!       while ( not in.eof() ) {
+//!         co_await readable( in );
+//!         in.read( buf );
+//!         ...
+//!       }
+//!     }
+//!
+//! A suspended Task is owned by its EventLoop: if the loop is destroyed first, the coroutine is destroyed
+//! without being resumed. When the coroutine finishes, its frame is destroyed by the callback that resumed it;
+//! an exception that escaped the coroutine is then rethrown, and propagates out of EventLoop::wait_next_event.
+class Task
+{
+public:
+  class promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  //! Awaitable: suspends a new coroutine until the loop's next turn
+  class Start
+  {
+    EventLoop& loop_;
+
+  public:
+    explicit Start( EventLoop& loop ) : loop_( loop ) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend( Handle handle ) const;
+    void await_resume() const noexcept {}
+  };
+
+  class promise_type
+  {
+    EventLoop& loop_;
+    std::exception_ptr exception_ {};
+
+  public:
+    template<typename... Args>
+    explicit promise_type( EventLoop& loop, Args&&... /*unused*/ ) : loop_( loop )
+    {}
+
+    EventLoop& loop() { return loop_; }
+
+    //! The exception that escaped the coroutine, if any
+    const std::exception_ptr& exception() const { return exception_; }
+
+    Task get_return_object() { return {}; }
+    Start initial_suspend() noexcept { return Start { loop_ }; }
+    std::suspend_always final_suspend() noexcept { return {}; } // the resumer destroys the frame
+    void return_void() {}
+    void unhandled_exception() { exception_ = std::current_exception(); }
+  };
+
+  //! A callback that resumes `handle` when called, or destroys it if the callback is dropped without being called
+  static std::function<void( void )> resumer( Handle handle );
+};
+
+//! Awaitable: resumes when a file descriptor is readable or writable (or has an error or hangup)
+class FDReady
+{
+  FileDescriptor& fd_;
+  Direction direction_;
+
+public:
+  FDReady( FileDescriptor& fd, Direction direction ) : fd_( fd ), direction_( direction ) {}
+
+  bool await_ready() const { return fd_.closed(); }
+  void await_suspend( Task::Handle handle )
+  {
+    handle.promise().loop().run_when_ready( fd_, direction_, Task::resumer( handle ) );
+  }
+  void await_resume() const {}
+};
+
+//! Awaitable: resumes once a condition on loop-owned state holds
+class ConditionReady
+{
+  std::function<bool( void )> condition_;
+
+public:
+  explicit ConditionReady( std::function<bool( void )> condition ) : condition_( std::move( condition ) ) {}
+
+  bool await_ready() const { return condition_(); }
+  void await_suspend( Task::Handle handle )
+  {
+    handle.promise().loop().run_when( std::move( condition_ ), Task::resumer( handle ) );
+  }
+  void await_resume() const {}
+};
+
+//! Awaitable: resumes after a delay
+class Sleep
+{
+  uint64_t delay_ms_;
+
+public:
+  explicit Sleep( uint64_t delay_ms ) : delay_ms_( delay_ms ) {}
+
+  bool await_ready() const { return delay_ms_ == 0; }
+  void await_suspend( Task::Handle handle )
+  {
+    handle.promise().loop().run_after( delay_ms_, Task::resumer( handle ) );
+  }
+  void await_resume() const {}
+};
+
+//! \name
+//! Awaitables for use inside a Task
+
+//!@{
+inline FDReady readable( FileDescriptor& fd )
+{
+  return { fd, Direction::In };
+}
+
+inline FDReady writable( FileDescriptor& fd )
+{
+  return { fd, Direction::Out };
+}
+
+//! Resumes once at least `n` bytes are buffered, or the stream is closed (so no more will come) or has an error
+inline ConditionReady readable( const Reader& reader, uint64_t n = 1 )
+{
+  return ConditionReady {
+    [&reader, n] { return reader.bytes_buffered() >= n or reader.writer().is_closed() or reader.has_error(); } };
+}
+
+//! Resumes once the stream has room, or is closed or has an error
+inline ConditionReady writable( const Writer& writer )
+{
+  return ConditionReady {
+    [&writer] { return writer.available_capacity() > 0 or writer.is_closed() or writer.has_error(); } };
+}
+
+inline Sleep sleep_for( uint64_t delay_ms )
+{
+  return Sleep { delay_ms };
+}
+//!@}
@@ -2,15 +2,51 @@
 
 #include "exception.hh"
 
+#include <array>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
+#include <sys/sendfile.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
 using namespace std;
 
+namespace {
+// The iovecs for one readv or writev: on the stack, unless there are more than a datagram usually needs
+class IovecList
+{
+  static constexpr size_t inline_count = 8;
+
+  std::array<iovec, inline_count> inline_ {};
+  vector<iovec> overflow_ {};
+  size_t size_ {};
+  size_t total_size_ {};
+
+public:
+  void push_back( char* data, const size_t size )
+  {
+    if ( size_ < inline_count ) {
+      inline_[size_] = { data, size };
+    } else {
+      if ( size_ == inline_count ) {
+        overflow_.assign( inline_.begin(), inline_.end() );
+      }
+      overflow_.push_back( { data, size } );
+    }
+    ++size_;
+    total_size_ += size;
+  }
+
+  void clear() { size_ = total_size_ = 0; }
+
+  const iovec* data() const { return size_ > inline_count ? overflow_.data() : inline_.data(); }
+  int size() const { return static_cast<int>( size_ ); }
+  size_t total_size() const { return total_size_; }
+};
+} // namespace
+
 template<typename T>
 T FileDescriptor::FDWrapper::CheckSystemCall( string_view s_attempt, T return_value ) const
 {
@@ -106,24 +142,67 @@ void FileDescriptor::read( string& buffer )
   buffer.resize( bytes_read );
 }
 
+namespace {
+// Shared by splice_from and sendfile_from: `moved` is the system call's return value
+size_t finish_transfer( const string_view attempt, const ssize_t moved, const bool non_blocking )
+{
+  if ( moved < 0 ) {
+    if ( non_blocking and errno == EAGAIN ) {
+      return 0;
+    }
+    throw unix_error { attempt };
+  }
+  return moved;
+}
+} // namespace
+
+size_t FileDescriptor::splice_from( FileDescriptor& source, const size_t len )
+{
+  const ssize_t moved
+    = ::splice( source.fd_num(), nullptr, fd_num(), nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+  // SPLICE_F_NONBLOCK makes the pipe's side non-blocking, whatever the fd's own flag
+  const size_t ret = finish_transfer( "splice", moved, true );
+  if ( moved >= 0 ) {
+    source.register_read();
+    register_write();
+  }
+  if ( moved == 0 and len > 0 ) {
+    source.internal_fd_->eof_ = true;
+  }
+  return ret;
+}
+
+size_t FileDescriptor::sendfile_from( FileDescriptor& source, const size_t len )
+{
+  const ssize_t moved = ::sendfile( fd_num(), source.fd_num(), nullptr, len );
+  const size_t ret = finish_transfer( "sendfile", moved, internal_fd_->non_blocking_ );
+  if ( moved >= 0 ) {
+    source.register_read();
+    register_write();
+  }
+  if ( moved == 0 and len > 0 ) {
+    source.internal_fd_->eof_ = true;
+  }
+  return ret;
+}
+
 void FileDescriptor::read( vector<string>& buffers )
 {
   if ( buffers.empty() ) {
     return;
   }
 
-  buffers.back().clear();
-  buffers.back().resize( kReadBufferSize );
+  // the last buffer takes the rest of the datagram (the caller may make it bigger than kReadBufferSize)
+  if ( buffers.back().size() < kReadBufferSize ) {
+    buffers.back().resize( kReadBufferSize );
+  }
 
-  vector<iovec> iovecs;
-  iovecs.reserve( buffers.size() );
-  size_t total_size = 0;
-  for ( const auto& x : buffers ) {
-    iovecs.push_back( { const_cast<char*>( x.data() ), x.size() } ); // NOLINT(*-const-cast)
-    total_size += x.size();
+  IovecList iovecs;
+  for ( auto& x : buffers ) {
+    iovecs.push_back( x.data(), x.size() );
   }
 
-  const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) );
+  const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), iovecs.size() );
   if ( bytes_read < 0 ) {
     if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
       buffers.clear();
@@ -134,48 +213,111 @@ void FileDescriptor::read( vector<string>& buffers )
 
   register_read();
 
-  if ( bytes_read > static_cast<ssize_t>( total_size ) ) {
+  if ( bytes_read > static_cast<ssize_t>( iovecs.total_size() ) ) {
     throw runtime_error( "read() read more than requested" );
   }
 
-  size_t remaining_size = bytes_read;
+  trim_buffers( buffers, bytes_read );
+}
+
+// Shrink a list of buffers to hold only the first `size` bytes read into them
+void FileDescriptor::trim_buffers( vector<string>& buffers, size_t size )
+{
   for ( auto& buf : buffers ) {
-    if ( remaining_size >= buf.size() ) {
-      remaining_size -= buf.size();
+    if ( size >= buf.size() ) {
+      size -= buf.size();
     } else {
-      buf.resize( remaining_size );
-      remaining_size = 0;
+      buf.resize( size );
+      size = 0;
     }
   }
 }
 
+// Each element of `datagrams` is a list of buffers, filled like read( vector<string>& ) by one readv.
+// Unlike that function, the buffers are neither trimmed to what was read nor freed when the fd would block:
+// growing them back before the next read would zero-fill every byte of them again.
+size_t FileDescriptor::read_batch( span<vector<string>> datagrams, span<size_t> lengths )
+{
+  if ( lengths.size() < datagrams.size() ) {
+    throw runtime_error( "read_batch: fewer lengths than datagrams" );
+  }
+
+  size_t count = 0;
+  IovecList iovecs;
+
+  for ( auto& buffers : datagrams ) {
+    if ( buffers.empty() ) {
+      break;
+    }
+
+    if ( buffers.back().size() < kReadBufferSize ) {
+      buffers.back().resize( kReadBufferSize );
+    }
+
+    iovecs.clear();
+    for ( auto& x : buffers ) {
+      iovecs.push_back( x.data(), x.size() );
+    }
+
+    const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), iovecs.size() );
+    if ( bytes_read < 0 ) {
+      if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+        break;
+      }
+      throw unix_error { "readv" };
+    }
+
+    register_read();
+
+    if ( bytes_read == 0 ) {
+      internal_fd_->eof_ = true;
+      break;
+    }
+
+    if ( bytes_read > static_cast<ssize_t>( iovecs.total_size() ) ) {
+      throw runtime_error( "readv() read more than requested" );
+    }
+
+    lengths[count++] = bytes_read;
+
+    if ( not internal_fd_->non_blocking_ ) {
+      break; // the next read would wait for another datagram
+    }
+  }
+
+  return count;
+}
+
 size_t FileDescriptor::write( string_view buffer )
 {
-  return write( vector<string_view> { buffer } );
+  return write_buffers( array { buffer } );
+}
+
+size_t FileDescriptor::write( const vector<string_view>& buffers )
+{
+  return write_buffers( buffers );
 }
 
 size_t FileDescriptor::write( const vector<Ref<string>>& buffers )
 {
-  vector<string_view> views;
-  views.reserve( buffers.size() );
-  for ( const auto& x : buffers ) {
-    views.emplace_back( x.get() );
-  }
-  return write( views );
+  return write_buffers( buffers );
 }
 
-size_t FileDescriptor::write( const vector<string_view>& buffers )
+template<typename Buffers>
+size_t FileDescriptor::write_buffers( const Buffers& buffers )
 {
-  vector<iovec> iovecs;
-  iovecs.reserve( buffers.size() );
-  size_t total_size = 0;
-  for ( const auto x : buffers ) {
-    iovecs.push_back( { const_cast<char*>( x.data() ), x.size() } ); // NOLINT(*-const-cast)
-    total_size += x.size();
+  IovecList iovecs;
+  for ( const auto& x : buffers ) {
+    const string_view view { x };
+    iovecs.push_back( const_cast<char*>( view.data() ), view.size() ); // NOLINT(*-const-cast)
+  }
+  const size_t total_size = iovecs.total_size();
+
+  const ssize_t bytes_written = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), iovecs.size() ) );
+  if ( bytes_written == 0 and total_size != 0 and internal_fd_->non_blocking_ ) {
+    return 0; // would block: not counted as a write, so EventLoop can tell that nothing happened
   }
 
-  const ssize_t bytes_written
-    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
   register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
@@ -189,6 +331,20 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
   return bytes_written;
 }
 
+size_t FileDescriptor::write_batch( span<const vector<Ref<string>>> datagrams )
+{
+  size_t count = 0;
+  for ( const auto& buffers : datagrams ) {
+    const auto writes_before = write_count();
+    write( buffers );
+    if ( write_count() == writes_before ) {
+      break; // would block
+    }
+    ++count;
+  }
+  return count;
+}
+
 void FileDescriptor::set_blocking( bool blocking )
 {
   int flags = CheckSystemCall( "fcntl", fcntl( fd_num(), F_GETFL ) ); // NOLINT(*-vararg)
@@ -3,6 +3,7 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -51,9 +52,17 @@ protected:
   void register_read() { ++internal_fd_->read_count_; }   // increment read count
   void register_write() { ++internal_fd_->write_count_; } // increment write count
 
+  // Shrink `buffers` (filled in order) to the first `size` bytes
+  static void trim_buffers( std::vector<std::string>& buffers, size_t size );
+
   template<typename T>
   T CheckSystemCall( std::string_view s_attempt, T return_value ) const;
 
+private:
+  // Write a list of buffers with one writev (see write())
+  template<typename Buffers>
+  size_t write_buffers( const Buffers& buffers );
+
 public:
   // Construct from a file descriptor number returned by the kernel
   explicit FileDescriptor( int fd );
@@ -71,6 +80,22 @@ public:
   size_t write( const std::vector<std::string_view>& buffers );
   size_t write( const std::vector<Ref<std::string>>& buffers );
 
+  // Move up to `len` bytes from `source` to this fd without copying them through user space, returning the number
+  // moved (0 if either fd would block). At the end of `source`, sets its EOF flag.
+  size_t splice_from( FileDescriptor& source, size_t len );   // with splice(2): one of the two must be a pipe
+  size_t sendfile_from( FileDescriptor& source, size_t len ); // with sendfile(2): `source` must be a regular file
+
+  // Batched I/O for datagram-oriented fds (TUN devices, datagram sockets): one datagram per read or write.
+  // On a non-blocking fd, these keep going until the fd would block; on a blocking fd, read_batch reads one.
+
+  // Read datagrams into `datagrams` (each a list of buffers, as for read()); returns the number read.
+  // The buffers keep their size, so they can be reused without being refilled; `lengths[i]` gets the number
+  // of bytes of datagram i (`lengths` must be at least as long as `datagrams`).
+  size_t read_batch( std::span<std::vector<std::string>> datagrams, std::span<size_t> lengths );
+
+  // Write each datagram (a list of buffers, as for write()); returns the number written
+  size_t write_batch( std::span<const std::vector<Ref<std::string>>> datagrams );
+
   // Close the underlying file descriptor
   void close() { internal_fd_->close(); }
 
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+//! The (source address, source port, destination address, destination port) that identifies a TCP connection
+struct FourTuple
+{
+  uint32_t src_ip {};
+  uint16_t src_port {};
+  uint32_t dst_ip {};
+  uint16_t dst_port {};
+
+  bool operator==( const FourTuple& other ) const = default;
+
+  //! The same connection as seen from the other endpoint
+  FourTuple reversed() const { return { dst_ip, dst_port, src_ip, src_port }; }
+};
+
+template<>
+struct std::hash<FourTuple>
+{
+  size_t operator()( const FourTuple& t ) const noexcept
+  {
+    // pack into two words and mix (splitmix64 finalizer) so that nearby ports spread across buckets
+    uint64_t x = ( static_cast<uint64_t>( t.src_ip ) << 32 | t.dst_ip )
+                 ^ ( ( static_cast<uint64_t>( t.src_port ) << 16 | t.dst_port ) * 0x9e3779b97f4a7c15ULL );
+    x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+    return x ^ ( x >> 31 );
+  }
+};
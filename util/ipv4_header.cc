@@ -9,25 +9,27 @@ using namespace std;
 // Parse from string.
 void IPv4Header::parse( Parser& parser )
 {
-  uint8_t first_byte {};
-  parser.integer( first_byte );
-  ver = first_byte >> 4;    // version
-  hlen = first_byte & 0x0f; // header length
-  parser.integer( tos );    // type of service
-  parser.integer( len );
-  parser.integer( id );
-
-  uint16_t fo_val {};
-  parser.integer( fo_val );
-  df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
-  mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
-  offset = fo_val & 0x1fff;                  // offset
-
-  parser.integer( ttl );
-  parser.integer( proto );
-  parser.integer( cksum );
-  parser.integer( src );
-  parser.integer( dst );
+  parser.fixed( LENGTH, [&]( auto& header ) {
+    uint8_t first_byte {};
+    header.integer( first_byte );
+    ver = first_byte >> 4;    // version
+    hlen = first_byte & 0x0f; // header length
+    header.integer( tos );    // type of service
+    header.integer( len );
+    header.integer( id );
+
+    uint16_t fo_val {};
+    header.integer( fo_val );
+    df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
+    mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
+    offset = fo_val & 0x1fff;                  // offset
+
+    header.integer( ttl );
+    header.integer( proto );
+    header.integer( cksum );
+    header.integer( src );
+    header.integer( dst );
+  } );
 
   if ( ver != 4 ) {
     parser.set_error();
@@ -110,7 +112,7 @@ void IPv4Header::compute_checksum()
 
   // calculate checksum -- taken over header only
   InternetChecksum check;
-  check.add( s.finish() );
+  check.add( s.contents() );
   cksum = check.value();
 }
 
@@ -0,0 +1,132 @@
+#include "loopback_adapter.hh"
+
+using namespace std;
+
+pair<LoopbackAdapter, LoopbackAdapter> LoopbackAdapter::make_pair( const size_t queue_capacity, const bool wakeups )
+{
+  // one slot always stays empty, to tell a full ring from an empty one
+  auto a_to_b = make_shared<Channel>( queue_capacity + 1, wakeups );
+  auto b_to_a = make_shared<Channel>( queue_capacity + 1, wakeups );
+  return { LoopbackAdapter { b_to_a, a_to_b }, LoopbackAdapter { a_to_b, b_to_a } };
+}
+
+bool LoopbackAdapter::Channel::push( pair<FourTuple, TCPMessage>&& msg )
+{
+  const size_t t = tail.load( memory_order_relaxed );
+  const size_t next = ( t + 1 ) % slots.size();
+  if ( next == head.load( memory_order_acquire ) ) {
+    return false;
+  }
+  slots[t] = move( msg );
+  tail.store( next, memory_order_release );
+  return true;
+}
+
+optional<pair<FourTuple, TCPMessage>> LoopbackAdapter::Channel::pop()
+{
+  const size_t h = head.load( memory_order_relaxed );
+  if ( h == tail.load( memory_order_acquire ) ) {
+    return {};
+  }
+  optional<pair<FourTuple, TCPMessage>> ret { move( slots[h] ) };
+  head.store( ( h + 1 ) % slots.size(), memory_order_release );
+  return ret;
+}
+
+void LoopbackAdapter::Channel::ring()
+{
+  if ( wakeups and not signaled.exchange( true ) ) {
+    doorbell.notify();
+  }
+}
+
+// Drain first: a ring that lands in between then leaves signaled clear (so the next write rings again),
+// rather than set with nothing to wake the reader. Resetting the flag with an exchange (not a plain store)
+// keeps the reader's following loads of `tail` from moving ahead of it: a writer that found the flag still
+// set is then guaranteed to have its segments seen.
+void LoopbackAdapter::Channel::clear()
+{
+  if ( wakeups ) {
+    doorbell.drain();
+    signaled.exchange( false );
+  }
+}
+
+optional<TCPMessage> LoopbackAdapter::read()
+{
+  auto segs = read_batch( 1 );
+  if ( segs.empty() ) {
+    return {};
+  }
+  return move( segs.front() );
+}
+
+void LoopbackAdapter::write( const TCPMessage& seg )
+{
+  write_batch( span { &seg, 1 } );
+}
+
+//! \details The doorbell is drained first, and rung again if segments are left over, so that
+//! no segment can arrive without the doorbell being readable afterwards.
+template<typename Take>
+void LoopbackAdapter::pop_batch( const size_t max, Take&& take )
+{
+  _inbound->clear();
+
+  for ( size_t i = 0; i < max; ++i ) {
+    auto msg = _inbound->pop();
+    if ( not msg ) {
+      break;
+    }
+    take( move( msg.value() ) );
+  }
+
+  if ( not _inbound->empty() ) {
+    _inbound->ring();
+  }
+}
+
+vector<TCPMessage> LoopbackAdapter::read_batch( const size_t max )
+{
+  vector<TCPMessage> ret;
+  pop_batch( max, [&]( pair<FourTuple, TCPMessage>&& msg ) { ret.push_back( move( msg.second ) ); } );
+  return ret;
+}
+
+vector<pair<FourTuple, TCPMessage>> LoopbackAdapter::read_any_batch( const size_t max )
+{
+  vector<pair<FourTuple, TCPMessage>> ret;
+  pop_batch( max, [&]( pair<FourTuple, TCPMessage>&& msg ) { ret.push_back( move( msg ) ); } );
+  return ret;
+}
+
+void LoopbackAdapter::write_batch( const span<const TCPMessage> segs )
+{
+  write_batch( tuple(), segs );
+}
+
+void LoopbackAdapter::write_batch( const FourTuple& tuple, const span<const TCPMessage> segs )
+{
+  bool pushed = false;
+  for ( const auto& seg : segs ) {
+    // the caller's message may borrow from its sender, so the other end gets its own copy
+    if ( _outbound->push(
+           { tuple, { TCPSenderMessage { seg.sender.get() }, TCPReceiverMessage { seg.receiver.get() } } } ) ) {
+      pushed = true;
+    } else {
+      ++_drops;
+    }
+  }
+
+  if ( pushed ) {
+    _outbound->ring();
+  }
+}
+
+FourTuple LoopbackAdapter::tuple() const
+{
+  return { config().source.ipv4_numeric(),
+           config().source.port(),
+           config().destination.ipv4_numeric(),
+           config().destination.port() };
+}
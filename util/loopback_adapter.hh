@@ -0,0 +1,105 @@
+#pragma once
+
+#include "eventfd.hh"
+#include "fd_adapter.hh"
+#include "four_tuple.hh"
+#include "tcp_segment.hh"
+#include "tuntap_adapter.hh"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+//! \brief One end of an in-memory link between two adapters in the same process
+//! \details Segments written to one end can be read from the other, through a bounded lock-free queue in each
+//! direction (one writer thread and one reader thread per queue). No addresses or checksums are involved, so
+//! this measures the protocol engine alone. When the queue is full, segments are dropped, like a NIC's ring.
+//!
+//! Each segment carries a FourTuple, so a TCPStack can run over a pair too: write_batch( tuple, segs ) sends
+//! segments for any connection, and read_any_batch() hands them over with their tuples. A segment sent with
+//! write() or write_batch( segs ) carries the tuple of the connection in the config (source to destination).
+//!
+//! The fd() of each end is an eventfd that becomes readable when segments arrive, so an EventLoop (e.g. in a
+//! TCPMinnowSocket) can wait on it. A pair made without wakeups never touches the eventfds, for drivers that
+//! poll both ends in one thread without making any system calls.
+class LoopbackAdapter : public FdAdapterBase
+{
+public:
+  static constexpr size_t DEFAULT_QUEUE_CAPACITY = 4096; //!< Segments held in each direction
+
+  //! Make two connected ends
+  static std::pair<LoopbackAdapter, LoopbackAdapter> make_pair( size_t queue_capacity = DEFAULT_QUEUE_CAPACITY,
+                                                                bool wakeups = true );
+
+  //! Reads a segment sent by the other end, if one is waiting
+  std::optional<TCPMessage> read();
+
+  //! Sends a (copy of the) segment to the other end
+  void write( const TCPMessage& seg );
+
+  //! Reads up to `max` waiting segments
+  std::vector<TCPMessage> read_batch( size_t max );
+
+  //! Sends a burst of segments
+  void write_batch( std::span<const TCPMessage> segs );
+
+  //! \name
+  //! For a stack of many connections (see TCPStack)
+
+  //!@{
+  //! Reads up to `max` waiting segments, each with the FourTuple it was sent with
+  std::vector<std::pair<FourTuple, TCPMessage>> read_any_batch( size_t max );
+
+  //! Sends a burst of segments for the connection `tuple` (in the outgoing direction)
+  void write_batch( const FourTuple& tuple, std::span<const TCPMessage> segs );
+  //!@}
+
+  //! The connection in the config, in the outgoing direction
+  FourTuple tuple() const;
+
+  //! Segments dropped because the other end's queue was full
+  uint64_t drops() const { return _drops; }
+
+  //! Readable when segments are waiting (if the pair was made with wakeups)
+  FileDescriptor& fd() { return _inbound->doorbell; }
+
+private:
+  //! A single-producer, single-consumer ring of segments
+  struct Channel
+  {
+    std::vector<std::pair<FourTuple, TCPMessage>> slots;
+    std::atomic<size_t> head {}; //!< Next slot to read (advanced by the reader)
+    std::atomic<size_t> tail {}; //!< Next slot to write (advanced by the writer)
+    EventFD doorbell {};
+    std::atomic_bool signaled {}; //!< Has the doorbell been rung since the reader last drained it?
+    bool wakeups;
+
+    Channel( size_t capacity, bool s_wakeups ) : slots( capacity ), wakeups( s_wakeups ) {}
+
+    bool push( std::pair<FourTuple, TCPMessage>&& msg );
+    std::optional<std::pair<FourTuple, TCPMessage>> pop();
+    bool empty() const { return head.load( std::memory_order_acquire ) == tail.load( std::memory_order_acquire ); }
+
+    void ring();  //!< Make the doorbell readable, unless it already is
+    void clear(); //!< Drain the doorbell if it was rung
+  };
+
+  std::shared_ptr<Channel> _inbound;
+  std::shared_ptr<Channel> _outbound;
+  uint64_t _drops {};
+
+  //! Pop up to `max` waiting segments, passing each to `take`
+  template<typename Take>
+  void pop_batch( size_t max, Take&& take );
+
+  LoopbackAdapter( std::shared_ptr<Channel> inbound, std::shared_ptr<Channel> outbound )
+    : _inbound( std::move( inbound ) ), _outbound( std::move( outbound ) )
+  {}
+};
+
+static_assert( TCPDatagramAdapter<LoopbackAdapter> );
+static_assert( TCPBatchDatagramAdapter<LoopbackAdapter> );
+static_assert( TCPDemuxAdapter<LoopbackAdapter> );
@@ -7,7 +7,9 @@
 
 #include <optional>
 #include <random>
+#include <span>
 #include <utility>
+#include <vector>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
 template<typename AdapterT>
@@ -59,6 +61,29 @@ public:
     return _adapter.write( seg );
   }
 
+  //! \brief Read a burst from the underlying AdapterT instance, potentially dropping each datagram
+  std::vector<TCPMessage> read_batch( const size_t max )
+    requires requires( AdapterT a ) { a.read_batch( max ); }
+  {
+    auto ret = _adapter.read_batch( max );
+    std::erase_if( ret, [&]( const TCPMessage& ) { return _should_drop( false ); } );
+    return ret;
+  }
+
+  //! \brief Write a burst to the underlying AdapterT instance, potentially dropping each datagram
+  void write_batch( const std::span<const TCPMessage> segs )
+    requires requires( AdapterT a ) { a.write_batch( segs ); }
+  {
+    std::vector<TCPMessage> kept;
+    kept.reserve( segs.size() );
+    for ( const auto& seg : segs ) {
+      if ( not _should_drop( true ) ) {
+        kept.push_back( { seg.sender.borrow(), seg.receiver.borrow() } );
+      }
+    }
+    _adapter.write_batch( kept );
+  }
+
   //! \name
   //! Passthrough functions to the underlying AdapterT instance
 
@@ -0,0 +1,106 @@
+#include "netem_adapter.hh"
+
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+[[noreturn]] void bad_value( const string& key, const string& value, const string& expected )
+{
+  throw runtime_error( "netem: " + key + " must be " + expected + ", not \"" + value + "\"" );
+}
+
+//! A finite number, with nothing after it
+double parse_number( const string& key, const string& value )
+{
+  size_t used = 0;
+  double number = NAN;
+  try {
+    number = stod( value, &used );
+  } catch ( const logic_error& ) {
+    bad_value( key, value, "a number" );
+  }
+  if ( used != value.size() or not isfinite( number ) ) {
+    bad_value( key, value, "a number" );
+  }
+  return number;
+}
+
+double parse_probability( const string& key, const string& value )
+{
+  const double p = parse_number( key, value );
+  if ( p < 0 or p > 1 ) {
+    bad_value( key, value, "a probability between 0 and 1" );
+  }
+  return p;
+}
+
+//! A non-negative whole amount (a delay, a rate or a size), which may be written in scientific notation (e.g. 20e6)
+uint64_t parse_amount( const string& key, const string& value )
+{
+  const double amount = parse_number( key, value );
+  if ( amount < 0 or amount >= 0x1p64 or amount != floor( amount ) ) {
+    bad_value( key, value, "a non-negative whole number" );
+  }
+  return static_cast<uint64_t>( amount );
+}
+
+} // namespace
+
+NetEmConfig parse_netem( const string& spec )
+{
+  NetEmConfig netem {};
+
+  size_t pos = 0;
+  while ( pos < spec.size() ) {
+    const size_t end = min( spec.find( ',', pos ), spec.size() );
+    const string item = spec.substr( pos, end - pos );
+    pos = end + 1;
+
+    const size_t equals = item.find( '=' );
+    const string key = item.substr( 0, equals );
+    const string value = equals == string::npos ? "" : item.substr( equals + 1 );
+
+    if ( key == "delay" ) {
+      netem.delay_ms = parse_amount( key, value );
+    } else if ( key == "jitter" ) {
+      netem.jitter_ms = parse_amount( key, value );
+    } else if ( key == "rate" ) {
+      netem.rate = parse_amount( key, value );
+    } else if ( key == "burst" ) {
+      netem.burst = parse_amount( key, value );
+    } else if ( key == "limit" ) {
+      netem.queue_limit = parse_amount( key, value );
+    } else if ( key == "red" ) {
+      netem.red = true;
+    } else if ( key == "reorder" ) {
+      netem.reorder = parse_probability( key, value );
+    } else if ( key == "dup" ) {
+      netem.duplicate = parse_probability( key, value );
+    } else if ( key == "gemodel" ) {
+      double* const fields[] = { &netem.ge_p, &netem.ge_r, &netem.ge_loss_bad, &netem.ge_loss_good };
+      size_t field = 0;
+      size_t start = 0;
+      while ( true ) {
+        if ( field == size( fields ) ) {
+          bad_value( key, value, "<p>[:<r>[:<loss_bad>[:<loss_good>]]]" );
+        }
+        const size_t colon = min( value.find( ':', start ), value.size() );
+        *fields[field++] = parse_probability( key, value.substr( start, colon - start ) );
+        if ( colon == value.size() ) {
+          break;
+        }
+        start = colon + 1;
+      }
+    } else if ( key == "seed" ) {
+      netem.seed = parse_amount( key, value );
+    } else {
+      throw runtime_error( "netem: unrecognized parameter \"" + key + "\"" );
+    }
+  }
+
+  return netem;
+}
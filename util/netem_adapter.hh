@@ -0,0 +1,241 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief Parse a comma-separated list of impairments, as given to tcp_ipv4's -N option
+//! \details The items are delay=<ms>, jitter=<ms>, rate=<bit/s>, burst=<bytes>, limit=<segments>, red,
+//! reorder=<p>, dup=<p>, gemodel=<p>[:<r>[:<loss_bad>[:<loss_good>]]] and seed=<n>.
+//! Throws std::runtime_error on an unknown item, a value that is not a number, a delay, rate, size or seed that
+//! is negative or not a whole number, or a probability outside [0, 1].
+NetEmConfig parse_netem( const std::string& spec );
+
+//! \brief An adapter class that makes the uplink of an FD adapter behave like an impaired network path
+//! \details Each segment written goes through Gilbert-Elliott loss, duplication, a bounded queue (tail drop,
+//! optionally RED) in front of a token bucket that caps the bandwidth, and a delay line (delay +/- jitter,
+//! unless the segment is picked to be reordered), before it is written to the underlying adapter. The
+//! impairments are set by FdAdapterConfig::netem.
+//!
+//! Like Linux's netem qdisc, only outgoing segments are impaired; reads pass straight through. To impair both
+//! directions, give each peer its own NetEmAdapter. Time advances only with tick(), so delays and the token
+//! bucket are only as fine-grained as the ticks.
+template<typename AdapterT>
+class NetEmAdapter
+{
+private:
+  //! A segment waiting in the delay line
+  struct Delayed
+  {
+    uint64_t release_ms; //!< Time at which it may be written
+    TCPMessage msg;
+  };
+
+  //! Bytes on the wire per segment, in addition to its payload (IPv4 and TCP headers)
+  static constexpr size_t HEADER_OVERHEAD = 40;
+
+  //! Weight of the current queue length in RED's moving average
+  static constexpr double RED_WEIGHT = 0.05;
+
+  //! RED's drop probability when the average queue length reaches its upper threshold
+  static constexpr double RED_MAX_P = 0.1;
+
+  //! The underlying FD adapter
+  AdapterT _adapter;
+
+  //! Fast RNG used for every random decision
+  std::default_random_engine _rand {
+    _netem().seed != 0
+      ? std::default_random_engine( static_cast<std::default_random_engine::result_type>( _netem().seed ) )
+      : get_random_engine() };
+
+  uint64_t _now_ms {};              //!< Sum of all tick() calls
+  uint64_t _last_release_ms {};     //!< Release time of the last delayed segment (so jitter keeps the order)
+  std::optional<double> _tokens {}; //!< Bytes the token bucket can send now (filled on first use)
+  double _red_average {};           //!< Moving average of the queue length
+  bool _ge_bad {};                  //!< Is the Gilbert-Elliott chain in its bad state?
+
+  std::deque<TCPMessage> _queue {};   //!< Segments waiting for tokens
+  std::deque<Delayed> _delay_line {}; //!< Segments waiting for their release time, in release order
+  std::vector<TCPMessage> _ready {};  //!< Segments to write to the underlying adapter
+
+  const NetEmConfig& _netem() const { return _adapter.config().netem; }
+
+  //! \returns `true` with probability `p`
+  bool _chance( const double p ) { return p > 0 and std::uniform_real_distribution<double> {}( _rand ) < p; }
+
+  //! Token-bucket depth, in bytes (at least one full segment, so the bucket can't stall)
+  double _bucket_depth() const
+  {
+    const auto& cfg = _netem();
+    const uint64_t depth = cfg.burst != 0 ? cfg.burst : cfg.rate / 8 / 100;
+    return static_cast<double>( std::max<uint64_t>( depth, TCPConfig::MAX_PAYLOAD_SIZE + HEADER_OVERHEAD ) );
+  }
+
+  //! \brief Step the Gilbert-Elliott chain
+  //! \returns `true` if the segment is lost
+  bool _ge_lost()
+  {
+    const auto& cfg = _netem();
+    _ge_bad = _ge_bad ? not _chance( cfg.ge_r ) : _chance( cfg.ge_p );
+    return _chance( _ge_bad ? cfg.ge_loss_bad : cfg.ge_loss_good );
+  }
+
+  //! \brief Decide whether a segment may join the queue
+  //! \details RED drops with a probability rising linearly from 0 to RED_MAX_P as the average queue length
+  //! goes from a quarter to three quarters of the limit, and always drops above that.
+  //! \returns `true` if the segment should be dropped
+  bool _queue_drop()
+  {
+    const auto& cfg = _netem();
+    const auto length = static_cast<double>( _queue.size() );
+    _red_average += RED_WEIGHT * ( length - _red_average );
+
+    if ( _queue.size() >= cfg.queue_limit ) {
+      return true;
+    }
+    if ( not cfg.red ) {
+      return false;
+    }
+
+    const double min_threshold = static_cast<double>( cfg.queue_limit ) / 4;
+    const double max_threshold = 3 * min_threshold;
+    if ( _red_average < min_threshold ) {
+      return false;
+    }
+    if ( _red_average >= max_threshold ) {
+      return true;
+    }
+    return _chance( RED_MAX_P * ( _red_average - min_threshold ) / ( max_threshold - min_threshold ) );
+  }
+
+  //! Pass a copy of the segment through loss and duplication into the queue
+  void _enqueue( const TCPMessage& seg )
+  {
+    if ( _ge_lost() ) {
+      return;
+    }
+
+    const int copies = _chance( _netem().duplicate ) ? 2 : 1;
+    for ( int i = 0; i < copies; ++i ) {
+      // without a bandwidth cap, the queue is always emptied straight away
+      if ( _netem().rate == 0 or not _queue_drop() ) {
+        // the caller's message may borrow from its sender, so keep a copy
+        _queue.push_back( { TCPSenderMessage { seg.sender.get() }, TCPReceiverMessage { seg.receiver.get() } } );
+      }
+    }
+  }
+
+  //! Move segments along as far as the token bucket and the clock allow, and write out those that are ready
+  void _advance()
+  {
+    const auto& cfg = _netem();
+    if ( not _tokens.has_value() ) {
+      _tokens = _bucket_depth();
+    }
+
+    // a segment may leave the queue while the bucket is not empty (and may leave it in debt)
+    while ( not _queue.empty() and ( cfg.rate == 0 or _tokens.value() > 0 ) ) {
+      TCPMessage msg = std::move( _queue.front() );
+      _queue.pop_front();
+      if ( cfg.rate != 0 ) {
+        _tokens.value() -= static_cast<double>( msg.sender->payload.size() + HEADER_OVERHEAD );
+      }
+
+      if ( _chance( cfg.reorder ) ) {
+        _ready.push_back( std::move( msg ) );
+        continue;
+      }
+
+      const auto jitter = static_cast<int64_t>( cfg.jitter_ms );
+      const int64_t delay = static_cast<int64_t>( cfg.delay_ms )
+                            + std::uniform_int_distribution<int64_t> { -jitter, jitter }( _rand );
+      const auto release_ms = _now_ms + static_cast<uint64_t>( std::max<int64_t>( delay, 0 ) );
+      _last_release_ms = std::max( _last_release_ms, release_ms );
+      _delay_line.push_back( { _last_release_ms, std::move( msg ) } );
+    }
+
+    while ( not _delay_line.empty() and _delay_line.front().release_ms <= _now_ms ) {
+      _ready.push_back( std::move( _delay_line.front().msg ) );
+      _delay_line.pop_front();
+    }
+
+    if ( _ready.empty() ) {
+      return;
+    }
+    if constexpr ( requires( AdapterT a, std::span<const TCPMessage> segs ) { a.write_batch( segs ); } ) {
+      _adapter.write_batch( _ready );
+    } else {
+      for ( const auto& msg : _ready ) {
+        _adapter.write( msg );
+      }
+    }
+    _ready.clear();
+  }
+
+public:
+  //! Conversion to a FileDescriptor by returning the underlying AdapterT
+  FileDescriptor& fd() { return _adapter.fd(); }
+
+  //! Construct from the adapter to impair (whose config's netem.seed, if set, seeds the random decisions)
+  explicit NetEmAdapter( AdapterT&& adapter ) : _adapter( std::move( adapter ) ) {}
+
+  //! Read from the underlying AdapterT instance
+  std::optional<TCPMessage> read() { return _adapter.read(); }
+
+  //! \brief Send a segment along the emulated path
+  //! \param[in] seg is the packet to impair and (eventually) write
+  void write( const TCPMessage& seg )
+  {
+    _enqueue( seg );
+    _advance();
+  }
+
+  //! Read a burst from the underlying AdapterT instance
+  std::vector<TCPMessage> read_batch( const size_t max )
+    requires requires( AdapterT a ) { a.read_batch( max ); }
+  {
+    return _adapter.read_batch( max );
+  }
+
+  //! Send a burst of segments along the emulated path
+  void write_batch( const std::span<const TCPMessage> segs )
+    requires requires( AdapterT a ) { a.write_batch( segs ); }
+  {
+    for ( const auto& seg : segs ) {
+      _enqueue( seg );
+    }
+    _advance();
+  }
+
+  //! Advance the clock, refill the token bucket, and release the segments that are due
+  void tick( const size_t ms_since_last_tick )
+  {
+    _now_ms += ms_since_last_tick;
+    if ( _tokens.has_value() ) {
+      const double bytes_per_ms = static_cast<double>( _netem().rate ) / 8 / 1000;
+      const double refill = bytes_per_ms * static_cast<double>( ms_since_last_tick );
+      _tokens = std::min( _bucket_depth(), _tokens.value() + refill );
+    }
+    _advance();
+    _adapter.tick( ms_since_last_tick );
+  }
+
+  //! \name
+  //! Passthrough functions to the underlying AdapterT instance
+
+  void set_listening( const bool l ) { _adapter.set_listening( l ); } //!< FdAdapterBase::set_listening passthrough
+  const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
+  FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
+};
@@ -0,0 +1,161 @@
+#include "packet_ring.hh"
+#include "exception.hh"
+
+#include <cstring>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+void PacketRing::Unmapper::operator()( char* addr ) const
+{
+  ::munmap( addr, length );
+}
+
+//! \details The RX ring is in TPACKET_V3 blocks. The kernel doesn't batch transmission into blocks, so the TX
+//! ring (mapped right after it) is an array of fixed-size slots, each a `tpacket3_hdr` followed by one frame.
+//! The socket is opened with protocol 0, so it receives nothing until bind() sets the protocol and interface:
+//! frames from other interfaces never reach the ring.
+PacketRing::PacketRing( const string& interface, const Config& config )
+  : PacketSocket( SOCK_RAW, 0 ), config_( config ), map_( nullptr, Unmapper { 0 } )
+{
+  const auto page_size = static_cast<size_t>( ::sysconf( _SC_PAGESIZE ) );
+  if ( config_.rx_block_size % page_size or config_.tx_frame_size * config_.tx_frame_count % page_size ) {
+    throw runtime_error( "PacketRing: ring sizes must be multiples of the page size" );
+  }
+
+  setsockopt( SOL_PACKET, PACKET_VERSION, int { TPACKET_V3 } );
+
+  // a malformed frame in the TX ring is skipped and its slot handed back, rather than left in
+  // TP_STATUS_WRONG_FORMAT (which stops transmission at that slot for good)
+  setsockopt( SOL_PACKET, PACKET_LOSS, int { 1 } );
+
+  tpacket_req3 rx {};
+  rx.tp_block_size = config_.rx_block_size;
+  rx.tp_block_nr = config_.rx_block_count;
+  rx.tp_frame_size = TPACKET_ALIGNMENT << 7U; // only a hint for V3, which packs frames of any size into blocks
+  rx.tp_frame_nr = rx.tp_block_size / rx.tp_frame_size * rx.tp_block_nr;
+  rx.tp_retire_blk_tov = config_.rx_timeout_ms;
+  setsockopt( SOL_PACKET, PACKET_RX_RING, rx );
+
+  tpacket_req3 tx {};
+  tx.tp_block_size = config_.tx_frame_size * config_.tx_frame_count;
+  tx.tp_block_nr = 1;
+  tx.tp_frame_size = config_.tx_frame_size;
+  tx.tp_frame_nr = config_.tx_frame_count;
+  setsockopt( SOL_PACKET, PACKET_TX_RING, tx );
+
+  const size_t length = config_.rx_block_size * config_.rx_block_count + tx.tp_block_size;
+  void* addr = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_num(), 0 );
+  if ( addr == MAP_FAILED ) {
+    throw unix_error( "mmap" );
+  }
+  map_ = { static_cast<char*>( addr ), Unmapper { length } };
+
+  sockaddr_ll link {};
+  link.sll_family = AF_PACKET;
+  link.sll_protocol = htons( ETH_P_ALL );
+  link.sll_ifindex = static_cast<int>( ::if_nametoindex( interface.c_str() ) );
+  if ( link.sll_ifindex == 0 ) {
+    throw unix_error( "if_nametoindex(" + interface + ")" );
+  }
+  bind( { reinterpret_cast<const sockaddr*>( &link ), sizeof( link ) } ); // NOLINT(*-reinterpret-cast)
+}
+
+tpacket_block_desc* PacketRing::ready_block()
+{
+  auto* block = reinterpret_cast<tpacket_block_desc*>( rx_block( rx_next_ ) ); // NOLINT(*-reinterpret-cast)
+  // the kernel fills in the block before handing it over by setting its status
+  if ( not( atomic_ref { block->hdr.bh1.block_status }.load( memory_order_acquire ) & TP_STATUS_USER ) ) {
+    return nullptr;
+  }
+  register_read();
+  return block;
+}
+
+void PacketRing::release_block( tpacket_block_desc* block )
+{
+  atomic_ref { block->hdr.bh1.block_status }.store( TP_STATUS_KERNEL, memory_order_release );
+  rx_next_ = ( rx_next_ + 1 ) % config_.rx_block_count;
+}
+
+// The frame goes right after the tpacket3_hdr: the kernel's default for a TX ring without PACKET_TX_HAS_OFF
+char* PacketRing::tx_slot( const size_t length )
+{
+  if ( length > config_.tx_frame_size - TPACKET_ALIGN( sizeof( tpacket3_hdr ) ) ) {
+    throw runtime_error( "PacketRing: frame too large for a TX slot" );
+  }
+
+  tpacket3_hdr* hdr = tx_header();
+  if ( atomic_ref { hdr->tp_status }.load( memory_order_acquire ) != TP_STATUS_AVAILABLE ) {
+    return nullptr;
+  }
+  return reinterpret_cast<char*>( hdr ) + TPACKET_ALIGN( sizeof( tpacket3_hdr ) ); // NOLINT(*-reinterpret-cast)
+}
+
+tpacket3_hdr* PacketRing::tx_header() const
+{
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  return reinterpret_cast<tpacket3_hdr*>( tx_ring() + tx_next_ * config_.tx_frame_size );
+}
+
+void PacketRing::commit_tx_slot( const size_t length )
+{
+  tpacket3_hdr* hdr = tx_header();
+  hdr->tp_len = length;
+  hdr->tp_next_offset = 0;
+  atomic_ref { hdr->tp_status }.store( TP_STATUS_SEND_REQUEST, memory_order_release );
+  tx_next_ = ( tx_next_ + 1 ) % config_.tx_frame_count;
+  ++tx_pending_;
+}
+
+bool PacketRing::send_frame( const string_view frame )
+{
+  char* slot = tx_slot( frame.size() );
+  if ( not slot ) {
+    return false;
+  }
+  memcpy( slot, frame.data(), frame.size() );
+  commit_tx_slot( frame.size() );
+  return true;
+}
+
+bool PacketRing::send_frame( const EthernetFrame& frame )
+{
+  // the header goes into a buffer from the BufferPool, and the payload buffers are borrowed, not copied
+  Serializer serializer;
+  frame.serialize( serializer );
+  const auto& buffers = serializer.contents();
+
+  size_t length = 0;
+  for ( const auto& buf : buffers ) {
+    length += buf->size();
+  }
+
+  char* slot = tx_slot( length );
+  if ( not slot ) {
+    return false;
+  }
+
+  for ( const auto& buf : buffers ) {
+    memcpy( slot, buf->data(), buf->size() );
+    slot += buf->size();
+  }
+
+  commit_tx_slot( length );
+  return true;
+}
+
+void PacketRing::flush()
+{
+  if ( tx_pending_ == 0 ) {
+    return;
+  }
+  // with a TX ring, send() transmits every slot marked TP_STATUS_SEND_REQUEST
+  CheckSystemCall( "send", ::send( fd_num(), nullptr, 0, MSG_DONTWAIT ) );
+  register_write();
+  tx_pending_ = 0;
+}
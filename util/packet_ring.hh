@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+#include "socket.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/if_packet.h>
+#include <memory>
+#include <string>
+#include <string_view>
+
+//! \brief A PacketSocket whose frames are exchanged with the kernel through memory-mapped rings
+//! \details The socket is bound to one interface (e.g. a veth) and sees every frame on it. Received frames are
+//! filled by the kernel into the blocks of a [TPACKET_V3](https://docs.kernel.org/networking/packet_mmap.html)
+//! RX ring, many frames per block, and recv_frames() hands them to the caller in place, with no system call or
+//! copy.
+//! Frames to send are copied into slots of a TX ring by send_frame(), then flush() asks the kernel to send all
+//! of them with one system call. The fd is readable when an RX block is ready.
+class PacketRing : public PacketSocket
+{
+public:
+  struct Config
+  {
+    size_t rx_block_size = 1 << 20; //!< Bytes per RX block (a multiple of the page size)
+    size_t rx_block_count = 16;     //!< Number of RX blocks
+    unsigned rx_timeout_ms = 1;     //!< The kernel hands over a partly filled RX block after this long
+    size_t tx_frame_size = 2048;    //!< Bytes per TX slot, header included (a power of two)
+    size_t tx_frame_count = 1024;   //!< Number of TX slots
+  };
+
+  //! Open a raw packet socket on interface `interface` and map its rings
+  explicit PacketRing( const std::string& interface, const Config& config );
+  explicit PacketRing( const std::string& interface ) : PacketRing( interface, Config {} ) {}
+
+  //! \brief Call `callback( std::string_view frame )` on each frame received, oldest first
+  //! \details Frames sent from this host are skipped. Each frame lives in the ring, and is only valid until the
+  //! callback returns. Returns the number of frames passed to the callback (0 if no block was ready).
+  template<typename Callback>
+  size_t recv_frames( Callback&& callback )
+  {
+    size_t count = 0;
+    for ( size_t n = 0; n < config_.rx_block_count; ++n ) {
+      tpacket_block_desc* block = ready_block();
+      if ( not block ) {
+        break;
+      }
+
+      // NOLINTBEGIN(*-reinterpret-cast)
+      const char* frame = rx_block( rx_next_ ) + block->hdr.bh1.offset_to_first_pkt;
+      for ( uint32_t i = 0; i < block->hdr.bh1.num_pkts; ++i ) {
+        const auto* hdr = reinterpret_cast<const tpacket3_hdr*>( frame );
+        const auto* link = reinterpret_cast<const sockaddr_ll*>( frame + TPACKET_ALIGN( sizeof( tpacket3_hdr ) ) );
+        if ( link->sll_pkttype != PACKET_OUTGOING ) {
+          callback( std::string_view { frame + hdr->tp_mac, hdr->tp_snaplen } );
+          ++count;
+        }
+        frame += hdr->tp_next_offset;
+      }
+      // NOLINTEND(*-reinterpret-cast)
+
+      release_block( block );
+    }
+    return count;
+  }
+
+  //! Copy a frame into the TX ring. Returns false (and copies nothing) if every slot is waiting to be sent.
+  bool send_frame( std::string_view frame );
+
+  //! Serialize an EthernetFrame straight into the TX ring. Returns false if every slot is waiting to be sent.
+  bool send_frame( const EthernetFrame& frame );
+
+  //! Ask the kernel to send the frames queued by send_frame() (without waiting for the device)
+  void flush();
+
+  const Config& config() const { return config_; }
+
+private:
+  //! Unmaps the rings
+  struct Unmapper
+  {
+    size_t length;
+    void operator()( char* addr ) const;
+  };
+
+  Config config_;
+  std::unique_ptr<char, Unmapper> map_; //!< The RX ring, followed by the TX ring
+  size_t rx_next_ {};                   //!< Next RX block to hand to the caller
+  size_t tx_next_ {};                   //!< Next TX slot to fill
+  size_t tx_pending_ {};                //!< Slots filled since the last flush()
+
+  char* rx_block( size_t i ) const { return map_.get() + i * config_.rx_block_size; }
+  char* tx_ring() const { return map_.get() + config_.rx_block_size * config_.rx_block_count; }
+
+  //! The next RX block, if the kernel has handed it over
+  tpacket_block_desc* ready_block();
+
+  //! Give an RX block back to the kernel
+  void release_block( tpacket_block_desc* block );
+
+  //! The next TX slot's header
+  tpacket3_hdr* tx_header() const;
+
+  //! The next TX slot's payload area, if the slot is free
+  char* tx_slot( size_t length );
+
+  //! Mark the slot returned by tx_slot() as ready to send
+  void commit_tx_slot( size_t length );
+};
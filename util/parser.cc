@@ -2,26 +2,27 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
 
 using namespace std;
 
 string_view Parser::BufferList::peek() const
 {
-  if ( buffer_.empty() ) {
+  if ( first_ == buffer_.size() ) {
     throw runtime_error( "peek on empty BufferList" );
   }
-  return string_view { buffer_.front().get() }.substr( skip_ );
+  return string_view { buffer_[first_].get() }.substr( skip_ );
 }
 
 void Parser::BufferList::remove_prefix( uint64_t len )
 {
-  while ( len and not buffer_.empty() ) {
+  while ( len and first_ < buffer_.size() ) {
     const uint64_t to_pop_now = min( len, peek().size() );
     skip_ += to_pop_now;
     len -= to_pop_now;
     size_ -= to_pop_now;
-    if ( skip_ == buffer_.front()->size() ) {
-      buffer_.pop_front();
+    if ( skip_ == buffer_[first_]->size() ) {
+      ++first_;
       skip_ = 0;
     }
   }
@@ -33,55 +34,66 @@ void Parser::BufferList::truncate( size_t len )
     return;
   }
 
-  if ( len == 0 ) {
-    buffer_.clear();
-    size_ = 0;
-    return;
-  }
-
   size_t size_so_far = 0;
-  auto it = buffer_.begin();
-  while ( it != buffer_.end() ) {
-    if ( size_so_far + it->get().size() < len ) {
-      size_so_far += it->get().size();
+  auto it = buffer_.begin() + static_cast<ptrdiff_t>( first_ );
+  while ( len > 0 and it != buffer_.end() ) {
+    const size_t available = it->get().size() - ( size_so_far == 0 ? skip_ : 0 );
+    if ( size_so_far + available < len ) {
+      size_so_far += available;
       ++it;
       continue;
     }
 
-    if ( size_so_far + it->get().size() == len ) {
+    if ( size_so_far + available == len ) {
       ++it;
       break;
     }
 
-    assert( !it->get().empty() );
     assert( len > size_so_far );
-    assert( len - size_so_far < it->get().size() );
-    it->get_mut().resize( len - size_so_far );
+    it->get_mut().resize( it->get().size() - available + len - size_so_far );
+    ++it;
     break;
   }
 
-  while ( it != buffer_.end() ) {
-    it = buffer_.erase( it );
+  for ( auto rest = it; rest != buffer_.end(); ++rest ) {
+    BufferPool::release( rest->release() );
+  }
+  buffer_.erase( it, buffer_.end() );
+  if ( first_ == buffer_.size() ) {
+    skip_ = 0;
   }
 
   size_ = len;
 }
 
+// Give back the buffers that have been consumed, and drop the consumed part of the first one
+void Parser::BufferList::drop_consumed()
+{
+  const auto first = buffer_.begin() + static_cast<ptrdiff_t>( first_ );
+  for ( auto it = buffer_.begin(); it != first; ++it ) {
+    BufferPool::release( it->release() );
+  }
+  buffer_.erase( buffer_.begin(), first );
+  first_ = 0;
+
+  if ( skip_ ) {
+    buffer_.front().get_mut().erase( 0, skip_ );
+    skip_ = 0;
+  }
+}
+
+//! \details The list and its buffers are handed over as they are (the first one is shifted in place if it was
+//! partly consumed), rather than copied.
 void Parser::BufferList::dump_all( vector<Ref<std::string>>& out )
 {
+  BufferPool::release( move( out ) );
   out.clear();
   if ( empty() ) {
     return;
   }
-  if ( skip_ ) {
-    out.emplace_back( buffer_.front()->substr( skip_ ) );
-  } else {
-    out.push_back( move( buffer_.front() ) );
-  }
-  buffer_.pop_front();
-  for ( auto&& x : buffer_ ) {
-    out.emplace_back( move( x ) );
-  }
+  drop_consumed();
+  out.swap( buffer_ );
+  size_ = 0;
 }
 
 vector<string_view> Parser::BufferList::buffer() const
@@ -91,14 +103,24 @@ vector<string_view> Parser::BufferList::buffer() const
   }
   vector<string_view> ret;
   ret.reserve( buffer_segment_count() );
-  auto tmp_skip = skip_;
-  for ( const auto& x : buffer_ ) {
-    ret.push_back( string_view { x.get() }.substr( tmp_skip ) );
-    tmp_skip = 0;
-  }
+  for_each( [&]( const string_view x ) { ret.push_back( x ); } );
   return ret;
 }
 
+optional<ContiguousParser> Parser::contiguous( const size_t len )
+{
+  if ( has_error() or input_.empty() or input_.size() < len ) {
+    return nullopt;
+  }
+
+  const string_view first = input_.peek();
+  if ( first.size() < len ) {
+    return nullopt;
+  }
+  input_.remove_prefix( len );
+  return ContiguousParser { first.substr( 0, len ) };
+}
+
 void Parser::string( span<char> out )
 {
   check_size( out.size() );
@@ -118,23 +140,35 @@ void Parser::concatenate_all_remaining( std::string& out )
 {
   vector<Ref<std::string>> concat;
   all_remaining( concat );
-  if ( concat.empty() ) {
+  size_t total_size = 0;
+  for ( const auto& x : concat ) {
+    total_size += x->size();
+  }
+  if ( total_size == 0 ) {
     out.clear();
+    BufferPool::release( move( concat ) );
     return;
   }
-  out = concat.front().release();
-  if ( concat.size() > 1 ) {
-    for ( auto it = concat.begin() + 1; it != concat.end(); ++it ) {
-      out.append( *it );
-    }
+
+  BufferPool::release( exchange( out, concat.front().release() ) );
+  BufferPool::reserve( out, total_size );
+  for ( auto it = concat.begin() + 1; it != concat.end(); ++it ) {
+    out.append( *it );
   }
+  BufferPool::release( move( concat ) );
+}
+
+Serializer::~Serializer()
+{
+  BufferPool::release( move( output_ ) );
+  BufferPool::release( move( buffer_ ) );
 }
 
 void Serializer::flush()
 {
   if ( not buffer_.empty() ) {
     output_.emplace_back( move( buffer_ ) );
-    buffer_.clear();
+    buffer_ = string {};
   }
 }
 
@@ -161,8 +195,20 @@ void Serializer::buffer( const vector<Ref<string>>& bufs )
   }
 }
 
+void Serializer::copy( const string_view data )
+{
+  reserve( data.size() );
+  buffer_.append( data );
+}
+
 vector<Ref<string>> Serializer::finish()
 {
   flush();
   return move( output_ );
 }
+
+const vector<Ref<string>>& Serializer::contents()
+{
+  flush();
+  return output_;
+}
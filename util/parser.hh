@@ -1,48 +1,102 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "ref.hh"
 
 #include <concepts>
 #include <cstdint>
-#include <deque>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+//! Parses big-endian integers out of one contiguous run of bytes (e.g. a header that lies within a single buffer),
+//! reading each one straight from memory after one bounds check, rather than a byte at a time through a Parser.
+class ContiguousParser
+{
+  std::string_view input_;
+  bool error_ {};
+
+public:
+  explicit ContiguousParser( std::string_view input ) : input_( input ) {}
+
+  bool has_error() const { return error_; }
+  void set_error() { error_ = true; }
+
+  template<std::unsigned_integral T>
+  void integer( T& out )
+  {
+    if ( input_.size() < sizeof( T ) ) {
+      error_ = true;
+      return;
+    }
+
+    // (one expression over all the bytes, which the compiler makes one load, and a byte swap if need be)
+    const auto* bytes = reinterpret_cast<const uint8_t*>( input_.data() ); // NOLINT(*-reinterpret-cast)
+    out = [&]<size_t... i>( std::index_sequence<i...> ) {
+      return static_cast<T>( ( ( static_cast<T>( bytes[i] ) << ( 8 * ( sizeof( T ) - 1 - i ) ) ) | ... ) );
+    }( std::make_index_sequence<sizeof( T )>() );
+    input_.remove_prefix( sizeof( T ) );
+  }
+};
+
 class Parser
 {
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<Ref<std::string>> buffer_ {};
+    std::vector<Ref<std::string>> buffer_ {}; // (from the BufferPool, which gets it back with whatever is left)
+    size_t first_ {};                         // buffers before this one have been consumed
     uint64_t skip_ {};
 
+    void drop_consumed();
+
   public:
     explicit BufferList( std::ranges::range auto&& buffers )
       requires std::is_convertible_v<decltype( std::move( *buffers.begin() ) ), Ref<std::string>>
     {
-      for ( auto&& x : buffers ) {
-        buffer_.emplace_back( std::move( x ) );
-        if ( buffer_.back().is_borrowed() ) {
+      // a list of buffers given up by the caller is kept as it is
+      if constexpr ( std::is_same_v<decltype( buffers ), std::vector<Ref<std::string>>&&> ) {
+        buffer_ = std::move( buffers );
+      } else {
+        buffer_ = BufferPool::acquire_list();
+        for ( auto&& x : buffers ) {
+          buffer_.emplace_back( std::move( x ) );
+        }
+      }
+      for ( const auto& x : buffer_ ) {
+        if ( x.is_borrowed() ) {
           throw std::runtime_error( "cannot parse borrowed string" );
         }
-        size_ += buffer_.back()->size();
+        size_ += x->size();
       }
     }
 
+    ~BufferList() { BufferPool::release( std::move( buffer_ ) ); }
+    BufferList( const BufferList& other ) = delete;
+    BufferList& operator=( const BufferList& other ) = delete;
+
     uint64_t size() const { return size_; }
     uint64_t serialized_length() const { return size(); }
     bool empty() const { return size_ == 0; }
-    size_t buffer_segment_count() const { return buffer_.size(); }
+    size_t buffer_segment_count() const { return buffer_.size() - first_; }
 
     std::string_view peek() const;
     void remove_prefix( uint64_t len );
     void truncate( size_t len );
     void dump_all( std::vector<Ref<std::string>>& out );
     std::vector<std::string_view> buffer() const;
+
+    void for_each( auto&& f ) const
+    {
+      for ( size_t i = first_; i < buffer_.size(); ++i ) {
+        f( std::string_view { buffer_[i].get() }.substr( i == first_ ? skip_ : 0 ) );
+      }
+    }
   };
 
   BufferList input_;
@@ -66,6 +120,27 @@ public:
   void all_remaining( std::vector<Ref<std::string>>& out ) { input_.dump_all( out ); }
   std::vector<std::string_view> buffer() const { return input_.buffer(); }
 
+  //! Call `f( std::string_view )` on each remaining buffer in turn (like buffer(), but without making a list)
+  void for_each_buffer( auto&& f ) const { input_.for_each( f ); }
+
+  //! If the next `len` bytes are all in one buffer, consume them and return a ContiguousParser over them (valid
+  //! until the Parser gives up its buffers, e.g. in all_remaining); otherwise return nothing and consume nothing.
+  std::optional<ContiguousParser> contiguous( size_t len );
+
+  //! Call `read( parser )` to parse a fixed-size header of `len` bytes: with a ContiguousParser when they are all
+  //! in one buffer (the usual case, checked once for the whole header), otherwise with this Parser.
+  void fixed( const size_t len, auto&& read )
+  {
+    if ( auto header = contiguous( len ) ) {
+      read( *header );
+      if ( header->has_error() ) {
+        set_error();
+      }
+    } else {
+      read( *this );
+    }
+  }
+
   void string( std::span<char> out );
   void concatenate_all_remaining( std::string& out );
 
@@ -92,19 +167,32 @@ public:
   }
 };
 
+//! Serializes into buffers from the BufferPool. Small fields and copies accumulate in one buffer, so a header and
+//! the payload copied after it (see copy()) make one contiguous buffer.
 class Serializer
 {
-  std::vector<Ref<std::string>> output_ {};
+  std::vector<Ref<std::string>> output_ { BufferPool::acquire_list() };
   std::string buffer_ {};
 
   void flush();
 
 public:
+  Serializer() = default;
+  ~Serializer();
+  Serializer( const Serializer& other ) = delete;
+  Serializer& operator=( const Serializer& other ) = delete;
+
+  //! Make room to serialize `len` more bytes into the current buffer
+  void reserve( size_t len ) { BufferPool::reserve( buffer_, buffer_.size() + len ); }
+
   template<std::unsigned_integral T>
   void integer( const T val )
   {
     constexpr uint64_t len = sizeof( T );
 
+    if ( buffer_.size() + len > buffer_.capacity() ) {
+      reserve( len );
+    }
     for ( uint64_t i = 0; i < len; ++i ) {
       const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
       buffer_.push_back( byte_val );
@@ -114,5 +202,12 @@ public:
   void buffer( std::string buf );
   void buffer( Ref<std::string> buf );
   void buffer( const std::vector<Ref<std::string>>& bufs );
+
+  //! Copy `data` into the current buffer, after whatever is already there
+  void copy( std::string_view data );
+
   std::vector<Ref<std::string>> finish();
+
+  //! What has been serialized so far, still owned by the Serializer (which gives it back to the pool)
+  const std::vector<Ref<std::string>>& contents();
 };
@@ -2,6 +2,7 @@
 
 #include "exception.hh"
 
+#include <cstring>
 #include <linux/if_packet.h>
 #include <stdexcept>
 
@@ -147,6 +148,120 @@ void DatagramSocket::send( const string_view payload )
   register_write();
 }
 
+DatagramBatch::DatagramBatch( const size_t capacity, const size_t max_datagram_size )
+  : max_datagram_size_( max_datagram_size )
+  , storage_( make_unique_for_overwrite<char[]>( capacity * max_datagram_size ) )
+  , addresses_( capacity )
+  , iovecs_( capacity )
+  , headers_( capacity )
+{
+  for ( size_t i = 0; i < capacity; ++i ) {
+    iovecs_[i] = { storage_.get() + i * max_datagram_size_, max_datagram_size_ };
+    headers_[i].msg_hdr.msg_name = static_cast<sockaddr*>( addresses_[i] );
+    headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+    headers_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+bool DatagramBatch::push( const Address& destination, const string_view payload )
+{
+  if ( size_ == capacity() ) {
+    return false;
+  }
+  if ( payload.size() > max_datagram_size_ ) {
+    throw runtime_error( "DatagramBatch::push (oversized datagram)" );
+  }
+
+  payload.copy( storage_.get() + size_ * max_datagram_size_, payload.size() );
+  iovecs_[size_].iov_len = payload.size();
+  memcpy( &addresses_[size_].storage, destination.raw(), destination.size() );
+  headers_[size_].msg_hdr.msg_namelen = destination.size();
+  headers_[size_].msg_len = payload.size();
+  ++size_;
+  return true;
+}
+
+string_view DatagramBatch::payload( const size_t i ) const
+{
+  return { storage_.get() + i * max_datagram_size_, headers_.at( i ).msg_len };
+}
+
+Address DatagramBatch::address( const size_t i ) const
+{
+  return { addresses_.at( i ), headers_.at( i ).msg_hdr.msg_namelen };
+}
+
+size_t DatagramSocket::recv_batch( DatagramBatch& batch )
+{
+  batch.clear();
+  for ( size_t i = 0; i < batch.capacity(); ++i ) {
+    batch.iovecs_[i].iov_len = batch.max_datagram_size_;
+    batch.headers_[i].msg_hdr.msg_namelen = sizeof( batch.addresses_[i].storage );
+  }
+
+  // MSG_WAITFORONE: don't wait for more datagrams once one has arrived
+  const int count = CheckSystemCall(
+    "recvmmsg",
+    ::recvmmsg(
+      fd_num(), batch.headers_.data(), static_cast<unsigned>( batch.headers_.size() ), MSG_WAITFORONE, nullptr ) );
+
+  if ( count > 0 ) {
+    register_read();
+  }
+  for ( int i = 0; i < count; ++i ) {
+    if ( batch.headers_[i].msg_hdr.msg_flags & MSG_TRUNC ) { // NOLINT(*-bitwise)
+      throw runtime_error( "recvmmsg (oversized datagram)" );
+    }
+  }
+  batch.size_ = count;
+  return count;
+}
+
+size_t DatagramSocket::send_batch( DatagramBatch& batch )
+{
+  return send_messages( span { batch.headers_ }.first( batch.size() ) );
+}
+
+size_t DatagramSocket::send_batch( const Address& destination, span<const vector<Ref<string>>> datagrams )
+{
+  vector<iovec> iovecs;
+  vector<mmsghdr> msgs( datagrams.size() );
+
+  size_t total_buffers = 0;
+  for ( const auto& buffers : datagrams ) {
+    total_buffers += buffers.size();
+  }
+  iovecs.reserve( total_buffers );
+
+  for ( size_t i = 0; i < datagrams.size(); ++i ) {
+    msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>( destination.raw() ); // NOLINT(*-const-cast)
+    msgs[i].msg_hdr.msg_namelen = destination.size();
+    msgs[i].msg_hdr.msg_iov = iovecs.data() + iovecs.size();
+    msgs[i].msg_hdr.msg_iovlen = datagrams[i].size();
+    for ( const auto& buf : datagrams[i] ) {
+      iovecs.push_back( { const_cast<char*>( buf->data() ), buf->size() } ); // NOLINT(*-const-cast)
+    }
+  }
+
+  return send_messages( msgs );
+}
+
+size_t DatagramSocket::send_messages( const span<mmsghdr> msgs )
+{
+  // sendmmsg stops early if the send buffer fills up
+  size_t sent = 0;
+  while ( sent < msgs.size() ) {
+    const int count = CheckSystemCall(
+      "sendmmsg", ::sendmmsg( fd_num(), msgs.data() + sent, static_cast<unsigned>( msgs.size() - sent ), 0 ) );
+    if ( count == 0 ) {
+      break; // would block
+    }
+    register_write();
+    sent += count;
+  }
+  return sent;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
@@ -209,6 +324,10 @@ void Socket::throw_if_error() const
   }
 }
 
+// option types set from other translation units (e.g. by PacketRing)
+template void Socket::setsockopt( int level, int option, const int& option_value );
+template void Socket::setsockopt( int level, int option, const tpacket_req3& option_value );
+
 void PacketSocket::set_promiscuous()
 {
   setsockopt( SOL_PACKET,
@@ -4,7 +4,12 @@
 #include "file_descriptor.hh"
 
 #include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -57,6 +62,54 @@ public:
   void throw_if_error() const;
 };
 
+//! \brief A reusable set of datagram buffers, and the [mmsghdr](\ref man2::recvmmsg)s that point into them
+//! \details Everything is allocated once, in the constructor, so a DatagramSocket can receive or send a batch
+//! of datagrams (each with its own address) with one system call and no allocation or zero-filling per batch.
+//! After DatagramSocket::recv_batch, the first size() slots hold the datagrams received. To send, push() the
+//! datagrams (which copies them into the slots) and call DatagramSocket::send_batch, as often as needed.
+class DatagramBatch
+{
+public:
+  //! Default size of each slot (the largest datagram DatagramSocket::recv accepts)
+  static constexpr size_t DEFAULT_MAX_DATAGRAM_SIZE = 16384;
+
+  //! Make `capacity` slots, each able to hold a datagram of up to `max_datagram_size` bytes
+  explicit DatagramBatch( size_t capacity = 0, size_t max_datagram_size = DEFAULT_MAX_DATAGRAM_SIZE );
+
+  size_t capacity() const { return headers_.size(); }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  //! Forget the datagrams held
+  void clear() { size_ = 0; }
+
+  //! Add a datagram to send to `destination`. Returns false (and does nothing) if every slot is in use.
+  bool push( const Address& destination, std::string_view payload );
+
+  //! The i-th datagram's payload
+  std::string_view payload( size_t i ) const;
+
+  //! The i-th datagram's source (after recv_batch) or destination (after push)
+  Address address( size_t i ) const;
+
+  DatagramBatch( DatagramBatch&& other ) noexcept = default;
+  DatagramBatch& operator=( DatagramBatch&& other ) noexcept = default;
+  DatagramBatch( const DatagramBatch& other ) = delete;
+  DatagramBatch& operator=( const DatagramBatch& other ) = delete;
+  ~DatagramBatch() = default;
+
+private:
+  friend class DatagramSocket;
+
+  size_t max_datagram_size_;
+  std::unique_ptr<char[]> storage_;     //!< Slot i's payload is at offset i * max_datagram_size_ (on the heap,
+                                        //!< so the iovecs still point at it after a move)
+  std::vector<Address::Raw> addresses_; //!< Slot i's source or destination
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  size_t size_ {};
+};
+
 class DatagramSocket : public Socket
 {
 public:
@@ -69,9 +122,25 @@ public:
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
 
+  //! Receive up to `batch.capacity()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg), waiting only for the
+  //! first, replacing the batch's contents. Returns the number received (0 if the socket is non-blocking and
+  //! nothing is waiting).
+  size_t recv_batch( DatagramBatch& batch );
+
+  //! Send the datagrams pushed onto `batch`, each to its own address, with [sendmmsg(2)](\ref man2::sendmmsg).
+  //! Returns the number sent, fewer than `batch.size()` if a non-blocking socket's send buffer is full.
+  size_t send_batch( DatagramBatch& batch );
+
+  //! Send each datagram (a list of buffers) to `destination` with one [sendmmsg(2)](\ref man2::sendmmsg).
+  //! Returns the number sent, fewer than requested if a non-blocking socket's send buffer is full.
+  size_t send_batch( const Address& destination, std::span<const std::vector<Ref<std::string>>> datagrams );
+
 protected:
   DatagramSocket( int domain, int type, int protocol = 0 ) : Socket( domain, type, protocol ) {}
 
+  //! Call sendmmsg until every message is sent or the send buffer is full, returning the number sent
+  size_t send_messages( std::span<mmsghdr> msgs );
+
   //! Construct from a file descriptor.
   DatagramSocket( FileDescriptor&& fd, int domain, int type, int protocol = 0 )
     : Socket( std::move( fd ), domain, type, protocol )
@@ -0,0 +1,60 @@
+#include "stream_ring.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+StreamRing::StreamRing( const uint64_t capacity, const size_t max_chunks )
+  : capacity_( capacity ), slots_( max_chunks + 1 )
+{}
+
+uint64_t StreamRing::available_capacity() const
+{
+  const size_t t = tail_.load( memory_order_relaxed );
+  if ( ( t + 1 ) % slots_.size() == head_.load( memory_order_acquire ) ) {
+    return 0;
+  }
+  return capacity_
+         - ( bytes_pushed_.load( memory_order_relaxed ) - bytes_popped_.load( memory_order_acquire ) );
+}
+
+size_t StreamRing::push( const string_view data )
+{
+  if ( is_abandoned() ) {
+    return data.size();
+  }
+
+  const size_t len = min<uint64_t>( data.size(), available_capacity() );
+  if ( len == 0 ) {
+    return 0;
+  }
+
+  const size_t t = tail_.load( memory_order_relaxed );
+  slots_[t].assign( data.substr( 0, len ) );
+  bytes_pushed_.store( bytes_pushed_.load( memory_order_relaxed ) + len, memory_order_relaxed );
+  tail_.store( ( t + 1 ) % slots_.size(), memory_order_release );
+  return len;
+}
+
+void StreamRing::close()
+{
+  closed_.store( true, memory_order_release );
+}
+
+bool StreamRing::pop( string& chunk )
+{
+  const size_t h = head_.load( memory_order_relaxed );
+  if ( h == tail_.load( memory_order_acquire ) ) {
+    return false;
+  }
+
+  chunk.swap( slots_[h] );
+  bytes_popped_.store( bytes_popped_.load( memory_order_relaxed ) + chunk.size(), memory_order_release );
+  head_.store( ( h + 1 ) % slots_.size(), memory_order_release );
+  return true;
+}
+
+bool StreamRing::empty() const
+{
+  return head_.load( memory_order_relaxed ) == tail_.load( memory_order_acquire );
+}
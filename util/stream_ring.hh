@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! \brief A one-way byte stream between two threads of one process, through a bounded ring of chunks
+//! \details One thread (the writer) copies bytes into the ring's slots, and the other (the reader) takes each
+//! chunk by swapping it with a string of its own, so the bytes are copied once, no lock is taken, and neither
+//! thread makes a system call. The swapped-in string goes back to the writer as the slot's buffer, so once the
+//! slots have grown, nothing is allocated either.
+//!
+//! Like a ByteStream, the ring holds at most `capacity` bytes, and it can be closed (by the writer) or set to
+//! error. Neither side waits: pair the ring with a Doorbell to sleep until the other side makes progress.
+class StreamRing
+{
+public:
+  static constexpr size_t DEFAULT_MAX_CHUNKS = 64;
+
+  explicit StreamRing( uint64_t capacity, size_t max_chunks = DEFAULT_MAX_CHUNKS );
+
+  //! \name
+  //! Writer side
+
+  //!@{
+  //! Bytes that push() would take now (0 if every slot is full)
+  uint64_t available_capacity() const;
+
+  //! Copy as much of `data` as available_capacity() allows into the ring, as one chunk. Once the reader has
+  //! abandoned the ring, everything is taken and discarded. Returns the number of bytes taken.
+  size_t push( std::string_view data );
+
+  //! Signal that nothing more will be pushed
+  void close();
+
+  //! Signal that the stream failed
+  void set_error() { error_.store( true, std::memory_order_release ); }
+
+  //! Has the reader abandoned the ring?
+  bool is_abandoned() const { return abandoned_.load( std::memory_order_acquire ); }
+  //!@}
+
+  //! \name
+  //! Reader side
+
+  //!@{
+  //! Swap the oldest chunk into `chunk` (giving the ring `chunk`'s old buffer). Returns false if none is waiting.
+  bool pop( std::string& chunk );
+
+  //! Is no chunk waiting?
+  bool empty() const;
+
+  //! Has the writer closed the ring, with every chunk popped?
+  bool is_finished() const { return is_closed() and empty(); }
+
+  bool is_closed() const { return closed_.load( std::memory_order_acquire ); }
+  bool has_error() const { return error_.load( std::memory_order_acquire ); }
+
+  //! Signal that nothing more will be popped
+  void abandon() { abandoned_.store( true, std::memory_order_release ); }
+  //!@}
+
+private:
+  uint64_t capacity_;
+  std::vector<std::string> slots_; //!< One more than the number of chunks held, to tell full from empty
+  std::atomic<size_t> head_ {};    //!< Next slot to pop (advanced by the reader)
+  std::atomic<size_t> tail_ {};    //!< Next slot to fill (advanced by the writer)
+  std::atomic<uint64_t> bytes_pushed_ {};
+  std::atomic<uint64_t> bytes_popped_ {};
+  std::atomic_bool closed_ {};
+  std::atomic_bool error_ {};
+  std::atomic_bool abandoned_ {};
+};
@@ -21,6 +21,38 @@ public:
   Wrap32 isn { 137 };                      //!< Default initial sequence number
 };
 
+//! Path impairments applied to outgoing segments (for NetEmAdapter)
+class NetEmConfig
+{
+public:
+  uint64_t delay_ms = 0;  //!< One-way delay, in milliseconds
+  uint64_t jitter_ms = 0; //!< Each segment's delay varies uniformly within +/- jitter_ms (without reordering)
+
+  uint64_t rate = 0;         //!< Bandwidth cap, in bits per second (0 means unlimited)
+  uint64_t burst = 0;        //!< Token-bucket depth, in bytes (0 means 10 ms worth at `rate`)
+  size_t queue_limit = 1000; //!< Segments that can wait for tokens; beyond this, segments are tail-dropped
+  bool red = false;          //!< Also drop early, with Random Early Detection, as the queue fills
+
+  double reorder = 0;   //!< Probability that a segment skips the delay (and so overtakes earlier ones)
+  double duplicate = 0; //!< Probability that a segment is sent twice
+
+  // Gilbert-Elliott burst loss: a two-state Markov chain, stepped once per segment, with a loss probability
+  // in each state
+  double ge_p = 0;         //!< Probability of moving from the good state to the bad state
+  double ge_r = 1;         //!< Probability of moving from the bad state back to the good state
+  double ge_loss_good = 0; //!< Loss probability in the good state
+  double ge_loss_bad = 1;  //!< Loss probability in the bad state
+
+  uint64_t seed = 0; //!< Seed for the random decisions, for a repeatable run (0 picks a random seed)
+
+  //! Does this config impair anything?
+  bool enabled() const
+  {
+    return delay_ms != 0 or jitter_ms != 0 or rate != 0 or reorder != 0 or duplicate != 0 or ge_p != 0
+           or ge_loss_good != 0;
+  }
+};
+
 //! Config for classes derived from FdAdapter
 class FdAdapterConfig
 {
@@ -30,4 +62,8 @@ public:
 
   uint16_t loss_rate_dn = 0; //!< Downlink loss rate (for LossyFdAdapter)
   uint16_t loss_rate_up = 0; //!< Uplink loss rate (for LossyFdAdapter)
+
+  NetEmConfig netem {}; //!< Impairments of the uplink (for NetEmAdapter)
+
+  unsigned read_burst = 64; //!< Max datagrams read from the adapter per event-loop wakeup
 };
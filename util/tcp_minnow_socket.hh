@@ -1,20 +1,112 @@
 #pragma once
 
+#include "eventfd.hh"
 #include "eventloop.hh"
 #include "file_descriptor.hh"
+#include "loopback_adapter.hh"
 #include "socket.hh"
+#include "stream_ring.hh"
 #include "tcp_config.hh"
+#include "tcp_over_udp.hh"
 #include "tcp_peer.hh"
 #include "tuntap_adapter.hh"
 
 #include <atomic>
 #include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
+
+//! \brief The thread that runs a TCPPeer behind a socket front end
+//! \details It owns the datagram adapter and the TCPPeer, and runs the EventLoop that carries segments between
+//! them. The front end (TCPMinnowSocket or TCPMinnowRingSocket) adds the rules that carry bytes between the
+//! TCPPeer's streams and the owner.
+template<TCPDatagramAdapter AdaptT>
+class TCPPeerThread
+{
+public:
+  //! Connect using the specified configurations; blocks until connect succeeds or fails
+  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
+  //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
+  void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
+  // Return peer address from underlying datagram adapter
+  const Address& peer_address() const { return _datagram_adapter.config().destination; }
+
+  TCPPeerThread( const TCPPeerThread& ) = delete;
+  TCPPeerThread( TCPPeerThread&& ) = delete;
+  TCPPeerThread& operator=( const TCPPeerThread& ) = delete;
+  TCPPeerThread& operator=( TCPPeerThread&& ) = delete;
+
+protected:
+  //! Construct from the interface that the TCPPeer thread will use to read and write datagrams
+  explicit TCPPeerThread( AdaptT&& datagram_interface );
+
+  //! The front end must call _stop() (which uses its rules) before its members are destroyed
+  virtual ~TCPPeerThread() = default;
+
+  //! Adapter to underlying datagram socket (e.g., UDP or IP)
+  AdaptT _datagram_adapter;
+
+  //! TCP state machine
+  std::optional<TCPPeer> _tcp {};
+
+  //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
+  EventLoop _eventloop {};
+
+  bool _inbound_shutdown { false }; //!< Has the front end shut down the incoming data to the owner?
+
+  bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
+
+  //! Call a TCPPeer method that transmits (e.g. push or tick), then write everything it transmitted
+  //! to the datagram adapter (as one burst, if the adapter supports it)
+  void _transmit( const std::function<void( const TCPPeer::TransmitFunction& )>& tcp_call );
+
+  //! Wait for the TCPPeer thread to finish
+  void _join();
+
+  //! Force the TCPPeer thread to shut down, if it is still running
+  void _stop();
+
+  //! Add the rules that carry bytes between the owner and the TCPPeer's streams
+  virtual void _add_stream_rules() = 0;
+
+  //! Called after segments are received (their ACKs may have made room in the outbound stream, and their
+  //! payloads filled the inbound stream)
+  virtual void _after_receive() = 0;
+
+  //! Tell the owner that the connection is over
+  virtual void _close_owner_streams() = 0;
+
+private:
+  //! Set up the TCPPeer and the event loop
+  void _initialize_TCP( const TCPConfig& config );
+
+  //! Process events while specified condition is true
+  void _tcp_loop( const std::function<bool()>& condition );
+
+  //! Segments collected by _transmit, reused between bursts
+  std::vector<TCPMessage> _outbound_burst {};
+
+  //! Main loop of TCPPeer thread
+  void _tcp_main();
+
+  //! Handle to the TCPPeer thread; owner thread calls join() in the destructor
+  std::thread _tcp_thread {};
+
+  std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
+
+  bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+};
 
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<TCPDatagramAdapter AdaptT>
-class TCPMinnowSocket : public LocalStreamSocket
+class TCPMinnowSocket
+  : public LocalStreamSocket
+  , public TCPPeerThread<AdaptT>
 {
 public:
   //! Construct from the interface that the TCPPeer thread will use to read and write datagrams
@@ -25,14 +117,11 @@ public:
   //! or else may wait foreever for remote peer to close the TCP connection.
   void wait_until_closed();
 
-  //! Connect using the specified configurations; blocks until connect succeeds or fails
-  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
-
-  //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
-  void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+  using TCPPeerThread<AdaptT>::connect;
+  using TCPPeerThread<AdaptT>::peer_address;
 
   //! When a connected socket is destructed, it will send a RST
-  ~TCPMinnowSocket();
+  ~TCPMinnowSocket() override;
 
   //! \name
   //! This object cannot be safely moved or copied, since it is in use by two threads simultaneously
@@ -53,49 +142,207 @@ public:
   void set_reuseaddr() = delete;
   //!@}
 
+private:
+  using TCPPeerThread<AdaptT>::_tcp;
+  using TCPPeerThread<AdaptT>::_eventloop;
+  using TCPPeerThread<AdaptT>::_datagram_adapter;
+  using TCPPeerThread<AdaptT>::_inbound_shutdown;
+  using TCPPeerThread<AdaptT>::_outbound_shutdown;
+  using TCPPeerThread<AdaptT>::_transmit;
+
+  //! Stream socket for reads and writes between owner and TCP thread
+  LocalStreamSocket _thread_data;
+
+  //! Write as much of the inbound stream as the owner will take, sending a window update if that reopened it
+  void _deliver_inbound();
+
+  void _add_stream_rules() override;
+  void _after_receive() override;
+  void _close_owner_streams() override { shutdown( SHUT_RDWR ); }
+
+  //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
+  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
+};
+
+//! \brief Wrapper around TCPPeer with the same API as TCPMinnowSocket, whose owner shares memory with the
+//! TCPPeer thread instead of a socketpair
+//! \details Bytes move through a StreamRing in each direction: write() copies into a slot that the TCPPeer
+//! thread pushes into the outbound stream, and the TCPPeer thread copies the inbound stream into a slot that
+//! read() swaps out. Each thread sleeps on a Doorbell when it runs out of work, so a system call is only made
+//! to wake one that is actually asleep, rather than two for every chunk.
+//!
+//! Like the TCPMinnowSocket, reads and writes never block. Instead of being a file descriptor, it has fd(),
+//! which becomes readable when read() or write() may be able to make progress (e.g. for an EventLoop rule).
+template<TCPDatagramAdapter AdaptT>
+class TCPMinnowRingSocket : public TCPPeerThread<AdaptT>
+{
+public:
+  //! Construct from the interface that the TCPPeer thread will use to read and write datagrams, with rings
+  //! that hold up to `ring_capacity` bytes in each direction
+  explicit TCPMinnowRingSocket( AdaptT&& datagram_interface, uint64_t ring_capacity = DEFAULT_RING_CAPACITY );
+
+  static constexpr uint64_t DEFAULT_RING_CAPACITY = 1 << 18;
+
+  //! Read the bytes waiting in the inbound stream (none if nothing is waiting; sets eof() at the end)
+  void read( std::string& buffer );
+
+  //! Write as much of `buffer` as there is room for in the outbound stream; returns the number of bytes written
+  size_t write( std::string_view buffer );
+
+  //! Has the inbound stream ended?
+  bool eof() const { return _eof; }
+
+  //! Did the inbound stream end with an error (e.g. because the peer reset the connection)?
+  bool has_error() const { return _eof and _inbound_ring.has_error(); }
+
+  //! Shut down the outbound stream (SHUT_WR), stop reading the inbound stream (SHUT_RD), or both (SHUT_RDWR)
+  void shutdown( int how );
+
+  //! Readable when read() or write() may be able to make progress
+  FileDescriptor& fd() { return _owner_doorbell.fd(); }
+
+  //! Shut down both streams, and wait for TCPPeer to finish
+  //! \note As with TCPMinnowSocket, only advisable once the inbound stream has reached EOF
+  void wait_until_closed();
+
+  //! When a connected socket is destructed, it will send a RST
+  ~TCPMinnowRingSocket() override;
+
+  TCPMinnowRingSocket( const TCPMinnowRingSocket& ) = delete;
+  TCPMinnowRingSocket( TCPMinnowRingSocket&& ) = delete;
+  TCPMinnowRingSocket& operator=( const TCPMinnowRingSocket& ) = delete;
+  TCPMinnowRingSocket& operator=( TCPMinnowRingSocket&& ) = delete;
+
+private:
+  using TCPPeerThread<AdaptT>::_tcp;
+  using TCPPeerThread<AdaptT>::_eventloop;
+  using TCPPeerThread<AdaptT>::_inbound_shutdown;
+  using TCPPeerThread<AdaptT>::_outbound_shutdown;
+  using TCPPeerThread<AdaptT>::_transmit;
+
+  StreamRing _outbound_ring; //!< Owner to TCPPeer thread
+  StreamRing _inbound_ring;  //!< TCPPeer thread to owner
+  Doorbell _owner_doorbell {};
+  Doorbell _tcp_doorbell {};
+
+  std::string _read_scratch {};   //!< Holds chunks appended to the first one in read()
+  std::string _outbound_chunk {}; //!< (TCPPeer thread) Bytes taken from the owner that didn't fit the stream yet
+  bool _eof {};
+
+  //! Move bytes from the owner into the outbound stream, and push them
+  void _pull_outbound();
+
+  //! Move bytes from the inbound stream to the owner, sending a window update if that reopened it
+  void _deliver_inbound();
+
+  void _add_stream_rules() override;
+  void _after_receive() override;
+  void _close_owner_streams() override;
+};
+
+//! \brief Wrapper around TCPPeer with the same stream API as TCPMinnowSocket, but no TCPPeer thread
+//! \details Run to completion: the owner's own event loop drives the TCPPeer. read() and write() call into
+//! the TCPPeer directly, and the owner polls fd() (for POLLIN, at most timeout_ms() at a time) and then calls
+//! process(), which takes in the segments waiting on the adapter and advances the TCPPeer's clock. Nothing
+//! crosses to another thread, so a request and its response cost no context switches beyond the owner's own
+//! poll().
+//!
+//! Only connect(), listen_and_accept() and wait_until_closed() block (running the same loop themselves).
+template<TCPDatagramAdapter AdaptT>
+class TCPMinnowInlineSocket
+{
+public:
+  //! Construct from the interface to read and write datagrams with
+  explicit TCPMinnowInlineSocket( AdaptT&& datagram_interface );
+
+  //! Connect using the specified configurations; blocks until connect succeeds or fails
+  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
+  //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
+  void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
-protected:
-  //! Adapter to underlying datagram socket (e.g., UDP or IP)
-  AdaptT _datagram_adapter;
+  //! Read the bytes waiting in the inbound stream (none if nothing is waiting; sets eof() at the end)
+  void read( std::string& buffer );
 
-private:
-  //! Stream socket for reads and writes between owner and TCP thread
-  LocalStreamSocket _thread_data;
+  //! Write as much of `buffer` as there is room for in the outbound stream, and send what the TCPPeer can;
+  //! returns the number of bytes written
+  size_t write( std::string_view buffer );
 
-  //! Set up the TCPPeer and the event loop
-  void _initialize_TCP( const TCPConfig& config );
+  //! Has the inbound stream ended?
+  bool eof() const { return _eof; }
 
-  //! TCP state machine
-  std::optional<TCPPeer> _tcp {};
+  //! Did the inbound stream end with an error (e.g. because the peer reset the connection)?
+  bool has_error() const { return _eof and _tcp->inbound_reader().has_error(); }
 
-  //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
-  EventLoop _eventloop {};
+  //! Shut down the outbound stream (SHUT_WR), stop reading the inbound stream (SHUT_RD), or both (SHUT_RDWR)
+  void shutdown( int how );
 
-  //! Process events while specified condition is true
-  void _tcp_loop( const std::function<bool()>& condition );
+  //! Readable when segments are waiting to be process()ed
+  FileDescriptor& fd() { return _datagram_adapter.fd(); }
 
-  //! Main loop of TCPPeer thread
-  void _tcp_main();
+  //! How long (in milliseconds) the owner may wait on fd() before it must call process(); -1 once the
+  //! connection is over
+  int timeout_ms() const;
 
-  //! Handle to the TCPPeer thread; owner thread calls join() in the destructor
-  std::thread _tcp_thread {};
+  //! Take in the segments waiting on fd() (without blocking), reply to them, and run the TCPPeer's timers
+  void process();
 
-  //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
+  //! Is the connection still open (or lingering to make sure the peer has finished)?
+  bool active() const { return _tcp.has_value() and _tcp->active(); }
 
-  std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
+  //! Shut down both streams, and run the connection until it finishes
+  //! \note As with TCPMinnowSocket, only advisable once the inbound stream has reached EOF
+  void wait_until_closed();
 
-  bool _inbound_shutdown { false }; //!< Has TCPMinnowSocket shut down the incoming data to the owner?
+  //! When a connected socket is destructed, it will send a RST
+  ~TCPMinnowInlineSocket();
 
-  bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
+  TCPMinnowInlineSocket( const TCPMinnowInlineSocket& ) = delete;
+  TCPMinnowInlineSocket( TCPMinnowInlineSocket&& ) = delete;
+  TCPMinnowInlineSocket& operator=( const TCPMinnowInlineSocket& ) = delete;
+  TCPMinnowInlineSocket& operator=( TCPMinnowInlineSocket&& ) = delete;
 
-  bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+private:
+  //! Adapter to underlying datagram socket (e.g., UDP or IP)
+  AdaptT _datagram_adapter;
+
+  //! TCP state machine
+  std::optional<TCPPeer> _tcp {};
+
+  uint64_t _last_tick_ms {}; //!< When process() last advanced the TCPPeer's clock
+  bool _eof {};
+  bool _inbound_shutdown {}; //!< Has the owner stopped reading the inbound stream?
+
+  //! Segments collected by _transmit, reused between bursts
+  std::vector<TCPMessage> _outbound_burst {};
+
+  //! Call a TCPPeer method that transmits, then write everything it transmitted (as one burst, if the
+  //! adapter supports it)
+  void _transmit( const std::function<void( const TCPPeer::TransmitFunction& )>& tcp_call );
+
+  //! Set up the TCPPeer
+  void _initialize_TCP( const TCPConfig& config );
+
+  //! Wait on fd() and process(), while the condition is true and the connection is active
+  void _run_while( const std::function<bool()>& condition );
 };
 
 using TCPOverIPv4MinnowSocket = TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
 using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
+using TCPOverUDPMinnowSocket = TCPMinnowSocket<TCPOverUDPAdapter>;
+using LossyTCPOverUDPMinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverUDPAdapter>>;
+using NetEmTCPOverIPv4MinnowSocket = TCPMinnowSocket<NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>>;
+using NetEmTCPOverUDPMinnowSocket = TCPMinnowSocket<NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>>;
+using LoopbackMinnowSocket = TCPMinnowSocket<LoopbackAdapter>;
+using TCPOverIPv4MinnowRingSocket = TCPMinnowRingSocket<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverUDPMinnowRingSocket = TCPMinnowRingSocket<TCPOverUDPAdapter>;
+using LoopbackMinnowRingSocket = TCPMinnowRingSocket<LoopbackAdapter>;
+using TCPOverIPv4MinnowInlineSocket = TCPMinnowInlineSocket<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverUDPMinnowInlineSocket = TCPMinnowInlineSocket<TCPOverUDPAdapter>;
+using LoopbackMinnowInlineSocket = TCPMinnowInlineSocket<LoopbackAdapter>;
 
 //! \class TCPMinnowSocket
 //! This class involves the simultaneous operation of two threads.
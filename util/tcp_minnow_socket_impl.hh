@@ -2,9 +2,11 @@
 
 #include "exception.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <poll.h>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
@@ -21,7 +23,7 @@ inline uint64_t timestamp_ms()
 
 //! \param[in] condition is a function returning true if loop should continue
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition )
+void TCPPeerThread<AdaptT>::_tcp_loop( const std::function<bool()>& condition )
 {
   auto base_time = timestamp_ms();
   while ( condition() ) {
@@ -36,20 +38,58 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
 
     if ( _tcp.value().active() ) {
       const auto next_time = timestamp_ms();
-      _tcp.value().tick( next_time - base_time, [&]( auto x ) { _datagram_adapter.write( x ); } );
+      _transmit( [&]( const auto& transmit ) { _tcp.value().tick( next_time - base_time, transmit ); } );
       _datagram_adapter.tick( next_time - base_time );
       base_time = next_time;
     }
   }
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPPeerThread<AdaptT>::_transmit( const std::function<void( const TCPPeer::TransmitFunction& )>& tcp_call )
+{
+  if constexpr ( TCPBatchDatagramAdapter<AdaptT> ) {
+    // TCPPeer lends out its messages only for the duration of the transmit call, so keep copies
+    tcp_call( [&]( const TCPMessage& x ) {
+      _outbound_burst.push_back( { TCPSenderMessage( x.sender.get() ), TCPReceiverMessage( x.receiver.get() ) } );
+    } );
+    if ( not _outbound_burst.empty() ) {
+      _datagram_adapter.write_batch( _outbound_burst );
+      _outbound_burst.clear();
+    }
+  } else {
+    tcp_call( [&]( const TCPMessage& x ) { _datagram_adapter.write( x ); } );
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_deliver_inbound()
+{
+  Reader& inbound = _tcp->inbound_reader();
+  // Write from the inbound_stream into
+  // the pipe, handling the possibility of a partial
+  // write (i.e., only pop what was actually written).
+  if ( inbound.bytes_buffered() ) {
+    const std::string_view buffer = inbound.peek();
+    const auto bytes_written = _thread_data.write( buffer );
+    inbound.pop( bytes_written );
+    _transmit( [&]( const auto& transmit ) { _tcp->update_window( transmit ); } );
+  }
+}
+
+//! \param[in] datagram_interface is the interface for reading and writing datagrams
+template<TCPDatagramAdapter AdaptT>
+TCPPeerThread<AdaptT>::TCPPeerThread( AdaptT&& datagram_interface )
+  : _datagram_adapter( std::move( datagram_interface ) )
+{}
+
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
 template<TCPDatagramAdapter AdaptT>
 TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
                                           AdaptT&& datagram_interface )
   : LocalStreamSocket( std::move( data_socket_pair.first ) )
-  , _datagram_adapter( std::move( datagram_interface ) )
+  , TCPPeerThread<AdaptT>( std::move( datagram_interface ) )
   , _thread_data( std::move( data_socket_pair.second ) )
 {
   _thread_data.set_blocking( false );
@@ -57,7 +97,7 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescript
 }
 
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
+void TCPPeerThread<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
 
@@ -68,34 +108,66 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   // 1) Incoming datagram received (needs to be given to TCPPeer::receive method)
   //
   // 2) Outbound bytes received from local application via a write()
-  //    call (needs to be read from the local stream socket and
-  //    given to TCPPeer)
+  //    call (needs to be given to TCPPeer)
   //
   // 3) Incoming bytes reassembled by the Reassembler
-  //    (needs to be read from the inbound_stream and written
-  //    to the local stream socket back to the application)
+  //    (needs to be read from the inbound_stream and handed
+  //    back to the application)
+  //
+  // The first is handled here, and the front end adds rules for the other two.
+
+  // The rules are prioritized so that, when several are ready at once, inbound segments (and the ACKs
+  // they carry) are processed before application data is moved in either direction.
 
   // rule 1: read from filtered packet stream and dump into TCPConnection
-  _eventloop.add_rule(
+  // (takes up to read_burst queued datagrams per wakeup, so the fd must be non-blocking)
+  _datagram_adapter.fd().set_blocking( false );
+  const unsigned read_burst = std::max( 1U, _datagram_adapter.config().read_burst );
+  auto receive_rule = _eventloop.add_rule(
     "receive TCP segment from the network",
     _datagram_adapter.fd(),
     Direction::In,
-    [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+    [&, read_burst] {
+      if constexpr ( TCPBatchDatagramAdapter<AdaptT> ) {
+        auto segs = _datagram_adapter.read_batch( read_burst );
+        _transmit( [&]( const auto& transmit ) { _tcp->receive_batch( segs, transmit ); } );
+      } else if ( auto seg = _datagram_adapter.read() ) {
+        _transmit( [&]( const auto& transmit ) { _tcp->receive( std::move( seg.value() ), transmit ); } );
       }
+      _after_receive();
 
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _outbound_shutdown and _tcp.value().sender().sequence_numbers_in_flight() == 0
+           and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
       }
     },
     [&] { return _tcp->active(); } );
+  if constexpr ( not TCPBatchDatagramAdapter<AdaptT> ) {
+    receive_rule.set_drain_budget( read_burst );
+  }
+  receive_rule.set_priority( EventLoop::Priority::High );
+
+  _add_stream_rules();
+}
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_after_receive()
+{
+  if constexpr ( TCPBatchDatagramAdapter<AdaptT> ) {
+    // A burst can fill the receive window in one go. Hand it to the owner now (instead of on a later
+    // wakeup), so the window reopens before the peer's zero-window probe arrives and gets dropped.
+    _deliver_inbound();
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_add_stream_rules()
+{
   // rule 2: read from pipe into outbound buffer
-  _eventloop.add_rule(
+  auto push_rule = _eventloop.add_rule(
     "push bytes to TCPPeer",
     _thread_data,
     Direction::In,
@@ -116,7 +188,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
                   << " still in flight).\n";
       }
 
-      _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+      _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
     },
     [&] {
       return ( _tcp->active() ) and ( not _outbound_shutdown )
@@ -130,6 +202,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       std::cerr << "DEBUG: minnow outbound stream had error.\n";
       _tcp->outbound_writer().set_error();
     } );
+  push_rule.set_priority( EventLoop::Priority::Low );
 
   // rule 3: read from inbound buffer into pipe
   _eventloop.add_rule(
@@ -138,14 +211,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     Direction::Out,
     [&] {
       Reader& inbound = _tcp->inbound_reader();
-      // Write from the inbound_stream into
-      // the pipe, handling the possibility of a partial
-      // write (i.e., only pop what was actually written).
-      if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
-        inbound.pop( bytes_written );
-      }
+      _deliver_inbound();
 
       if ( inbound.is_finished() or inbound.has_error() ) {
         _thread_data.shutdown( SHUT_WR );
@@ -188,6 +254,12 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface )
 
 template<TCPDatagramAdapter AdaptT>
 TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
+{
+  this->_stop();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPPeerThread<AdaptT>::_stop()
 {
   try {
     if ( _tcp_thread.joinable() ) {
@@ -205,6 +277,12 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
+  this->_join();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPPeerThread<AdaptT>::_join()
+{
   if ( _tcp_thread.joinable() ) {
     std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
     _tcp_thread.join();
@@ -215,23 +293,23 @@ void TCPMinnowSocket<AdaptT>::wait_until_closed()
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+void TCPPeerThread<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
 {
   if ( _tcp ) {
     throw std::runtime_error( "connect() with TCPConnection already initialized" );
   }
 
-  _initialize_TCP( c_tcp );
-
   _datagram_adapter.config_mut() = c_ad;
 
+  _initialize_TCP( c_tcp );
+
   std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
 
   if ( not _tcp.has_value() ) {
     throw std::runtime_error( "TCPPeer not successfully initialized" );
   }
 
-  _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+  _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
 
   if ( _tcp->sender().sequence_numbers_in_flight() != 1 ) {
     throw std::runtime_error( "After TCPConnection::connect(), expected sequence_numbers_in_flight() == 1" );
@@ -244,39 +322,43 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
     std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
   }
 
-  _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  _tcp_thread = std::thread( &TCPPeerThread::_tcp_main, this );
 }
 
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+void TCPPeerThread<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
 {
   if ( _tcp ) {
     throw std::runtime_error( "listen_and_accept() with TCPConnection already initialized" );
   }
 
-  _initialize_TCP( c_tcp );
-
   _datagram_adapter.config_mut() = c_ad;
   _datagram_adapter.set_listening( true );
 
+  _initialize_TCP( c_tcp );
+
   std::cerr << "DEBUG: minnow listening for incoming connection...\n";
   _tcp_loop( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
   std::cerr << "DEBUG: minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
 
-  _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  _tcp_thread = std::thread( &TCPPeerThread::_tcp_main, this );
 }
 
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::_tcp_main()
+void TCPPeerThread<AdaptT>::_tcp_main()
 {
   try {
     if ( not _tcp.has_value() ) {
       throw std::runtime_error( "no TCP" );
     }
     _tcp_loop( [] { return true; } );
-    shutdown( SHUT_RDWR );
+    if ( _abort and _tcp->active() ) {
+      // the owner went away without closing the connection, so reset it
+      _transmit( [&]( const auto& transmit ) { _tcp->abort( transmit ); } );
+    }
+    _close_owner_streams();
     if ( not _tcp.value().active() ) {
       std::cerr << "DEBUG: minnow TCP connection finished "
                 << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
@@ -287,3 +369,426 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     throw e;
   }
 }
+
+//! \param[in] datagram_interface is the interface for reading and writing datagrams
+//! \param[in] ring_capacity is the number of bytes each StreamRing holds
+template<TCPDatagramAdapter AdaptT>
+TCPMinnowRingSocket<AdaptT>::TCPMinnowRingSocket( AdaptT&& datagram_interface, const uint64_t ring_capacity )
+  : TCPPeerThread<AdaptT>( std::move( datagram_interface ) )
+  , _outbound_ring( ring_capacity )
+  , _inbound_ring( ring_capacity )
+{}
+
+template<TCPDatagramAdapter AdaptT>
+TCPMinnowRingSocket<AdaptT>::~TCPMinnowRingSocket()
+{
+  this->_stop();
+}
+
+//! \details The first chunk is swapped into `buffer` (so the bytes aren't copied again), and any others are
+//! appended to it. If nothing is waiting, the owner's doorbell is armed first, so fd() becomes readable when
+//! something arrives.
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::read( std::string& buffer )
+{
+  _owner_doorbell.clear();
+  buffer.clear();
+
+  if ( not _inbound_ring.pop( buffer ) ) {
+    _owner_doorbell.arm();
+    if ( not _inbound_ring.pop( buffer ) ) {
+      _eof = _inbound_ring.is_finished() or _inbound_ring.has_error();
+      return;
+    }
+  }
+  while ( _inbound_ring.pop( _read_scratch ) ) {
+    buffer.append( _read_scratch );
+  }
+
+  // there is room in the ring again
+  _tcp_doorbell.ring();
+}
+
+template<TCPDatagramAdapter AdaptT>
+size_t TCPMinnowRingSocket<AdaptT>::write( const std::string_view buffer )
+{
+  if ( _outbound_ring.is_closed() ) {
+    throw std::runtime_error( "TCPMinnowRingSocket: write() after shutdown" );
+  }
+  _owner_doorbell.clear();
+
+  size_t written = _outbound_ring.push( buffer );
+  if ( written < buffer.size() ) {
+    // ask to hear when there is room, then look once more
+    _owner_doorbell.arm();
+    written += _outbound_ring.push( buffer.substr( written ) );
+  }
+
+  if ( written > 0 ) {
+    _tcp_doorbell.ring();
+  }
+  return written;
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::shutdown( const int how )
+{
+  if ( how == SHUT_WR or how == SHUT_RDWR ) {
+    _outbound_ring.close();
+  }
+  if ( how == SHUT_RD or how == SHUT_RDWR ) {
+    _inbound_ring.abandon();
+  }
+  _tcp_doorbell.ring();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::wait_until_closed()
+{
+  shutdown( SHUT_RDWR );
+  this->_join();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::_add_stream_rules()
+{
+  // rules 2 and 3: the owner wrote bytes to push, or made room for bytes to deliver. Both are also done after
+  // segments arrive (whose ACKs make room in the outbound stream); between times, a thread that runs out of
+  // work arms its doorbell so that the other wakes it.
+  _eventloop.add_rule(
+    "owner rang doorbell",
+    _tcp_doorbell.fd(),
+    Direction::In,
+    [&] {
+      _tcp_doorbell.clear();
+      _pull_outbound();
+      _deliver_inbound();
+    },
+    [&] { return _tcp->active(); } );
+
+  _tcp_doorbell.arm();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::_after_receive()
+{
+  _pull_outbound();
+  _deliver_inbound();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::_pull_outbound()
+{
+  if ( _outbound_shutdown or not _tcp->active() ) {
+    return;
+  }
+
+  Writer& outbound = _tcp->outbound_writer();
+  bool pulled = false;
+  while ( outbound.available_capacity() > 0 ) {
+    if ( _outbound_chunk.empty() and not _outbound_ring.pop( _outbound_chunk ) ) {
+      // out of bytes from the owner: ask to be woken when there are more, then look once more
+      _tcp_doorbell.arm();
+      if ( not _outbound_ring.pop( _outbound_chunk ) ) {
+        break;
+      }
+    }
+
+    // a chunk that doesn't fit waits for the stream to make room for the rest
+    const size_t len = std::min<uint64_t>( _outbound_chunk.size(), outbound.available_capacity() );
+    if ( len == _outbound_chunk.size() ) {
+      outbound.push( std::move( _outbound_chunk ) );
+      _outbound_chunk.clear();
+    } else {
+      outbound.push( _outbound_chunk.substr( 0, len ) );
+      _outbound_chunk.erase( 0, len );
+    }
+    pulled = true;
+  }
+
+  if ( _outbound_chunk.empty() and _outbound_ring.is_finished() ) {
+    outbound.close();
+    _outbound_shutdown = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow outbound stream to " << this->peer_address().to_string() << " finished ("
+              << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+              << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" ) << " still in flight).\n";
+  }
+
+  if ( pulled or _outbound_shutdown ) {
+    _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
+  }
+  if ( pulled ) {
+    _owner_doorbell.ring(); // there is room in the ring again
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::_deliver_inbound()
+{
+  if ( _inbound_shutdown ) {
+    return;
+  }
+
+  Reader& inbound = _tcp->inbound_reader();
+  bool delivered = false;
+  while ( inbound.bytes_buffered() ) {
+    size_t len = _inbound_ring.push( inbound.peek() );
+    if ( len == 0 ) {
+      // The owner hasn't made room. Once the inbound stream fills too, the window closes, and the peer's
+      // zero-window probe is dropped (costing it a retransmission timeout), so first give the owner a chance
+      // to run (it was woken when the ring filled, but may share this CPU). Then ask to be woken when it
+      // makes room, and look once more.
+      std::this_thread::yield();
+      _tcp_doorbell.arm();
+      len = _inbound_ring.push( inbound.peek() );
+      if ( len == 0 ) {
+        break;
+      }
+    }
+    inbound.pop( len );
+    delivered = true;
+  }
+
+  if ( delivered ) {
+    _transmit( [&]( const auto& transmit ) { _tcp->update_window( transmit ); } );
+  }
+
+  if ( inbound.is_finished() or inbound.has_error() ) {
+    if ( inbound.has_error() ) {
+      _inbound_ring.set_error();
+    }
+    _inbound_ring.close();
+    _inbound_shutdown = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow inbound stream from " << this->peer_address().to_string() << " finished "
+              << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+  }
+
+  if ( delivered or _inbound_shutdown ) {
+    _owner_doorbell.ring();
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowRingSocket<AdaptT>::_close_owner_streams()
+{
+  _inbound_ring.close();
+  _outbound_ring.abandon();
+  _owner_doorbell.ring();
+}
+
+//! \param[in] datagram_interface is the interface for reading and writing datagrams
+template<TCPDatagramAdapter AdaptT>
+TCPMinnowInlineSocket<AdaptT>::TCPMinnowInlineSocket( AdaptT&& datagram_interface )
+  : _datagram_adapter( std::move( datagram_interface ) )
+{}
+
+template<TCPDatagramAdapter AdaptT>
+TCPMinnowInlineSocket<AdaptT>::~TCPMinnowInlineSocket()
+{
+  try {
+    if ( active() ) {
+      std::cerr << "Warning: unclean shutdown of TCPMinnowInlineSocket\n";
+      _transmit( [&]( const auto& transmit ) { _tcp->abort( transmit ); } );
+    }
+  } catch ( const std::exception& e ) {
+    std::cerr << "Exception destructing TCPMinnowInlineSocket: " << e.what() << "\n";
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::_transmit(
+  const std::function<void( const TCPPeer::TransmitFunction& )>& tcp_call )
+{
+  if constexpr ( TCPBatchDatagramAdapter<AdaptT> ) {
+    // TCPPeer lends out its messages only for the duration of the transmit call, so keep copies
+    tcp_call( [&]( const TCPMessage& x ) {
+      _outbound_burst.push_back( { TCPSenderMessage( x.sender.get() ), TCPReceiverMessage( x.receiver.get() ) } );
+    } );
+    if ( not _outbound_burst.empty() ) {
+      _datagram_adapter.write_batch( _outbound_burst );
+      _outbound_burst.clear();
+    }
+  } else {
+    tcp_call( [&]( const TCPMessage& x ) { _datagram_adapter.write( x ); } );
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
+{
+  _tcp.emplace( config );
+  _datagram_adapter.fd().set_blocking( false );
+  _last_tick_ms = timestamp_ms();
+}
+
+//! \param[in] c_tcp is the TCPConfig for the TCPConnection
+//! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+{
+  if ( _tcp ) {
+    throw std::runtime_error( "connect() with TCPConnection already initialized" );
+  }
+
+  _datagram_adapter.config_mut() = c_ad;
+
+  _initialize_TCP( c_tcp );
+
+  std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
+
+  _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
+
+  if ( _tcp->sender().sequence_numbers_in_flight() != 1 ) {
+    throw std::runtime_error( "After TCPConnection::connect(), expected sequence_numbers_in_flight() == 1" );
+  }
+
+  _run_while( [&] { return _tcp->sender().sequence_numbers_in_flight() == 1; } );
+  if ( _tcp->inbound_reader().has_error() ) {
+    std::cerr << "DEBUG: minnow error on connecting to " << c_ad.destination.to_string() << ".\n";
+  } else {
+    std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
+  }
+}
+
+//! \param[in] c_tcp is the TCPConfig for the TCPConnection
+//! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+{
+  if ( _tcp ) {
+    throw std::runtime_error( "listen_and_accept() with TCPConnection already initialized" );
+  }
+
+  _datagram_adapter.config_mut() = c_ad;
+  _datagram_adapter.set_listening( true );
+
+  _initialize_TCP( c_tcp );
+
+  std::cerr << "DEBUG: minnow listening for incoming connection...\n";
+  _run_while( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
+  std::cerr << "DEBUG: minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::_run_while( const std::function<bool()>& condition )
+{
+  while ( active() and condition() ) {
+    pollfd pfd { _datagram_adapter.fd().fd_num(), POLLIN, 0 };
+    CheckSystemCall( "poll", ::poll( &pfd, 1, timeout_ms() ) );
+    process();
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+int TCPMinnowInlineSocket<AdaptT>::timeout_ms() const
+{
+  return active() ? static_cast<int>( TCP_TICK_MS ) : -1;
+}
+
+//! \details Like the TCPPeer thread's rule for the adapter, this takes up to read_burst segments, in one
+//! read_batch() if the adapter supports it, or else one read() at a time until the fd would block.
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::process()
+{
+  if ( not active() ) {
+    return;
+  }
+
+  const unsigned read_burst = std::max( 1U, _datagram_adapter.config().read_burst );
+  if constexpr ( TCPBatchDatagramAdapter<AdaptT> ) {
+    auto segs = _datagram_adapter.read_batch( read_burst );
+    if ( not segs.empty() ) {
+      _transmit( [&]( const auto& transmit ) { _tcp->receive_batch( segs, transmit ); } );
+    }
+  } else {
+    for ( unsigned i = 0; i < read_burst and active(); ++i ) {
+      const auto reads_before = _datagram_adapter.fd().read_count();
+      if ( auto seg = _datagram_adapter.read() ) {
+        _transmit( [&]( const auto& transmit ) { _tcp->receive( std::move( seg.value() ), transmit ); } );
+      }
+      if ( _datagram_adapter.fd().read_count() == reads_before ) {
+        break; // the fd would block
+      }
+    }
+  }
+
+  if ( _inbound_shutdown ) {
+    // nobody will read what arrived, so keep the window open
+    Reader& inbound = _tcp->inbound_reader();
+    inbound.pop( inbound.bytes_buffered() );
+  }
+
+  if ( active() ) {
+    const auto now = timestamp_ms();
+    _transmit( [&]( const auto& transmit ) { _tcp->tick( now - _last_tick_ms, transmit ); } );
+    _datagram_adapter.tick( now - _last_tick_ms );
+    _last_tick_ms = now;
+  }
+}
+
+//! \details Takes everything the inbound stream holds, and tells the peer if that reopened the window.
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::read( std::string& buffer )
+{
+  buffer.clear();
+  if ( not _tcp ) {
+    return;
+  }
+
+  Reader& inbound = _tcp->inbound_reader();
+  if ( inbound.bytes_buffered() ) {
+    buffer.append( inbound.peek() );
+    inbound.pop( buffer.size() );
+    _transmit( [&]( const auto& transmit ) { _tcp->update_window( transmit ); } );
+  }
+  _eof = inbound.is_finished() or inbound.has_error();
+}
+
+template<TCPDatagramAdapter AdaptT>
+size_t TCPMinnowInlineSocket<AdaptT>::write( const std::string_view buffer )
+{
+  if ( not active() ) {
+    throw std::runtime_error( "TCPMinnowInlineSocket: write() without an open connection" );
+  }
+
+  Writer& outbound = _tcp->outbound_writer();
+  if ( outbound.is_closed() ) {
+    throw std::runtime_error( "TCPMinnowInlineSocket: write() after shutdown" );
+  }
+
+  const size_t len = std::min<uint64_t>( buffer.size(), outbound.available_capacity() );
+  if ( len > 0 ) {
+    outbound.push( std::string { buffer.substr( 0, len ) } );
+    _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
+  }
+  return len;
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::shutdown( const int how )
+{
+  if ( not active() ) {
+    return;
+  }
+
+  if ( ( how == SHUT_WR or how == SHUT_RDWR ) and not _tcp->outbound_writer().is_closed() ) {
+    _tcp->outbound_writer().close();
+    _transmit( [&]( const auto& transmit ) { _tcp->push( transmit ); } );
+  }
+  if ( how == SHUT_RD or how == SHUT_RDWR ) {
+    _inbound_shutdown = true;
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowInlineSocket<AdaptT>::wait_until_closed()
+{
+  shutdown( SHUT_RDWR );
+  std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
+  _run_while( [] { return true; } );
+  std::cerr << "done.\n";
+}
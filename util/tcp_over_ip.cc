@@ -22,7 +22,7 @@ using namespace std;
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram )
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram, const bool verify_checksum )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
@@ -42,7 +42,7 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
 
   // is the payload a valid TCP segment?
   TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
+  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum(), verify_checksum ) ) {
     return {};
   }
 
@@ -71,20 +71,51 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
   return move( tcp_seg.message );
 }
 
-//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
-//! \param[in] seg is the TCP segment to convert
+optional<pair<FourTuple, TCPMessage>> TCPOverIPv4Adapter::demux_tcp_in_ip( InternetDatagram ip_dgram,
+                                                                          const bool verify_checksum )
+{
+  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum(), verify_checksum ) ) {
+    return {};
+  }
+
+  const FourTuple tuple {
+    ip_dgram.header.src, tcp_seg.udinfo.src_port, ip_dgram.header.dst, tcp_seg.udinfo.dst_port };
+  return pair { tuple, move( tcp_seg.message ) };
+}
+
+FourTuple TCPOverIPv4Adapter::tuple() const
+{
+  return { config().source.ipv4_numeric(),
+           config().source.port(),
+           config().destination.ipv4_numeric(),
+           config().destination.port() };
+}
+
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+{
+  return wrap_tcp_in_ip( tuple(), msg );
+}
+
+//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
+//! \param[in] tuple is the connection the segment belongs to
+//! \param[in] msg is the TCP segment to convert
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const FourTuple& tuple, const TCPMessage& msg )
 {
   const size_t payload_size = msg.sender->payload.size();
   TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
   // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  seg.udinfo.src_port = tuple.src_port;
+  seg.udinfo.dst_port = tuple.dst_port;
 
   // create an Internet Datagram and set its addresses and length
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
+  ip_dgram.header.src = tuple.src_ip;
+  ip_dgram.header.dst = tuple.dst_ip;
   ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + payload_size;
 
   // set payload, calculating TCP checksum using information from IP header
@@ -94,3 +125,70 @@ InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
 
   return ip_dgram;
 }
+
+//! \details The segments must carry the same acknowledgment, window and flags (except a FIN on the last one), and
+//! each payload must continue the previous one. All but the last must be the same size, because the kernel
+//! splits the super-segment into pieces the size of the first.
+bool TCPOverIPv4Adapter::extends_tcp_run( const span<const TCPMessage> run, const TCPMessage& next )
+{
+  const auto& first = run.front();
+  const auto& last = run.back();
+  if ( first.sender->SYN or first.sender->RST or last.sender->FIN or next.sender->SYN or next.sender->RST ) {
+    return false;
+  }
+
+  const size_t segment_size = first.sender->payload.size();
+  if ( last.sender->payload.size() != segment_size or next.sender->payload.empty()
+       or next.sender->payload.size() > segment_size ) {
+    return false;
+  }
+
+  if ( next.sender->seqno != last.sender->seqno + static_cast<uint32_t>( segment_size ) ) {
+    return false;
+  }
+
+  if ( next.receiver->ackno != first.receiver->ackno or next.receiver->window_size != first.receiver->window_size
+       or next.receiver->RST != first.receiver->RST ) {
+    return false;
+  }
+
+  // the super-segment must still fit in one IPv4 datagram
+  return IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + segment_size * run.size() + next.sender->payload.size()
+         <= UINT16_MAX;
+}
+
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_run_in_ip( const span<const TCPMessage> run )
+{
+  return wrap_tcp_run_in_ip( tuple(), run );
+}
+
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_run_in_ip( const FourTuple& tuple, const span<const TCPMessage> run )
+{
+  size_t payload_size = 0;
+  for ( const auto& msg : run ) {
+    payload_size += msg.sender->payload.size();
+  }
+
+  // a header-only segment that starts where the run starts, and finishes where it finishes
+  TCPSegment seg { .message = { TCPSenderMessage { .seqno = run.front().sender->seqno,
+                                                   .SYN = run.front().sender->SYN,
+                                                   .FIN = run.back().sender->FIN,
+                                                   .RST = run.front().sender->RST },
+                                run.front().receiver.borrow() } };
+  seg.udinfo.src_port = tuple.src_port;
+  seg.udinfo.dst_port = tuple.dst_port;
+
+  InternetDatagram ip_dgram;
+  ip_dgram.header.src = tuple.src_ip;
+  ip_dgram.header.dst = tuple.dst_ip;
+  ip_dgram.header.len = ip_dgram.header.hlen * 4 + TCPSegment::HEADER_LENGTH + payload_size;
+
+  seg.compute_partial_checksum( ip_dgram.header.pseudo_checksum() );
+  ip_dgram.header.compute_checksum();
+  ip_dgram.payload = serialize( seg );
+  for ( const auto& msg : run ) {
+    ip_dgram.payload.push_back( Ref<string>::borrow( msg.sender->payload ) );
+  }
+
+  return ip_dgram;
+}
@@ -1,16 +1,38 @@
 #pragma once
 
 #include "fd_adapter.hh"
+#include "four_tuple.hh"
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
 #include <optional>
+#include <span>
+#include <utility>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
 {
 public:
-  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram );
+  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram, bool verify_checksum = true );
 
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! The configured connection, in the direction of outgoing segments (source to destination)
+  FourTuple tuple() const;
+
+  //! Parses the TCP segment in any IPv4 datagram, whatever its connection, returning it with its FourTuple
+  //! (as seen on the wire: the sender is the source). For demultiplexing many connections (see TCPStack).
+  static std::optional<std::pair<FourTuple, TCPMessage>> demux_tcp_in_ip( InternetDatagram ip_dgram,
+                                                                          bool verify_checksum = true );
+
+  //! Wraps a segment in an IPv4 datagram from `tuple`'s source to its destination
+  static InternetDatagram wrap_tcp_in_ip( const FourTuple& tuple, const TCPMessage& msg );
+
+  //! Can `next` be sent in the same TCP super-segment as `run` (see wrap_tcp_run_in_ip)?
+  static bool extends_tcp_run( std::span<const TCPMessage> run, const TCPMessage& next );
+
+  //! Wraps a run of TCP segments built up by extends_tcp_run in a single IPv4 datagram carrying all their
+  //! payloads, leaving the TCP checksum for the kernel to finish (and the datagram for it to split up again)
+  InternetDatagram wrap_tcp_run_in_ip( std::span<const TCPMessage> run );
+  static InternetDatagram wrap_tcp_run_in_ip( const FourTuple& tuple, std::span<const TCPMessage> run );
 };
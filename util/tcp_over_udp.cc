@@ -0,0 +1,101 @@
+#include "tcp_over_udp.hh"
+#include "helpers.hh"
+
+using namespace std;
+
+//! \details If the adapter is listening, a SYN from any sender makes that sender the peer
+//! (see TCPOverIPv4Adapter::unwrap_tcp_in_ip).
+optional<TCPMessage> TCPOverUDPAdapter::unwrap_tcp_in_udp( const Address& source, const string_view datagram )
+{
+  if ( not listening() and source != config().destination ) {
+    return {};
+  }
+
+  // parse from two buffers, so the payload is moved into the segment rather than copied again
+  vector<string> buffers;
+  buffers.emplace_back( datagram.substr( 0, TCPSegment::HEADER_LENGTH ) );
+  if ( datagram.size() > TCPSegment::HEADER_LENGTH ) {
+    buffers.emplace_back( datagram.substr( TCPSegment::HEADER_LENGTH ) );
+  }
+
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, move( buffers ), 0, false ) ) {
+    return {};
+  }
+
+  if ( listening() ) {
+    if ( not tcp_seg.message.sender->SYN or tcp_seg.message.sender->RST ) {
+      return {};
+    }
+    config_mutable().destination = source;
+    set_listening( false );
+  }
+
+  return move( tcp_seg.message );
+}
+
+vector<Ref<string>> TCPOverUDPAdapter::wrap_tcp_in_udp( const TCPMessage& msg ) const
+{
+  // serialize the header alone, then borrow the payload instead of copying it
+  TCPSegment seg { .message = { TCPSenderMessage { .seqno = msg.sender->seqno,
+                                                   .SYN = msg.sender->SYN,
+                                                   .FIN = msg.sender->FIN,
+                                                   .RST = msg.sender->RST },
+                                msg.receiver.borrow() } };
+  seg.udinfo.src_port = config().source.port();
+  seg.udinfo.dst_port = config().destination.port();
+
+  auto ret = serialize( seg );
+  if ( not msg.sender->payload.empty() ) {
+    ret.push_back( Ref<string>::borrow( msg.sender->payload ) );
+  }
+  return ret;
+}
+
+optional<TCPMessage> TCPOverUDPAdapter::read()
+{
+  auto segs = read_batch( 1 );
+  if ( segs.empty() ) {
+    return {};
+  }
+  return move( segs.front() );
+}
+
+void TCPOverUDPAdapter::write( const TCPMessage& seg )
+{
+  write_batch( span { &seg, 1 } );
+}
+
+vector<TCPMessage> TCPOverUDPAdapter::read_batch( const size_t max )
+{
+  if ( _read_batch.capacity() != max ) {
+    _read_batch = DatagramBatch { max };
+  }
+
+  const size_t count = _socket.recv_batch( _read_batch );
+
+  vector<TCPMessage> ret;
+  ret.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    if ( auto msg = unwrap_tcp_in_udp( _read_batch.address( i ), _read_batch.payload( i ) ) ) {
+      ret.push_back( move( msg.value() ) );
+    }
+  }
+  return ret;
+}
+
+void TCPOverUDPAdapter::write_batch( const span<const TCPMessage> segs )
+{
+  vector<vector<Ref<string>>> datagrams;
+  datagrams.reserve( segs.size() );
+  for ( const auto& seg : segs ) {
+    datagrams.push_back( wrap_tcp_in_udp( seg ) );
+  }
+  _socket.send_batch( config().destination, datagrams );
+}
+
+//! Specialize LossyFdAdapter to TCPOverUDPAdapter
+template class LossyFdAdapter<TCPOverUDPAdapter>;
+
+//! Specialize NetEmAdapter to (lossy) TCPOverUDPAdapter
+template class NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "fd_adapter.hh"
+#include "lossy_fd_adapter.hh"
+#include "netem_adapter.hh"
+#include "socket.hh"
+#include "tcp_segment.hh"
+#include "tuntap_adapter.hh"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+//! \brief A FD adapter that carries each TCP segment as the payload of a UDP datagram
+//! \details This lets two minnow peers talk without a TUN device (or root), e.g. over loopback.
+//! The socket should already be bound to FdAdapterConfig::source. Segments are sent to FdAdapterConfig::destination,
+//! and only datagrams from there are accepted; a listening adapter takes the sender of the first SYN as its
+//! destination. The TCP checksum is left at zero, since UDP's own checksum covers the whole segment.
+class TCPOverUDPAdapter : public FdAdapterBase
+{
+private:
+  UDPSocket _socket;
+
+  DatagramBatch _read_batch {}; //!< Buffers (and source addresses) reused by read_batch
+
+  //! Parse a datagram from `source`, if it is related to the current connection
+  std::optional<TCPMessage> unwrap_tcp_in_udp( const Address& source, std::string_view datagram );
+
+  //! Serialize a segment with the configured ports (the payload is borrowed from `msg`)
+  std::vector<Ref<std::string>> wrap_tcp_in_udp( const TCPMessage& msg ) const;
+
+public:
+  //! Construct from a bound UDPSocket
+  explicit TCPOverUDPAdapter( UDPSocket&& socket ) : _socket( std::move( socket ) ) {}
+
+  //! Attempts to read a datagram containing a TCP segment related to the current connection
+  std::optional<TCPMessage> read();
+
+  //! Sends a TCP segment to the peer in a UDP datagram
+  void write( const TCPMessage& seg );
+
+  //! Reads up to `max` datagrams with one system call, returning the segments related to the current connection
+  std::vector<TCPMessage> read_batch( size_t max );
+
+  //! Sends a burst of TCP segments with one system call
+  void write_batch( std::span<const TCPMessage> segs );
+
+  //! Access the underlying UDP socket
+  explicit operator UDPSocket&() { return _socket; }
+
+  //! Access underlying file descriptor
+  FileDescriptor& fd() { return _socket; }
+};
+
+static_assert( TCPDatagramAdapter<TCPOverUDPAdapter> );
+static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverUDPAdapter>> );
+static_assert( TCPBatchDatagramAdapter<TCPOverUDPAdapter> );
+static_assert( TCPBatchDatagramAdapter<LossyFdAdapter<TCPOverUDPAdapter>> );
+static_assert( TCPBatchDatagramAdapter<NetEmAdapter<LossyFdAdapter<TCPOverUDPAdapter>>> );
@@ -9,6 +9,7 @@
 
 #include <functional>
 #include <optional>
+#include <span>
 
 class TCPPeer
 {
@@ -18,10 +19,16 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg )
+    : sender_( ByteStream { cfg.send_capacity }, cfg.isn, cfg.rt_timeout )
+    , receiver_( Reassembler { ByteStream { cfg.recv_capacity } } )
+    , rt_timeout_( cfg.rt_timeout )
+  {}
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
+  const Writer& outbound_writer() const { return sender_.writer(); }
+  const Reader& inbound_reader() const { return receiver_.reader(); }
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( TCPMessage )>;
@@ -42,7 +49,7 @@ public:
     const bool sender_active = sender_.sequence_numbers_in_flight() or not sender_.reader().is_finished();
     const bool receiver_active = not receiver_.writer().is_closed();
     const bool lingering
-      = linger_after_streams_finish_ and ( cumulative_time_ < time_of_last_receipt_ + 10UL * cfg_.rt_timeout );
+      = linger_after_streams_finish_ and ( cumulative_time_ < time_of_last_receipt_ + 10UL * rt_timeout_ );
 
     return ( not any_errors ) and ( sender_active or receiver_active or lingering );
   }
@@ -53,6 +60,63 @@ public:
       return;
     }
 
+    absorb( std::move( msg ) );
+    reply( transmit );
+  }
+
+  /* Receive a burst of messages (e.g. everything read in one wakeup), replying once at the end:
+   * one cumulative ACK covers the whole burst, and the sender sees every ACK before deciding what to push. */
+  void receive_batch( std::span<TCPMessage> msgs, const TransmitFunction& transmit )
+  {
+    for ( auto& msg : msgs ) {
+      if ( not active() ) {
+        return;
+      }
+      absorb( std::move( msg ) );
+    }
+
+    if ( active() and not msgs.empty() ) {
+      reply( transmit );
+    }
+  }
+
+  /* Call after the application reads from the inbound stream. If the window last advertised to the peer
+   * was too small for a full segment and reading has opened it up, tell the peer (with an empty ACK):
+   * otherwise a sender facing a closed window waits a full retransmission timeout to find out. */
+  void update_window( const TransmitFunction& transmit )
+  {
+    const uint64_t window = receiver_.send().window_size;
+    if ( active() and advertised_window_ < TCPConfig::MAX_PAYLOAD_SIZE and window >= TCPConfig::MAX_PAYLOAD_SIZE ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+  }
+
+  /* Abandon the connection: fail both streams, and tell the peer with a RST */
+  void abort( const TransmitFunction& transmit )
+  {
+    sender_.writer().set_error();
+    receiver_.reader().set_error();
+    send( sender_.make_empty_message(), transmit );
+  }
+
+  // Testing interface
+  const TCPReceiver& receiver() const { return receiver_; }
+  const TCPSender& sender() const { return sender_; }
+
+private:
+  // (A stack may hold many idle peers, so only what is needed after construction is kept, packed together.)
+  TCPSender sender_;
+  TCPReceiver receiver_;
+  uint64_t cumulative_time_ {};
+  uint64_t time_of_last_receipt_ {};
+  uint16_t rt_timeout_;
+  uint16_t advertised_window_ {}; // window size in the last message sent to the peer
+  bool need_send_ {};
+  bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
+
+  // Give an incoming message to the receiver and sender, noting whether it needs a reply
+  void absorb( TCPMessage msg )
+  {
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
@@ -64,13 +128,16 @@ public:
     const auto our_ackno = receiver_.send().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
-    // Give incoming TCPSenderMessage to receiver.
-    receiver_.receive( std::move( msg.sender ) );
+    // Give incoming TCPSenderMessage to receiver (moving its payload, rather than copying it).
+    receiver_.receive( msg.sender.release() );
 
     // Give incoming TCPReceiverMessage to sender.
     sender_.receive( msg.receiver );
+  }
 
-    // Send reply if needed.
+  // Send whatever the sender can, plus an empty (ACK) segment if a reply is owed and nothing else carried it
+  void reply( const TransmitFunction& transmit )
+  {
     push( transmit );
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
@@ -82,24 +149,11 @@ public:
     }
   }
 
-  // Testing interface
-  const TCPReceiver& receiver() const { return receiver_; }
-  const TCPSender& sender() const { return sender_; }
-
-private:
-  TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
-  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
-
-  bool need_send_ {};
-
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
-    transmit( { borrow( sender_message ), receiver_.send() } );
+    TCPReceiverMessage receiver_message = receiver_.send();
+    advertised_window_ = receiver_message.window_size;
+    transmit( { borrow( sender_message ), std::move( receiver_message ) } );
     need_send_ = false;
   }
-
-  bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
-  uint64_t cumulative_time_ {};
-  uint64_t time_of_last_receipt_ {};
 };
@@ -4,49 +4,55 @@
 #include "wrapping_integers.hh"
 
 #include <sstream>
+#include <utility>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
 
-void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, bool verify_checksum )
 {
   /* verify checksum */
-  InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( parser.buffer() );
-  if ( check.value() ) {
-    parser.set_error();
-    return;
+  if ( verify_checksum ) {
+    InternetChecksum check { datagram_layer_pseudo_checksum };
+    parser.for_each_buffer( [&]( const string_view buffer ) { check.add( buffer ); } );
+    if ( check.value() ) {
+      parser.set_error();
+      return;
+    }
   }
 
-  uint32_t raw32 {};
-  uint16_t raw16 {};
-  uint8_t octet {};
+  uint8_t data_offset {};
+  parser.fixed( HEADER_LENGTH, [&]( auto& header ) {
+    uint32_t raw32 {};
+    uint16_t raw16 {};
+    uint8_t octet {};
 
-  parser.integer( udinfo.src_port );
-  parser.integer( udinfo.dst_port );
+    header.integer( udinfo.src_port );
+    header.integer( udinfo.dst_port );
 
-  parser.integer( raw32 );
-  message.sender->seqno = Wrap32 { raw32 };
+    header.integer( raw32 );
+    message.sender->seqno = Wrap32 { raw32 };
 
-  parser.integer( raw32 );
-  message.receiver->ackno = Wrap32 { raw32 };
+    header.integer( raw32 );
+    message.receiver->ackno = Wrap32 { raw32 };
 
-  parser.integer( octet );
-  const uint8_t data_offset = octet >> 4;
+    header.integer( octet );
+    data_offset = octet >> 4;
 
-  parser.integer( octet ); // flags
-  if ( not( octet & 0b0001'0000 ) ) {
-    message.receiver->ackno.reset(); // no ACK
-  }
+    header.integer( octet ); // flags
+    if ( not( octet & 0b0001'0000 ) ) {
+      message.receiver->ackno.reset(); // no ACK
+    }
 
-  message.sender->RST = message.receiver->RST = octet & 0b0000'0100;
-  message.sender->SYN = octet & 0b0000'0010;
-  message.sender->FIN = octet & 0b0000'0001;
+    message.sender->RST = message.receiver->RST = octet & 0b0000'0100;
+    message.sender->SYN = octet & 0b0000'0010;
+    message.sender->FIN = octet & 0b0000'0001;
 
-  parser.integer( message.receiver->window_size );
-  parser.integer( udinfo.cksum );
-  parser.integer( raw16 ); // urgent pointer
+    header.integer( message.receiver->window_size );
+    header.integer( udinfo.cksum );
+    header.integer( raw16 ); // urgent pointer
+  } );
 
   // skip any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
@@ -64,34 +70,51 @@ public:
   uint32_t raw_value() const { return raw_value_; }
 };
 
-void TCPSegment::serialize( Serializer& serializer ) const
+namespace {
+void serialize_header( const TCPSegment& seg, Serializer& serializer )
 {
-  serializer.integer( udinfo.src_port );
-  serializer.integer( udinfo.dst_port );
+  const auto& message = seg.message;
+  serializer.integer( seg.udinfo.src_port );
+  serializer.integer( seg.udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  serializer.integer( uint8_t { ( TCPSegment::HEADER_LENGTH >> 2 ) << 4 } ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
   const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
   serializer.integer( message.receiver->window_size );
-  serializer.integer( udinfo.cksum );
+  serializer.integer( seg.udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender->payload );
+}
+} // namespace
+
+//! \details The payload is copied in right after the header, so the segment is one buffer
+void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serializer.reserve( HEADER_LENGTH + message.sender->payload.size() );
+  serialize_header( *this, serializer );
+  serializer.copy( message.sender->payload );
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
   Serializer s;
-  serialize( s );
+  serialize_header( *this, s );
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.finish() );
+  check.add( s.contents() );
+  check.add( string_view { as_const( message ).sender->payload } );
   udinfo.cksum = check.value();
 }
 
+void TCPSegment::compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum )
+{
+  // the folded (but not complemented) sum, which the kernel adds to its sum over the header and payload
+  udinfo.cksum = static_cast<uint16_t>( ~InternetChecksum { datagram_layer_pseudo_checksum }.value() );
+}
+
 string TCPSegment::to_string() const
 {
   stringstream ss {};
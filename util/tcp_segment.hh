@@ -22,11 +22,15 @@ struct TCPSegment
   TCPMessage message {};
   UserDatagramInfo udinfo {};
 
-  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+  // `verify_checksum` may be false if the checksum has already been checked (or is yet to be filled in) by the kernel
+  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, bool verify_checksum = true );
   void serialize( Serializer& serializer ) const;
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
+  // Fill in only the pseudo-header's contribution, leaving the kernel to finish the checksum (checksum offload)
+  void compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum );
+
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
 
   // Return a string containing a summary in human-readable format
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "four_tuple.hh"
+#include "loopback_adapter.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! \brief SYN cookies: ISNs that encode a keyed hash of the connection, so a listener can answer a SYN without
+//! keeping any state and recognize the client's ACK when it comes back
+//! \details A cookie is good for the time period it was made in and the one after. Minnow carries no TCP
+//! options, so unlike Linux's cookies these encode no MSS.
+class SynCookie
+{
+public:
+  static constexpr uint64_t PERIOD_MS = 64'000; //!< Length of a time period
+
+  explicit SynCookie( const std::array<uint64_t, 2>& key ) : key_( key ) {}
+
+  //! The cookie for a SYN with ISN `client_isn` on `tuple` (as seen on incoming segments), made in `period`:
+  //! `period` (mod 32) in the top 5 bits, then a SipHash of the rest
+  Wrap32 make( const FourTuple& tuple, Wrap32 client_isn, uint64_t period ) const;
+
+  //! Does `cookie` (the ackno of the client's ACK, less one) belong to a SYN with ISN `client_isn` on `tuple`,
+  //! made in `period` or the period before?
+  bool check( const FourTuple& tuple, Wrap32 client_isn, Wrap32 cookie, uint64_t period ) const;
+
+private:
+  std::array<uint64_t, 2> key_; //!< Secret key
+};
+
+//! \brief Many TCP connections sharing one adapter (e.g. a TUN device), all driven by one EventLoop
+//! \details Every segment read from the adapter is handed to its connection's TCPPeer through a hash table keyed by
+//! FourTuple. A SYN to a listening port makes a new connection in the port's SYN queue, which moves to its accept
+//! queue once the handshake completes. When the SYN queue is full, the stack answers SYNs with a SYN cookie instead
+//! (an ISN that encodes a keyed hash of the connection) and keeps no state until the ACK comes back. Segments for
+//! no connection are answered with a RST.
+//!
+//! install() adds the stack's rules to an EventLoop. The application drives its connections from the same loop
+//! (e.g. with rules whose interest is `conn->inbound_reader().bytes_buffered()`). Bytes written to a
+//! connection's outbound_writer() are sent the next time round the loop.
+template<TCPDemuxAdapter AdaptT>
+class TCPStack
+{
+public:
+  //! One connection: a TCPPeer and the FourTuple of the segments it receives
+  class Connection
+  {
+  public:
+    //! The connection as seen on incoming segments: the source is the peer, the destination is us
+    const FourTuple& tuple() const { return tuple_; }
+    Address local_address() const;
+    Address peer_address() const;
+
+    //! \name
+    //! The streams. Using them marks the connection, so the stack sends what was written (or a window update).
+    //! The const versions (e.g. for an interest function) don't.
+
+    //!@{
+    Writer& outbound_writer();
+    Reader& inbound_reader();
+    const Writer& outbound_writer() const { return peer_.outbound_writer(); }
+    const Reader& inbound_reader() const { return peer_.inbound_reader(); }
+    //!@}
+
+    //! Has the handshake completed?
+    bool established() const { return established_; }
+
+    //! Is the connection still open (or lingering to make sure the peer has finished)?
+    bool active() const { return peer_.active(); }
+
+    //! Was the connection reset (or did either stream fail)?
+    bool failed() const { return peer_.inbound_reader().has_error() or peer_.outbound_writer().has_error(); }
+
+    Connection( TCPStack& stack, const FourTuple& tuple, const TCPConfig& config, bool passive );
+
+  private:
+    friend class TCPStack;
+
+    TCPStack& stack_;
+    FourTuple tuple_;
+    TCPPeer peer_;
+    bool passive_;        //!< Was it made by a SYN to a listening port?
+    bool established_ {}; //!< Has the handshake completed?
+    bool queued_ {};      //!< Is it in TCPStack::_to_push?
+
+    //! Which of its listener's queues (if any) holds the connection
+    enum class Queue : uint8_t
+    {
+      None,
+      Syn,
+      Accept
+    };
+    Queue listen_queue_ { passive_ ? Queue::Syn : Queue::None };
+  };
+
+  using ConnectionPtr = std::shared_ptr<Connection>;
+
+  static constexpr size_t DEFAULT_BACKLOG = 16;
+  static constexpr size_t DEFAULT_SYN_BACKLOG = 128;
+  static constexpr size_t MAX_READ_BURST = 64; //!< Datagrams read from the adapter per wakeup
+  static constexpr uint64_t TICK_MS = 10;      //!< Interval between timer ticks
+
+  //! Construct from the adapter (e.g. to a TUN device). Each new connection gets `config` with its own random ISN.
+  explicit TCPStack( AdaptT&& adapter, const TCPConfig& config = {} );
+
+  //! Counts kept for each listening port
+  struct ListenerStats
+  {
+    uint64_t syn_cookies_sent {};     //!< SYNs answered statelessly because the SYN queue was full
+    uint64_t syn_cookies_accepted {}; //!< Connections made from an ACK carrying a valid cookie
+    uint64_t syns_dropped {};         //!< SYNs ignored because the accept queue was full
+  };
+
+  //! Accept connections to `port` (on any address routed to the device). Up to `syn_backlog` connections may be
+  //! handshaking at once, beyond which SYNs are answered with SYN cookies. Up to `backlog` established
+  //! connections may wait for accept(); while the accept queue is full, SYNs are ignored (the client retries).
+  void listen( uint16_t port, size_t backlog = DEFAULT_BACKLOG, size_t syn_backlog = DEFAULT_SYN_BACKLOG );
+
+  //! The oldest established connection to `port` not yet accepted (or nullptr)
+  ConnectionPtr accept( uint16_t port );
+
+  //! Number of established connections to `port` waiting for accept()
+  size_t accept_queue_size( uint16_t port ) const;
+
+  //! Counts for listening port `port`
+  const ListenerStats& listener_stats( uint16_t port ) const;
+
+  //! Start connecting from `local` (an address routed to the device; port 0 picks one) to `remote`
+  ConnectionPtr connect( const Address& local, const Address& remote );
+
+  //! Add the rules that drive every connection to `eventloop`: reading segments from the device, sending what
+  //! the connections have written, and a timer. The stack must outlive the loop.
+  void install( EventLoop& eventloop );
+
+  //! Number of connections in the table (including those handshaking or lingering)
+  size_t connection_count() const { return _connections.size(); }
+
+  //! The underlying adapter
+  AdaptT& adapter() { return _adapter; }
+
+  TCPStack( const TCPStack& other ) = delete;
+  TCPStack& operator=( const TCPStack& other ) = delete;
+  TCPStack( TCPStack&& other ) = delete;
+  TCPStack& operator=( TCPStack&& other ) = delete;
+  ~TCPStack() = default;
+
+private:
+  struct Listener
+  {
+    size_t backlog;
+    size_t syn_backlog;
+    size_t syn_queue_size {}; //!< Connections still handshaking
+    std::deque<ConnectionPtr> accept_queue {};
+    ListenerStats stats {};
+  };
+
+  AdaptT _adapter;
+  TCPConfig _config;
+  std::default_random_engine _rand;
+  SynCookie _cookies; //!< With a random key
+
+  std::unordered_map<FourTuple, ConnectionPtr> _connections {};
+  std::unordered_map<uint16_t, Listener> _listeners {};
+
+  std::vector<ConnectionPtr> _to_push {};                     //!< Connections whose streams were used
+  std::vector<std::pair<FourTuple, TCPMessage>> _outbound {}; //!< Segments to write (tuples outgoing)
+  uint64_t _last_tick_ms {};
+
+  //! Note that a connection's streams were used
+  void mark( Connection& conn );
+
+  //! A transmit function that queues `conn`'s segments in _outbound
+  TCPPeer::TransmitFunction transmitter( const Connection& conn );
+
+  //! Hand a run of segments from one sender to its connection (making one for a SYN to a listening port)
+  void deliver( const FourTuple& tuple, std::span<TCPMessage> msgs );
+
+  //! Make a connection for a SYN to a listening port, or answer it with a SYN cookie (returns nullptr if no
+  //! connection was made)
+  ConnectionPtr open_passive( Listener& listener, const FourTuple& tuple, const TCPMessage& syn );
+
+  //! Make a connection for an ACK to a listening port that carries a valid SYN cookie (nullptr if it doesn't)
+  ConnectionPtr open_from_cookie( Listener& listener, const FourTuple& tuple, const TCPMessage& ack );
+
+  //! Answer a segment that belongs to no connection
+  void reset( const FourTuple& tuple, const TCPMessage& msg );
+
+  //! Move a passive connection from its listener's SYN queue to the accept queue once established (and there is
+  //! room), or out of the queues once gone
+  void update_backlog( Connection& conn );
+
+  //! Read a burst of segments from the device and deliver them
+  void read_segments();
+
+  //! Send whatever the marked connections have to send
+  void push_marked();
+
+  //! Advance every connection's clock, and forget those that have finished
+  void tick();
+
+  //! Write out _outbound, one batch per run of segments on the same connection
+  void flush();
+};
+
+using TCPOverIPv4Stack = TCPStack<TCPOverIPv4OverTunFdAdapter>;
+using LoopbackStack = TCPStack<LoopbackAdapter>;
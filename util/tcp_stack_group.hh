@@ -0,0 +1,47 @@
+#pragma once
+
+#include "eventloop_group.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! \brief One TCPOverIPv4Stack per queue of a multi-queue TUN device, each driven by its own loop of an
+//! EventLoopGroup (and so by its own core)
+//! \details The kernel steers each flow to the queue on which it was last written (see TunFD::open_queues), so
+//! every segment of a connection reaches the stack that opened it or answered its SYN, and the stacks share no
+//! state. A stack is only ever used on its loop's thread: reach it with post().
+class TCPStackGroup
+{
+public:
+  //! Work for one stack, run on its loop's thread
+  using Job = std::function<void( TCPOverIPv4Stack&, EventLoop& )>;
+
+  //! Open `count` queues of the multi-queue TUN device `devname`, and install a stack on each in a loop of its
+  //! own (on core i, if `pin_to_cores`). Each stack's connections get `config`.
+  TCPStackGroup( const std::string& devname,
+                 size_t count,
+                 bool vnet_hdr = false,
+                 const TCPConfig& config = {},
+                 bool pin_to_cores = true );
+
+  size_t size() const { return _stacks.size(); }
+
+  //! Run `job` with stack `index` (safe to call from any thread)
+  void post( size_t index, Job job );
+
+  //! Run `job` with every stack
+  void post_all( const Job& job );
+
+  //! Ask every loop to exit and wait for their threads (idempotent). The stacks are kept until destruction.
+  void stop() { _loops.stop(); }
+
+private:
+  //! Declared before _loops, so the stacks outlive the loops that use them (see TCPStack::install)
+  std::vector<std::unique_ptr<TCPOverIPv4Stack>> _stacks;
+  EventLoopGroup _loops;
+};
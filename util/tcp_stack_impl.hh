@@ -0,0 +1,385 @@
+#include "tcp_stack.hh"
+
+#include "random.hh"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+template<TCPDemuxAdapter AdaptT>
+TCPStack<AdaptT>::Connection::Connection( TCPStack& stack,
+                                          const FourTuple& tuple,
+                                          const TCPConfig& config,
+                                          const bool passive )
+  : stack_( stack ), tuple_( tuple ), peer_( config ), passive_( passive )
+{}
+
+template<TCPDemuxAdapter AdaptT>
+Address TCPStack<AdaptT>::Connection::local_address() const
+{
+  return Address { Address::from_ipv4_numeric( tuple_.dst_ip ).ip(), tuple_.dst_port };
+}
+
+template<TCPDemuxAdapter AdaptT>
+Address TCPStack<AdaptT>::Connection::peer_address() const
+{
+  return Address { Address::from_ipv4_numeric( tuple_.src_ip ).ip(), tuple_.src_port };
+}
+
+template<TCPDemuxAdapter AdaptT>
+Writer& TCPStack<AdaptT>::Connection::outbound_writer()
+{
+  stack_.mark( *this );
+  return peer_.outbound_writer();
+}
+
+template<TCPDemuxAdapter AdaptT>
+Reader& TCPStack<AdaptT>::Connection::inbound_reader()
+{
+  stack_.mark( *this );
+  return peer_.inbound_reader();
+}
+
+template<TCPDemuxAdapter AdaptT>
+TCPStack<AdaptT>::TCPStack( AdaptT&& adapter, const TCPConfig& config )
+  : _adapter( std::move( adapter ) )
+  , _config( config )
+  , _rand( get_random_engine() )
+  , _cookies( { std::uniform_int_distribution<uint64_t> {}( _rand ),
+                std::uniform_int_distribution<uint64_t> {}( _rand ) } )
+{}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::listen( const uint16_t port, const size_t backlog, const size_t syn_backlog )
+{
+  if ( not _listeners.try_emplace( port, Listener { backlog, syn_backlog } ).second ) {
+    throw std::runtime_error( "TCPStack: already listening on port " + std::to_string( port ) );
+  }
+}
+
+template<TCPDemuxAdapter AdaptT>
+typename TCPStack<AdaptT>::ConnectionPtr TCPStack<AdaptT>::accept( const uint16_t port )
+{
+  auto listener = _listeners.find( port );
+  if ( listener == _listeners.end() ) {
+    throw std::runtime_error( "TCPStack: not listening on port " + std::to_string( port ) );
+  }
+
+  auto& queue = listener->second.accept_queue;
+  if ( queue.empty() ) {
+    return nullptr;
+  }
+  ConnectionPtr conn = std::move( queue.front() );
+  queue.pop_front();
+  conn->listen_queue_ = Connection::Queue::None;
+  return conn;
+}
+
+template<TCPDemuxAdapter AdaptT>
+size_t TCPStack<AdaptT>::accept_queue_size( const uint16_t port ) const
+{
+  auto listener = _listeners.find( port );
+  return listener == _listeners.end() ? 0 : listener->second.accept_queue.size();
+}
+
+template<TCPDemuxAdapter AdaptT>
+const typename TCPStack<AdaptT>::ListenerStats& TCPStack<AdaptT>::listener_stats( const uint16_t port ) const
+{
+  auto listener = _listeners.find( port );
+  if ( listener == _listeners.end() ) {
+    throw std::runtime_error( "TCPStack: not listening on port " + std::to_string( port ) );
+  }
+  return listener->second.stats;
+}
+
+template<TCPDemuxAdapter AdaptT>
+typename TCPStack<AdaptT>::ConnectionPtr TCPStack<AdaptT>::connect( const Address& local, const Address& remote )
+{
+  FourTuple tuple { remote.ipv4_numeric(), remote.port(), local.ipv4_numeric(), local.port() };
+  if ( tuple.dst_port == 0 ) {
+    // an ephemeral port that this pair of addresses isn't using yet
+    std::uniform_int_distribution<uint16_t> ephemeral { 49152, 65535 };
+    do {
+      tuple.dst_port = ephemeral( _rand );
+    } while ( _connections.contains( tuple ) );
+  }
+
+  TCPConfig config = _config;
+  config.isn = Wrap32 { std::uniform_int_distribution<uint32_t> {}( _rand ) };
+  auto [it, inserted]
+    = _connections.try_emplace( tuple, std::make_shared<Connection>( *this, tuple, config, false ) );
+  if ( not inserted ) {
+    throw std::runtime_error( "TCPStack: connection already exists" );
+  }
+
+  // the SYN goes out with the next push
+  mark( *it->second );
+  return it->second;
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::install( EventLoop& eventloop )
+{
+  _adapter.fd().set_blocking( false );
+
+  eventloop
+    .add_rule(
+      "TCPStack read segments", _adapter.fd(), Direction::In, [this] { read_segments(); } )
+    .set_priority( EventLoop::Priority::High );
+
+  eventloop.add_rule(
+    "TCPStack push", [this] { push_marked(); }, [this] { return not _to_push.empty(); } );
+
+  _last_tick_ms = EventLoop::now_ms();
+  // the timer re-arms itself each time it fires
+  auto timer = std::make_shared<std::function<void()>>();
+  *timer = [this, &eventloop, weak_timer = std::weak_ptr { timer }] {
+    tick();
+    if ( auto self = weak_timer.lock() ) {
+      eventloop.run_after( TICK_MS, [self] { ( *self )(); } );
+    }
+  };
+  eventloop.run_after( TICK_MS, [timer] { ( *timer )(); } );
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::mark( Connection& conn )
+{
+  if ( conn.queued_ ) {
+    return;
+  }
+  if ( auto it = _connections.find( conn.tuple_ ); it != _connections.end() ) {
+    conn.queued_ = true;
+    _to_push.push_back( it->second );
+  }
+}
+
+template<TCPDemuxAdapter AdaptT>
+TCPPeer::TransmitFunction TCPStack<AdaptT>::transmitter( const Connection& conn )
+{
+  // TCPPeer lends out its messages only for the duration of the transmit call, so keep copies
+  return [this, tuple = conn.tuple_.reversed()]( const TCPMessage& x ) {
+    _outbound.emplace_back(
+      tuple, TCPMessage { TCPSenderMessage { x.sender.get() }, TCPReceiverMessage { x.receiver.get() } } );
+  };
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::deliver( const FourTuple& tuple, std::span<TCPMessage> msgs )
+{
+  auto it = _connections.find( tuple );
+  if ( it == _connections.end() ) {
+    const TCPMessage& first = msgs.front();
+    auto listener = _listeners.find( tuple.dst_port );
+    if ( listener == _listeners.end() ) {
+      reset( tuple, first );
+      return;
+    }
+
+    const bool syn = first.sender->SYN and not first.sender->RST and not first.receiver->ackno.has_value();
+    ConnectionPtr conn = syn ? open_passive( listener->second, tuple, first )
+                             : open_from_cookie( listener->second, tuple, first );
+    if ( not conn ) {
+      return;
+    }
+    it = _connections.emplace( tuple, std::move( conn ) ).first;
+  }
+
+  Connection& conn = *it->second;
+  conn.peer_.receive_batch( msgs, transmitter( conn ) );
+  if ( not conn.established_ and conn.peer_.has_ackno()
+       and conn.peer_.sender().sequence_numbers_in_flight() == 0 ) {
+    conn.established_ = true;
+    update_backlog( conn );
+  }
+}
+
+template<TCPDemuxAdapter AdaptT>
+typename TCPStack<AdaptT>::ConnectionPtr TCPStack<AdaptT>::open_passive( Listener& listener,
+                                                                         const FourTuple& tuple,
+                                                                         const TCPMessage& syn )
+{
+  if ( listener.accept_queue.size() >= listener.backlog ) {
+    ++listener.stats.syns_dropped; // the client will retransmit its SYN
+    return nullptr;
+  }
+
+  if ( listener.syn_queue_size >= listener.syn_backlog ) {
+    // answer without keeping any state: the ISN is a cookie that the client's ACK will echo back
+    const Wrap32 client_isn = syn.sender->seqno;
+    TCPSenderMessage syn_ack {
+      .seqno = _cookies.make( tuple, client_isn, EventLoop::now_ms() / SynCookie::PERIOD_MS ), .SYN = true };
+    TCPReceiverMessage ack {
+      .ackno = client_isn + 1,
+      .window_size = static_cast<uint16_t>( std::min<uint64_t>( _config.recv_capacity, UINT16_MAX ) ) };
+    _outbound.emplace_back( tuple.reversed(), TCPMessage { std::move( syn_ack ), std::move( ack ) } );
+    ++listener.stats.syn_cookies_sent;
+    return nullptr;
+  }
+
+  TCPConfig config = _config;
+  config.isn = Wrap32 { std::uniform_int_distribution<uint32_t> {}( _rand ) };
+  ++listener.syn_queue_size;
+  return std::make_shared<Connection>( *this, tuple, config, true );
+}
+
+template<TCPDemuxAdapter AdaptT>
+typename TCPStack<AdaptT>::ConnectionPtr TCPStack<AdaptT>::open_from_cookie( Listener& listener,
+                                                                             const FourTuple& tuple,
+                                                                             const TCPMessage& ack )
+{
+  if ( ack.sender->SYN or ack.sender->RST or not ack.receiver->ackno.has_value() ) {
+    reset( tuple, ack );
+    return nullptr;
+  }
+
+  const Wrap32 client_isn = ack.sender->seqno + UINT32_MAX; // one before the ACK's seqno
+  const Wrap32 cookie = ack.receiver->ackno.value() + UINT32_MAX;
+  if ( not _cookies.check( tuple, client_isn, cookie, EventLoop::now_ms() / SynCookie::PERIOD_MS ) ) {
+    reset( tuple, ack );
+    return nullptr;
+  }
+
+  if ( listener.accept_queue.size() >= listener.backlog ) {
+    ++listener.stats.syns_dropped; // the client will retransmit (or time out)
+    return nullptr;
+  }
+
+  // Recreate the state the SYN would have made: the client's SYN received, and a SYN-ACK (already sent, with
+  // the cookie as ISN) in flight. The ACK itself then completes the handshake as usual.
+  TCPConfig config = _config;
+  config.isn = cookie;
+  auto conn = std::make_shared<Connection>( *this, tuple, config, true );
+  conn->peer_.receive( TCPMessage { TCPSenderMessage { .seqno = client_isn, .SYN = true }, TCPReceiverMessage {} },
+                       []( const TCPMessage& ) {} );
+  ++listener.syn_queue_size;
+  ++listener.stats.syn_cookies_accepted;
+  return conn;
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::reset( const FourTuple& tuple, const TCPMessage& msg )
+{
+  if ( msg.sender->RST ) {
+    return;
+  }
+
+  // as in RFC 9293 section 3.10.7.1: take the seqno from the ackno, or else acknowledge the segment
+  TCPReceiverMessage receiver { .RST = true };
+  if ( not msg.receiver->ackno.has_value() ) {
+    receiver.ackno = msg.sender->seqno + static_cast<uint32_t>( msg.sender->sequence_length() );
+  }
+  _outbound.emplace_back(
+    tuple.reversed(),
+    TCPMessage { TCPSenderMessage { .seqno = msg.receiver->ackno.value_or( Wrap32 { 0 } ), .RST = true },
+                 std::move( receiver ) } );
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::update_backlog( Connection& conn )
+{
+  using Queue = Connection::Queue;
+  if ( conn.listen_queue_ == Queue::None ) {
+    return;
+  }
+  Listener& listener = _listeners.at( conn.tuple_.dst_port );
+
+  // gone before it was accepted
+  if ( not conn.active() ) {
+    if ( conn.listen_queue_ == Queue::Syn ) {
+      --listener.syn_queue_size;
+    } else {
+      std::erase_if( listener.accept_queue, [&]( const ConnectionPtr& c ) { return c.get() == &conn; } );
+    }
+    conn.listen_queue_ = Queue::None;
+    return;
+  }
+
+  // if the accept queue is full, the connection waits in the SYN queue (and tick() tries again)
+  if ( conn.listen_queue_ == Queue::Syn and conn.established_
+       and listener.accept_queue.size() < listener.backlog ) {
+    --listener.syn_queue_size;
+    listener.accept_queue.push_back( _connections.at( conn.tuple_ ) );
+    conn.listen_queue_ = Queue::Accept;
+  }
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::read_segments()
+{
+  auto segs = _adapter.read_any_batch( MAX_READ_BURST );
+
+  // deliver each run of segments on the same connection together, so it replies once
+  std::vector<TCPMessage> run;
+  for ( size_t start = 0; start < segs.size(); ) {
+    size_t end = start;
+    for ( ; end < segs.size() and segs[end].first == segs[start].first; ++end ) {
+      run.push_back( std::move( segs[end].second ) );
+    }
+    deliver( segs[start].first, run );
+    run.clear();
+    start = end;
+  }
+
+  flush();
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::push_marked()
+{
+  for ( auto& conn : _to_push ) {
+    conn->queued_ = false;
+    // Closing the outbound stream once all of it is acknowledged leaves the peer inactive until the FIN is
+    // pushed, so push unless the connection has failed.
+    if ( not conn->failed() ) {
+      const auto transmit = transmitter( *conn );
+      conn->peer_.push( transmit );
+      conn->peer_.update_window( transmit );
+    }
+  }
+  _to_push.clear();
+
+  flush();
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::tick()
+{
+  const uint64_t now = EventLoop::now_ms();
+  const uint64_t elapsed = now - _last_tick_ms;
+  _last_tick_ms = now;
+
+  for ( auto it = _connections.begin(); it != _connections.end(); ) {
+    Connection& conn = *it->second;
+    if ( conn.active() ) {
+      conn.peer_.tick( elapsed, transmitter( conn ) );
+    }
+    update_backlog( conn );
+    if ( conn.active() or ( conn.queued_ and not conn.failed() ) ) {
+      ++it;
+      continue;
+    }
+    it = _connections.erase( it );
+  }
+
+  flush();
+}
+
+template<TCPDemuxAdapter AdaptT>
+void TCPStack<AdaptT>::flush()
+{
+  std::vector<TCPMessage> run;
+  for ( size_t start = 0; start < _outbound.size(); ) {
+    size_t end = start;
+    for ( ; end < _outbound.size() and _outbound[end].first == _outbound[start].first; ++end ) {
+      run.push_back( std::move( _outbound[end].second ) );
+    }
+    _adapter.write_batch( _outbound[start].first, run );
+    run.clear();
+    start = end;
+  }
+  _outbound.clear();
+}
@@ -1,6 +1,7 @@
 #include "tun.hh"
 #include "exception.hh"
 
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
@@ -14,6 +15,13 @@ using namespace std;
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
+//! \param[in] vnet_hdr is `true` to exchange a `struct virtio_net_hdr` before each datagram or frame, and to let
+//! the kernel hand over TCP/IPv4 datagrams with the checksum left to us (TUN_F_CSUM) or coalesced into
+//! super-segments of up to 64 KiB (TUN_F_TSO4). We may likewise write super-segments, for the kernel to split and
+//! checksum.
+//!
+//! \param[in] multi_queue is `true` to open one more queue of a device created with `multi_queue` (see
+//! TunFD::open_queues). A single queue of such a device is also opened if `multi_queue` is `false`.
 //!
 //! To create a TUN device, you should already have run
 //!
@@ -21,18 +29,55 @@ using namespace std;
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD( const string& devname, const bool is_tun )
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, const bool vnet_hdr, const bool multi_queue )
   : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
+  , vnet_hdr_( vnet_hdr )
+  , multi_queue_( multi_queue )
 {
   struct ifreq tun_req
   {};
 
-  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI // no packetinfo
+                                            | ( vnet_hdr ? IFF_VNET_HDR : 0 )
+                                            | ( multi_queue ? IFF_MULTI_QUEUE : 0 ) );
 
   // copy devname to ifr_name, making sure to null terminate
 
   strncpy( static_cast<char*>( tun_req.ifr_name ), devname.data(), IFNAMSIZ - 1 );
   tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
-  CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+  // the kernel refuses a plain open of a multi-queue device (EINVAL), so retry as a queue
+  int ret = ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) );
+  if ( ret < 0 and errno == EINVAL and not multi_queue ) {
+    tun_req.ifr_flags = static_cast<int16_t>( tun_req.ifr_flags | IFF_MULTI_QUEUE );
+    multi_queue_ = true;
+    ret = ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) );
+  }
+  CheckSystemCall( "ioctl", ret );
+
+  if ( vnet_hdr ) {
+    int hdr_size = sizeof( VirtioNetHeader );
+    CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETVNETHDRSZ, &hdr_size ) );
+  }
+
+  // the offloads outlive us on a persistent device, so clear them if the device was last opened with vnet_hdr
+  CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETOFFLOAD, vnet_hdr ? TUN_F_CSUM | TUN_F_TSO4 : 0U ) );
+}
+
+//! \details To create a multi-queue TUN device, run
+//!
+//!     ip tuntap add mode tun multi_queue user `username` name `devname`
+//!
+//! (or `scripts/tun.sh start -m`). The kernel picks the queue for each packet it sends to the device by the
+//! packet's flow: a flow goes to the queue on which a packet of the same flow was last written, or else to one
+//! chosen by hashing its addresses and ports. So a connection whose segments are always written on one queue
+//! (e.g. by the stack running on one core) is read back on that queue.
+vector<TunFD> TunFD::open_queues( const string& devname, const size_t count, const bool vnet_hdr )
+{
+  vector<TunFD> queues;
+  queues.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    queues.emplace_back( devname, vnet_hdr, true );
+  }
+  return queues;
 }
@@ -2,15 +2,46 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+//! The header before each datagram on a TUN device opened with `vnet_hdr` (see TunTapFD::TunTapFD).
+//! This is `struct virtio_net_hdr` from <linux/virtio_net.h>, which can't be included from C++.
+//! The fields are in host byte order.
+struct VirtioNetHeader
+{
+  static constexpr uint8_t F_NEEDS_CSUM = 1; // checksum from csum_start to be stored at csum_start + csum_offset
+  static constexpr uint8_t F_DATA_VALID = 2; // checksum already verified
+  static constexpr uint8_t GSO_NONE = 0;
+  static constexpr uint8_t GSO_TCPV4 = 1;
+
+  uint8_t flags;
+  uint8_t gso_type;
+  uint16_t hdr_len;     // length of the headers repeated in each segment
+  uint16_t gso_size;    // payload size of each segment (but the last)
+  uint16_t csum_start;  // where the checksum starts
+  uint16_t csum_offset; // where to store it, relative to csum_start
+};
+
+static_assert( sizeof( VirtioNetHeader ) == 10 );
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor
 {
+  bool vnet_hdr_;
+  bool multi_queue_ {};
+
 public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  explicit TunTapFD( const std::string& devname, bool is_tun, bool vnet_hdr = false, bool multi_queue = false );
+
+  //! Is each datagram read or written prefixed by a `struct virtio_net_hdr` (see TunTapFD::TunTapFD)?
+  bool vnet_hdr() const { return vnet_hdr_; }
+
+  //! Is this one queue of a multi-queue device (see TunFD::open_queues)?
+  bool multi_queue() const { return multi_queue_; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -18,7 +49,13 @@ class TunFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  explicit TunFD( const std::string& devname, bool vnet_hdr = false, bool multi_queue = false )
+    : TunTapFD( devname, true, vnet_hdr, multi_queue )
+  {}
+
+  //! Open `count` queues of a persistent multi-queue TUN device, e.g. one per EventLoopGroup loop (see
+  //! TCPStackGroup). Each queue is a separate fd carrying a share of the device's traffic.
+  static std::vector<TunFD> open_queues( const std::string& devname, size_t count, bool vnet_hdr = false );
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
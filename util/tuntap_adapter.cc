@@ -1,26 +1,211 @@
 #include "tuntap_adapter.hh"
+#include "buffer_pool.hh"
 #include "helpers.hh"
 
+#include <algorithm>
+#include <cstring>
+
 using namespace std;
 
-optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
+//! \details The checksum fields point at the TCP checksum (see TCPSegment::compute_partial_checksum).
+string TCPOverIPv4OverTunFdAdapter::make_vnet_header( const size_t run_length, const size_t segment_size )
+{
+  VirtioNetHeader hdr {};
+  hdr.flags = VirtioNetHeader::F_NEEDS_CSUM;
+  hdr.hdr_len = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH;
+  hdr.csum_start = IPv4Header::LENGTH;
+  hdr.csum_offset = 16; // offset of the checksum within the TCP header
+  if ( run_length > 1 ) {
+    hdr.gso_type = VirtioNetHeader::GSO_TCPV4;
+    hdr.gso_size = static_cast<uint16_t>( segment_size );
+  }
+
+  string ret( sizeof( hdr ), 0 );
+  memcpy( ret.data(), &hdr, sizeof( hdr ) );
+  return ret;
+}
+
+void TCPOverIPv4OverTunFdAdapter::prepare_read_buffers( vector<string>& buffers ) const
 {
-  vector<string> strs( 3 );
-  strs[0].resize( IPv4Header::LENGTH );
-  strs[1].resize( TCPSegment::HEADER_LENGTH );
-  _tun.read( strs );
+  const bool vnet = _tun.vnet_hdr();
+  buffers.resize( vnet ? 4 : 3 );
+  auto it = buffers.begin();
+  if ( vnet ) {
+    ( it++ )->resize( sizeof( VirtioNetHeader ) );
+  }
+  ( it++ )->resize( IPv4Header::LENGTH );
+  ( it++ )->resize( TCPSegment::HEADER_LENGTH );
+  if ( vnet ) {
+    it->resize( UINT16_MAX ); // room for a coalesced super-segment
+  }
+}
+
+optional<InternetDatagram> TCPOverIPv4OverTunFdAdapter::parse_buffers( const vector<string>& buffers,
+                                                                      size_t length,
+                                                                      const bool vnet_hdr,
+                                                                      bool& verify_checksum )
+{
+  verify_checksum = true;
+  auto ip_buffers = span { buffers };
+  if ( vnet_hdr ) {
+    VirtioNetHeader hdr {};
+    if ( buffers.front().size() != sizeof( hdr ) or length < sizeof( hdr ) ) {
+      return {};
+    }
+    memcpy( &hdr, buffers.front().data(), sizeof( hdr ) );
+    ip_buffers = ip_buffers.subspan( 1 );
+    length -= sizeof( hdr );
+
+    // the kernel has either checked the TCP checksum already, or left it for us to fill in (as if we were a NIC)
+    verify_checksum = not( hdr.flags & ( VirtioNetHeader::F_NEEDS_CSUM | VirtioNetHeader::F_DATA_VALID ) );
+  }
+
+  // the buffers keep their size from one read to the next; only the first `length` bytes are this datagram's
+  string datagram = BufferPool::acquire( length );
+  for ( const auto& buf : ip_buffers ) {
+    const size_t chunk = min( buf.size(), length - datagram.size() );
+    datagram.append( buf, 0, chunk );
+  }
+  auto list = BufferPool::acquire_list();
+  list.emplace_back( move( datagram ) );
 
   InternetDatagram ip_dgram;
-  if ( parse( ip_dgram, move( strs ) ) ) {
-    return unwrap_tcp_in_ip( move( ip_dgram ) );
+  if ( parse( ip_dgram, move( list ) ) ) {
+    return ip_dgram;
+  }
+  BufferPool::release( move( ip_dgram.payload ) );
+  return {};
+}
+
+optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::unwrap_buffers( const vector<string>& buffers,
+                                                                const size_t length )
+{
+  bool verify_checksum = true;
+  if ( auto ip_dgram = parse_buffers( buffers, length, _tun.vnet_hdr(), verify_checksum ) ) {
+    return unwrap_tcp_in_ip( move( ip_dgram.value() ), verify_checksum );
   }
   return {};
 }
 
+optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
+{
+  if ( fill_read_pool( 1 ) == 0 ) {
+    return {};
+  }
+  return unwrap_buffers( _read_pool.front(), _read_lengths.front() );
+}
+
 void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
 {
-  _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+  write_batch( span { &seg, 1 } );
+}
+
+//! \details The datagrams are read into buffers kept from one read to the next, and parse_buffers copies each one
+//! into a buffer of its own size from the BufferPool, instead of handing the parser a fresh 16 KiB buffer.
+size_t TCPOverIPv4OverTunFdAdapter::fill_read_pool( const size_t max )
+{
+  if ( _read_pool.size() < max ) {
+    const size_t old_size = _read_pool.size();
+    _read_pool.resize( max );
+    _read_lengths.resize( max );
+    for ( size_t i = old_size; i < max; ++i ) {
+      prepare_read_buffers( _read_pool[i] );
+    }
+  }
+
+  return _tun.read_batch( span { _read_pool }.first( max ), _read_lengths );
+}
+
+vector<TCPMessage> TCPOverIPv4OverTunFdAdapter::read_batch( const size_t max )
+{
+  const size_t count = fill_read_pool( max );
+
+  vector<TCPMessage> ret;
+  ret.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    if ( auto msg = unwrap_buffers( _read_pool[i], _read_lengths[i] ) ) {
+      ret.push_back( move( msg.value() ) );
+    }
+  }
+  return ret;
+}
+
+vector<pair<FourTuple, TCPMessage>> TCPOverIPv4OverTunFdAdapter::read_any_batch( const size_t max )
+{
+  const size_t count = fill_read_pool( max );
+
+  vector<pair<FourTuple, TCPMessage>> ret;
+  ret.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    bool verify_checksum = true;
+    auto ip_dgram = parse_buffers( _read_pool[i], _read_lengths[i], _tun.vnet_hdr(), verify_checksum );
+    if ( not ip_dgram ) {
+      continue;
+    }
+    if ( auto seg = demux_tcp_in_ip( move( ip_dgram.value() ), verify_checksum ) ) {
+      ret.push_back( move( seg.value() ) );
+    }
+  }
+  return ret;
+}
+
+void TCPOverIPv4OverTunFdAdapter::write_batch( const span<const TCPMessage> segs )
+{
+  write_batch( tuple(), segs );
+}
+
+void TCPOverIPv4OverTunFdAdapter::write_batch( const FourTuple& tuple, const span<const TCPMessage> segs )
+{
+  // the serialized datagrams borrow from the InternetDatagrams, so those must outlive the write
+  auto& ip_dgrams = _write_dgrams;
+  auto& datagrams = _write_buffers;
+
+  if ( not _tun.vnet_hdr() ) {
+    for ( const auto& seg : segs ) {
+      ip_dgrams.push_back( wrap_tcp_in_ip( tuple, seg ) );
+      datagrams.push_back( serialize( ip_dgrams.back() ) );
+    }
+    _tun.write_batch( datagrams );
+    recycle_write_buffers();
+    return;
+  }
+
+  for ( size_t start = 0; start < segs.size(); ) {
+    size_t end = start + 1;
+    while ( end < segs.size() and extends_tcp_run( segs.subspan( start, end - start ), segs[end] ) ) {
+      ++end;
+    }
+    const auto run = segs.subspan( start, end - start );
+
+    ip_dgrams.push_back( wrap_tcp_run_in_ip( tuple, run ) );
+    auto& datagram = datagrams.emplace_back( BufferPool::acquire_list() );
+    datagram.emplace_back( make_vnet_header( run.size(), run.front().sender->payload.size() ) );
+    auto serialized = serialize( ip_dgrams.back() );
+    for ( auto& buf : serialized ) {
+      datagram.push_back( move( buf ) );
+    }
+    BufferPool::release( move( serialized ) );
+
+    start = end;
+  }
+  _tun.write_batch( datagrams );
+  recycle_write_buffers();
+}
+
+void TCPOverIPv4OverTunFdAdapter::recycle_write_buffers()
+{
+  for ( auto& datagram : _write_buffers ) {
+    BufferPool::release( move( datagram ) );
+  }
+  for ( auto& ip_dgram : _write_dgrams ) {
+    BufferPool::release( move( ip_dgram.payload ) );
+  }
+  _write_buffers.clear();
+  _write_dgrams.clear();
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
 template class LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialize NetEmAdapter to (lossy) TCPOverIPv4OverTunFdAdapter
+template class NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
@@ -1,12 +1,17 @@
 #pragma once
 
+#include "four_tuple.hh"
 #include "lossy_fd_adapter.hh"
+#include "netem_adapter.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
 
 #include <optional>
+#include <span>
+#include <string>
 #include <utility>
+#include <vector>
 
 template<class T>
 concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
@@ -15,12 +20,55 @@ concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
   { a.read() } -> std::same_as<std::optional<TCPMessage>>;
 };
 
+//! An adapter that can also read and write a burst of datagrams at a time
+template<class T>
+concept TCPBatchDatagramAdapter
+  = TCPDatagramAdapter<T> and requires( T a, size_t max, std::span<const TCPMessage> segs ) {
+      { a.read_batch( max ) } -> std::same_as<std::vector<TCPMessage>>;
+
+      { a.write_batch( segs ) } -> std::same_as<void>;
+    };
+
+//! An adapter for a stack of many connections (see TCPStack), which does its own demultiplexing: it reads the
+//! segments of every connection, each with its FourTuple, and writes segments for any connection
+template<class T>
+concept TCPDemuxAdapter
+  = requires( T a, size_t max, const FourTuple& tuple, std::span<const TCPMessage> segs ) {
+      { a.read_any_batch( max ) } -> std::same_as<std::vector<std::pair<FourTuple, TCPMessage>>>;
+
+      { a.write_batch( tuple, segs ) } -> std::same_as<void>;
+
+      { a.fd() } -> std::same_as<FileDescriptor&>;
+    };
+
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
   TunFD _tun;
 
+  //! Buffers reused by read_batch (see prepare_read_buffers), and the length of the datagram last read into each
+  std::vector<std::vector<std::string>> _read_pool {};
+  std::vector<size_t> _read_lengths {};
+
+  //! Lists reused by write_batch: the datagrams, and the buffers to write for each one
+  std::vector<InternetDatagram> _write_dgrams {};
+  std::vector<std::vector<Ref<std::string>>> _write_buffers {};
+
+  //! Give the buffers of the last write_batch back to the BufferPool
+  void recycle_write_buffers();
+
+  //! Size `buffers` to read one datagram into: the virtio-net header if the TUN device
+  //! has one (see TunTapFD::vnet_hdr), the IPv4 header, the TCP header, and the rest.
+  //! They keep that size from one read to the next (see FileDescriptor::read_batch).
+  void prepare_read_buffers( std::vector<std::string>& buffers ) const;
+
+  //! Parse a datagram of `length` bytes read into buffers sized by prepare_read_buffers
+  std::optional<TCPMessage> unwrap_buffers( const std::vector<std::string>& buffers, size_t length );
+
+  //! Read up to `max` datagrams into _read_pool, returning the number read
+  size_t fill_read_pool( size_t max );
+
 public:
   //! Construct from a TunFD
   explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
@@ -31,6 +79,25 @@ public:
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
   void write( const TCPMessage& seg );
 
+  //! Reads up to `max` datagrams that are ready on the TUN device (one wakeup's worth),
+  //! returning the TCP segments among them that are related to the current connection
+  std::vector<TCPMessage> read_batch( size_t max );
+
+  //! Writes a burst of TCP segments to the TUN device. If the device has a virtio-net header,
+  //! runs of full-sized segments are coalesced into TSO super-segments (see TCPOverIPv4Adapter::extends_tcp_run).
+  void write_batch( std::span<const TCPMessage> segs );
+
+  //! \name
+  //! For a stack of many connections (see TCPStack), which does its own demultiplexing
+
+  //!@{
+  //! Like read_batch, but returns every TCP segment read, whatever its connection, with its FourTuple
+  std::vector<std::pair<FourTuple, TCPMessage>> read_any_batch( size_t max );
+
+  //! Like write_batch, but for the connection `tuple` (in the outgoing direction) instead of the configured one
+  void write_batch( const FourTuple& tuple, std::span<const TCPMessage> segs );
+  //!@}
+
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
 
@@ -39,7 +106,24 @@ public:
 
   //! Access underlying file descriptor
   FileDescriptor& fd() { return _tun; }
+
+  //! The virtio-net header written before a run of `run_length` TCP segments (see write_batch), the first of
+  //! which carries `segment_size` bytes of payload: the kernel finishes the TCP checksum, and splits a run of
+  //! more than one back into segments of that size
+  static std::string make_vnet_header( size_t run_length, size_t segment_size );
+
+  //! Parse the IPv4 datagram of `length` bytes read into buffers sized by prepare_read_buffers (copying it into one
+  //! buffer from the BufferPool, so they can be reused). If the first buffer is a virtio-net header (`vnet_hdr`),
+  //! notes whether the kernel has already taken care of the TCP checksum.
+  static std::optional<InternetDatagram> parse_buffers( const std::vector<std::string>& buffers,
+                                                        size_t length,
+                                                        bool vnet_hdr,
+                                                        bool& verify_checksum );
 };
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
 static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );
+static_assert( TCPBatchDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
+static_assert( TCPDemuxAdapter<TCPOverIPv4OverTunFdAdapter> );
+static_assert( TCPBatchDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );
+static_assert( TCPBatchDatagramAdapter<NetEmAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>> );